@@ -98,7 +98,7 @@ public:
 
                   osg::Matrixd newMatrix = localMotionMatrix * _startMotionMatrix;
                   osg::Vec2d location = getLocation( newMatrix );
-                  (*_feature->getGeometry())[_point] = osg::Vec3d(location.x(), location.y(), 0);
+                  (*_feature->getGeometryForWrite())[_point] = osg::Vec3d(location.x(), location.y(), 0);
                   _source->dirty();
 
                   return true;
@@ -178,7 +178,7 @@ _mapSRS( mapSRS )
 
             if (_feature.valid())            
             {
-                _feature->getGeometry()->push_back( osg::Vec3d(lon_deg, lat_deg, 0) );
+                _feature->getGeometryForWrite()->push_back( osg::Vec3d(lon_deg, lat_deg, 0) );
                 _source->dirty();
                 //OE_NOTICE << "Added feature point at " << lon_deg << ", " << lat_deg << std::endl;                    
             }
@@ -80,6 +80,9 @@ usage( const std::string& msg )
         << "        [--bounds xmin ymin xmax ymax]  ; Geospatial bounding box to seed" << std::endl
         << "        [--cache-path path]             ; Overrides the cache path in the .earth file" << std::endl
         << "        [--cache-type type]             ; Overrides the cache type in the .earth file" << std::endl
+        << "        [--threads num]                 ; Number of seeding threads (default=1)" << std::endl
+        << "        [--checkpoint file]             ; Records seeding progress in a file, and resumes from it" << std::endl
+        << "        [--report-interval seconds]     ; How often to report throughput (default=10)" << std::endl
         //<< std::endl
         //<< "    --purge file.earth                  ; Purges cached data from the cache in a .earth file" << std::endl
         //<< "        [--layer name]                  ; Named layer for which to purge the cache" << std::endl
@@ -123,6 +126,18 @@ seed( osg::ArgumentParser& args )
     std::string cacheType;
     while (args.read("--cache-type", cacheType));
 
+    //Read the number of seeding threads
+    unsigned int numThreads = 1;
+    while (args.read("--threads", numThreads));
+
+    //Read the checkpoint file
+    std::string checkpointFile;
+    while (args.read("--checkpoint", checkpointFile));
+
+    //Read the throughput reporting interval
+    double reportInterval = 10.0;
+    while (args.read("--report-interval", reportInterval));
+
     bool quiet = args.read("--quiet");
 
     //Read in the earth file.
@@ -138,6 +153,9 @@ seed( osg::ArgumentParser& args )
     seeder.setMinLevel( minLevel );
     seeder.setMaxLevel( maxLevel );
     seeder.setBounds( bounds );
+    seeder.setNumThreads( numThreads );
+    seeder.setCheckpointFile( checkpointFile );
+    seeder.setReportInterval( reportInterval );
     if (!quiet)
     {
         seeder.setProgressCallback(new ConsoleProgressCallback);
@@ -20,11 +20,125 @@
 #include <osgEarth/CacheSeed>
 #include <osgEarth/Caching>
 #include <OpenThreads/ScopedLock>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Thread>
 #include <limits.h>
+#include <stdio.h>
+#include <deque>
+#include <sstream>
+#include <iomanip>
 
 using namespace osgEarth;
 using namespace OpenThreads;
 
+#define LC "[CacheSeed] "
+
+namespace
+{
+    /** A key to seed, and its position in the enumeration order. */
+    typedef std::pair<unsigned long long, TileKey> SeedItem;
+
+    /**
+     * Bounded FIFO of keys waiting to be seeded. The producer blocks when the
+     * queue is full so that enumeration never runs far ahead of the workers.
+     */
+    class SeedQueue
+    {
+    public:
+        SeedQueue( unsigned int capacity ) : _capacity(capacity), _done(false) { }
+
+        void push( const SeedItem& item )
+        {
+            ScopedLock<Mutex> lock(_mutex);
+            while( !_done && _keys.size() >= _capacity )
+                _notFull.wait( &_mutex );
+            _keys.push_back( item );
+            _notEmpty.signal();
+        }
+
+        bool pop( SeedItem& out_item )
+        {
+            ScopedLock<Mutex> lock(_mutex);
+            while( !_done && _keys.empty() )
+                _notEmpty.wait( &_mutex );
+            if ( _keys.empty() )
+                return false;
+            out_item = _keys.front();
+            _keys.pop_front();
+            _notFull.signal();
+            return true;
+        }
+
+        /** no more keys are coming; workers drain the queue and then exit. */
+        void setDone()
+        {
+            ScopedLock<Mutex> lock(_mutex);
+            _done = true;
+            _notEmpty.broadcast();
+            _notFull.broadcast();
+        }
+
+        /** abandon any keys still in the queue. */
+        void clear()
+        {
+            ScopedLock<Mutex> lock(_mutex);
+            _keys.clear();
+            _notFull.broadcast();
+        }
+
+    private:
+        std::deque<SeedItem> _keys;
+        unsigned int        _capacity;
+        bool                _done;
+        Mutex               _mutex;
+        Condition           _notEmpty, _notFull;
+    };
+
+    struct SeedThread : public OpenThreads::Thread
+    {
+        SeedThread( const CacheSeed* seeder, const MapFrame& mapf, SeedQueue& queue, CacheSeed::Stats& stats )
+            : _seeder(seeder), _mapf(mapf), _queue(queue), _stats(stats) { }
+
+        void run()
+        {
+            SeedItem item;
+            while( _queue.pop(item) )
+            {
+                _seeder->processKey( _mapf, item.second, item.first, _stats );
+            }
+        }
+
+        const CacheSeed*  _seeder;
+        const MapFrame&   _mapf;
+        SeedQueue&        _queue;
+        CacheSeed::Stats& _stats;
+    };
+
+    /**
+     * Whether the data a layer needs for a map key is already in that layer's cache.
+     * cacheInMapProfile must match the layer's own decision (see ImageLayer::isCachedInMapProfile).
+     */
+    bool isLayerCached( TerrainLayer* layer, const TileKey& key, bool cacheInMapProfile )
+    {
+        Cache* cache = layer->getCache();
+        if ( !cache || !layer->getProfile() )
+            return false;
+
+        std::vector<TileKey> keys;
+        if ( cacheInMapProfile || key.getProfile()->isEquivalentTo( layer->getProfile() ) )
+            keys.push_back( key );
+        else
+            layer->getProfile()->getIntersectingTiles( key, keys );
+
+        for( unsigned int i = 0; i < keys.size(); ++i )
+        {
+            if ( layer->isKeyValid(keys[i]) && !cache->isCached(keys[i], layer->getCacheSpec()) )
+                return false;
+        }
+        return true;
+    }
+}
+
 void CacheSeed::seed( Map* map )
 {
     //Threading::ScopedReadLock lock( map->getMapDataMutex() );
@@ -38,9 +152,6 @@ void CacheSeed::seed( Map* map )
 
 //    osg::ref_ptr<MapEngine> engine = new MapEngine(); //map->createMapEngine();
 
-    std::vector<TileKey> keys;
-    map->getProfile()->getRootKeys(keys);
-
     //Set the default bounds to the entire profile if the user didn't override the bounds
     if (_bounds.xMin() == 0 && _bounds.yMin() == 0 &&
         _bounds.xMax() == 0 && _bounds.yMax() == 0)
@@ -138,68 +249,252 @@ void CacheSeed::seed( Map* map )
 
     OE_NOTICE << "Maximum cache level will be " << _maxLevel << std::endl;
 
-    for (unsigned int i = 0; i < keys.size(); ++i)
+    Stats stats;
+    for( ImageLayerVector::const_iterator i = mapf.imageLayers().begin(); i != mapf.imageLayers().end(); i++ )
+    {
+        stats._layers.push_back( Stats::Layer() );
+        stats._layers.back()._name = i->get()->getName();
+    }
+    for( ElevationLayerVector::const_iterator i = mapf.elevationLayers().begin(); i != mapf.elevationLayers().end(); i++ )
     {
-        processKey( mapf, keys[i] );
+        stats._layers.push_back( Stats::Layer() );
+        stats._layers.back()._name = i->get()->getName();
+    }
+
+    // Count the keys up front so we can report progress.
+    const Profile* profile = map->getProfile();
+    unsigned int firstLevel = osg::minimum( _minLevel, _maxLevel );
+    TileRangeVector ranges;
+    profile->getIntersectingTileRanges(
+        GeoExtent(profile->getSRS(), _bounds.xMin(), _bounds.yMin(), _bounds.xMax(), _bounds.yMax()),
+        firstLevel, _maxLevel, ranges );
+    for( TileRangeVector::const_iterator r = ranges.begin(); r != ranges.end(); ++r )
+        stats._keysTotal += r->getNumTiles();
+
+    // Resume from the last watermark recorded by a previous run, and prepare to record new ones.
+    // The first line identifies the key enumeration; a checkpoint from a different one is ignored.
+    unsigned long long resumeAt = 0;
+    if ( !_checkpointFile.empty() )
+    {
+        std::stringstream buf;
+        buf << std::setprecision(17) << "osgearth_seed " << firstLevel << " " << _maxLevel << " "
+            << _bounds.xMin() << " " << _bounds.yMin() << " " << _bounds.xMax() << " " << _bounds.yMax() << " "
+            << stats._keysTotal;
+        std::string header = buf.str();
+
+        bool append = false;
+        std::ifstream in( _checkpointFile.c_str() );
+        std::string line;
+        if ( std::getline(in, line) )
+        {
+            if ( line == header )
+            {
+                append = true;
+                while( std::getline(in, line) )
+                {
+                    unsigned long long watermark;
+                    if ( sscanf(line.c_str(), "%llu", &watermark) == 1 && watermark > resumeAt )
+                        resumeAt = watermark;
+                }
+                OE_NOTICE << LC << "Resuming; " << resumeAt << " keys already seeded" << std::endl;
+            }
+            else
+            {
+                OE_WARN << LC << "Checkpoint file " << _checkpointFile << " is from a different seed; starting over" << std::endl;
+            }
+        }
+        in.close();
+
+        stats._checkpoint.open( _checkpointFile.c_str(), append ? (std::ios::out | std::ios::app) : std::ios::out );
+        if ( !stats._checkpoint.is_open() )
+            OE_WARN << LC << "Unable to write to checkpoint file " << _checkpointFile << std::endl;
+        else if ( !append )
+            stats._checkpoint << header << "\n";
+
+        stats._watermark = stats._checkpointed = resumeAt;
+    }
+
+    OE_NOTICE << LC << "Seeding " << stats._keysTotal << " keys with " << _numThreads << " threads" << std::endl;
+
+    stats._startTime = osg::Timer::instance()->tick();
+
+    // Start up the workers.
+    SeedQueue queue( 256 * _numThreads );
+    std::vector<SeedThread*> threads;
+    if ( _numThreads > 1 )
+    {
+        for( unsigned int i = 0; i < _numThreads; ++i )
+        {
+            threads.push_back( new SeedThread(this, mapf, queue, stats) );
+            threads.back()->start();
+        }
     }
+
+    // Enumerate the keys that intersect the bounds, breadth-first, and feed them to the workers.
+    osg::Timer_t lastReport = stats._startTime;
+    TileRangeIterator tiles( ranges );
+    unsigned int lod, x, y;
+    for( unsigned long long seq = 0; !stats._canceled && tiles.next(lod, x, y); ++seq )
+    {
+        if ( seq < resumeAt )
+        {
+            ScopedLock<Mutex> lock( stats._mutex );
+            stats._keysDone++;
+            continue;
+        }
+
+        TileKey key( lod, x, y, profile );
+
+        if ( threads.empty() )
+            processKey( mapf, key, seq, stats );
+        else
+            queue.push( SeedItem(seq, key) );
+
+        osg::Timer_t now = osg::Timer::instance()->tick();
+        if ( _reportInterval > 0.0 && osg::Timer::instance()->delta_s(lastReport, now) >= _reportInterval )
+        {
+            reportStats( stats );
+            lastReport = now;
+        }
+    }
+
+    // Wait for the workers to drain the queue.
+    if ( stats._canceled )
+        queue.clear();
+    queue.setDone();
+
+    for( unsigned int i = 0; i < threads.size(); ++i )
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    reportStats( stats );
 }
 
 
 void
-CacheSeed::processKey(const MapFrame& mapf, const TileKey& key ) const
+CacheSeed::processKey(const MapFrame& mapf, const TileKey& key, unsigned long long seq, Stats& stats ) const
 {
-    unsigned int x, y, lod;
-    key.getTileXY(x, y);
-    lod = key.getLevelOfDetail();
-
-//	osg::ref_ptr<osgEarth::VersionedTerrain> terrain = new osgEarth::VersionedTerrain( map, engine );
+    if ( stats._canceled )
+        return;
 
-    if ( _minLevel <= lod && _maxLevel >= lod )
+    if ( _progress.valid() )
     {
-//        OE_NOTICE << "Caching tile = " << key.str() << std::endl; //<< lod << " (" << x << ", " << y << ") " << std::endl;
-	if ( _progress.valid() && _progress->reportProgress(0, 0, "Caching tile: " + key.str()) )
-	    return; // Task has been cancelled by user
+        unsigned long long done, total;
+        {
+            ScopedLock<Mutex> lock( stats._mutex );
+            done = stats._keysDone;
+            total = stats._keysTotal;
+        }
 
-        cacheTile( mapf, key );
-  //      bool validData;
-		//osg::ref_ptr<osg::Node> node = engine->createTile( map, terrain.get(), key, true, false, false, validData );        
+        ScopedLock<Mutex> lock( stats._progressMutex );
+        if ( _progress->reportProgress((double)done, (double)total, "Caching tile: " + key.str()) )
+        {
+            // Task has been cancelled by user
+            stats._canceled = true;
+            return;
+        }
     }
 
-    if (lod <= _maxLevel)
-    {
-        TileKey k0 = key.createChildKey(0);
-        TileKey k1 = key.createChildKey(1);
-        TileKey k2 = key.createChildKey(2);
-        TileKey k3 = key.createChildKey(3);        
+    cacheTile( mapf, key, stats );
+    keyDone( seq, stats );
+}
 
-        //Check to see if the bounds intersects ANY of the tile's children.  If it does, then process all of the children
-        //for this level
-        if (_bounds.intersects( k0.getExtent().bounds() ) || _bounds.intersects(k1.getExtent().bounds()) ||
-            _bounds.intersects( k2.getExtent().bounds() ) || _bounds.intersects(k3.getExtent().bounds()) )
+void
+CacheSeed::keyDone( unsigned long long seq, Stats& stats ) const
+{
+    ScopedLock<Mutex> lock( stats._mutex );
+    stats._keysDone++;
+
+    // advance the watermark past every key done so far in sequence.
+    if ( seq == stats._watermark )
+    {
+        stats._watermark++;
+        std::set<unsigned long long>::iterator i = stats._doneAhead.begin();
+        while( i != stats._doneAhead.end() && *i == stats._watermark )
         {
-            processKey(mapf, k0);
-            processKey(mapf, k1);
-            processKey(mapf, k2);
-            processKey(mapf, k3);
+            stats._doneAhead.erase( i++ );
+            stats._watermark++;
         }
     }
+    else
+    {
+        stats._doneAhead.insert( seq );
+    }
 }
 
 void
-CacheSeed::cacheTile(const MapFrame& mapf, const TileKey& key ) const
+CacheSeed::cacheTile(const MapFrame& mapf, const TileKey& key, Stats& stats ) const
 {
-    for( ImageLayerVector::const_iterator i = mapf.imageLayers().begin(); i != mapf.imageLayers().end(); i++ )
+    unsigned int index = 0;
+
+    for( ImageLayerVector::const_iterator i = mapf.imageLayers().begin(); i != mapf.imageLayers().end(); ++i, ++index )
     {
         ImageLayer* layer = i->get();
         if ( layer->isKeyValid( key ) )
         {
+            if ( isLayerCached(layer, key, layer->isCachedInMapProfile(key.getProfile())) )
+            {
+                ScopedLock<Mutex> lock( stats._mutex );
+                stats._layers[index]._skipped++;
+                continue;
+            }
+
             GeoImage image = layer->createImage( key );
+
+            ScopedLock<Mutex> lock( stats._mutex );
+            stats._layers[index]._tiles++;
+            if ( image.valid() )
+                stats._layers[index]._bytes += image.getImage()->getTotalSizeInBytes();
+        }
+    }
+
+    // heightfields are always cached in the map profile.
+    for( ElevationLayerVector::const_iterator i = mapf.elevationLayers().begin(); i != mapf.elevationLayers().end(); ++i, ++index )
+    {
+        ElevationLayer* layer = i->get();
+
+        if ( isLayerCached(layer, key, true) )
+        {
+            ScopedLock<Mutex> lock( stats._mutex );
+            stats._layers[index]._skipped++;
+            continue;
         }
+
+        osg::ref_ptr<osg::HeightField> hf = layer->createHeightField( key );
+
+        ScopedLock<Mutex> lock( stats._mutex );
+        stats._layers[index]._tiles++;
+        if ( hf.valid() )
+            stats._layers[index]._bytes += hf->getHeightList().size() * sizeof(float);
+    }
+}
+
+void
+CacheSeed::reportStats( Stats& stats ) const
+{
+    ScopedLock<Mutex> lock( stats._mutex );
+
+    double t = osg::Timer::instance()->delta_s( stats._startTime, osg::Timer::instance()->tick() );
+    if ( t <= 0.0 )
+        return;
+
+    OE_NOTICE << LC << stats._keysDone << " of " << stats._keysTotal << " keys done in " << t << " s" << std::endl;
+
+    for( unsigned int i = 0; i < stats._layers.size(); ++i )
+    {
+        const Stats::Layer& layer = stats._layers[i];
+        OE_NOTICE << LC << "  Layer \"" << layer._name << "\": "
+            << layer._tiles << " tiles (" << (double)layer._tiles/t << " tiles/s), "
+            << layer._bytes/1048576.0 << " MB (" << layer._bytes/1048576.0/t << " MB/s), "
+            << layer._skipped << " already cached" << std::endl;
     }
 
-    if ( mapf.elevationLayers().size() > 0 )
+    if ( stats._checkpoint.is_open() && stats._watermark > stats._checkpointed )
     {
-        osg::ref_ptr<osg::HeightField> hf;
-        mapf.getHeightField( key, false, hf );
+        stats._checkpoint << stats._watermark << "\n";
+        stats._checkpoint.flush();
+        stats._checkpointed = stats._watermark;
     }
 }
@@ -333,15 +333,40 @@ DiskCache::loadProperties(const std::string&           cacheId,
 #undef  LC
 #define LC "[MemCache] "
 
-MemCache::MemCache( int maxSize ):
-_maxNumTilesInCache( maxSize )
+namespace
+{
+    // never let a shard get so small that the LRU stops being meaningful
+    const unsigned int MIN_TILES_PER_SHARD = 8;
+}
+
+MemCache::MemCache( int maxSize, unsigned int numShards ):
+_maxNumTilesInCache( maxSize ),
+_maxSizeInBytes( 0 )
 {
     setName( "mem" );
+    allocateShards( numShards );
 }
 
 MemCache::MemCache( const MemCache& rhs, const osg::CopyOp& op ) :
-_maxNumTilesInCache( rhs._maxNumTilesInCache )
+_maxNumTilesInCache( rhs._maxNumTilesInCache ),
+_maxSizeInBytes( rhs._maxSizeInBytes )
+{
+    allocateShards( rhs._shards.size() );
+}
+
+MemCache::~MemCache()
+{
+    for( unsigned int i=0; i<_shards.size(); ++i )
+        delete _shards[i];
+}
+
+void
+MemCache::allocateShards( unsigned int numShards )
 {
+    numShards = osg::clampBetween( numShards, 1u, osg::maximum(1u, _maxNumTilesInCache/MIN_TILES_PER_SHARD) );
+    _shards.reserve( numShards );
+    for( unsigned int i=0; i<numShards; ++i )
+        _shards.push_back( new Shard() );
 }
 
 unsigned int
@@ -356,6 +381,58 @@ MemCache::setMaxNumTilesInCache(unsigned int max)
 	_maxNumTilesInCache = max;
 }
 
+unsigned long
+MemCache::getMaxSizeInBytes() const
+{
+    return _maxSizeInBytes;
+}
+
+void
+MemCache::setMaxSizeInBytes(unsigned long max)
+{
+    _maxSizeInBytes = max;
+}
+
+MemCache::Stats
+MemCache::getStats() const
+{
+    Stats stats;
+    for( unsigned int i=0; i<_shards.size(); ++i )
+    {
+        Shard& shard = *_shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( shard._mutex );
+        stats._hits        += shard._hits;
+        stats._misses      += shard._misses;
+        stats._evictions   += shard._evictions;
+        stats._numTiles    += shard._objects.size();
+        stats._sizeInBytes += shard._sizeInBytes;
+    }
+    return stats;
+}
+
+namespace
+{
+    std::pair<unsigned int, unsigned long long> tileCode( const TileKey& key )
+    {
+        return std::make_pair( key.valid() ? key.getProfile()->getUID() : 0u, key.getCode() );
+    }
+}
+
+MemCache::Shard&
+MemCache::getShard( const TileKey& key, const CacheSpec& spec ) const
+{
+    if ( _shards.size() == 1 )
+        return *_shards[0];
+
+    unsigned int h = hashValue( key );
+    h ^= tileCode(key).first * 2654435761u;
+    const std::string& id = spec.cacheId();
+    for( std::string::const_iterator c = id.begin(); c != id.end(); ++c )
+        h = h*31u + (unsigned char)(*c);
+
+    return *_shards[h % _shards.size()];
+}
+
 bool
 MemCache::getImage(const osgEarth::TileKey& key, const CacheSpec& spec, osg::ref_ptr<const osg::Image>& out_image )
 {
@@ -371,7 +448,8 @@ MemCache::getImage(const osgEarth::TileKey& key, const CacheSpec& spec, osg::ref
 void
 MemCache::setImage(const osgEarth::TileKey& key, const CacheSpec& spec, const osg::Image* image)
 {
-    setObject( key, spec, ImageUtils::cloneImage(image) );
+    if ( image )
+        setObject( key, spec, ImageUtils::cloneImage(image), image->getTotalSizeInBytes() );
 }
 
 bool
@@ -389,78 +467,115 @@ MemCache::getHeightField( const TileKey& key,const CacheSpec& spec, osg::ref_ptr
 void
 MemCache::setHeightField( const TileKey& key, const CacheSpec& spec, const osg::HeightField* hf)
 {
-    setObject( key, spec, new osg::HeightField(*hf) );
+    if ( hf )
+        setObject( key, spec, new osg::HeightField(*hf), hf->getHeightList().size() * sizeof(float) );
 }
 
 bool
 MemCache::purge( const std::string& cacheId, int olderThan, bool async )
 {
-    //TODO: can this be a ReadWriteLock instead?
-
-    // MemCache does not support timestamps or async, so just clear it out altogether.
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
-
-    // MemCache does not support cacheId...
-    _keyToIterMap.clear();
-    _objects.clear();
+    // MemCache does not support timestamps, async or cacheId, so just clear it out altogether.
+    for( unsigned int i=0; i<_shards.size(); ++i )
+    {
+        Shard& shard = *_shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( shard._mutex );
+        shard._keyToIterMap.clear();
+        shard._objects.clear();
+        shard._sizeInBytes = 0;
+    }
 
     return true;
 }
 
+MemCache::ObjectList::iterator
+MemCache::find( Shard& shard, const TileKey& key, const CacheSpec& spec ) const
+{
+    KeyToIteratorMap::iterator i = shard._keyToIterMap.find( spec.cacheId() );
+    if ( i != shard._keyToIterMap.end() )
+    {
+        TileCodeToIteratorMap::iterator j = i->second.find( tileCode(key) );
+        if ( j != i->second.end() )
+            return j->second;
+    }
+    return shard._objects.end();
+}
+
 bool
 MemCache::getObject( const TileKey& key, const CacheSpec& spec, osg::ref_ptr<const osg::Object>& output )
 {
-  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+  Shard& shard = getShard( key, spec );
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock( shard._mutex );
 
-  std::string id = key.str() + spec.cacheId();
-  KeyToIteratorMap::iterator itr = _keyToIterMap.find(id);
-  if (itr != _keyToIterMap.end())
+  ObjectList::iterator itr = find( shard, key, spec );
+  if (itr != shard._objects.end())
   {
-    CachedObject entry = *itr->second;
-    _objects.erase(itr->second);
-    _objects.push_front(entry);
-    itr->second = _objects.begin();
-    output = itr->second->_object.get();
+    // move the entry to the front of the LRU list without copying it
+    shard._objects.splice( shard._objects.begin(), shard._objects, itr );
+    output = itr->_object.get();
+    shard._hits++;
     return output.valid();
   }
+
+  shard._misses++;
   return false;
 }
 
 void
-MemCache::setObject( const TileKey& key, const CacheSpec& spec, const osg::Object* referenced )
+MemCache::setObject( const TileKey& key, const CacheSpec& spec, const osg::Object* referenced, unsigned long sizeInBytes )
 {
-  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+  Shard& shard = getShard( key, spec );
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock( shard._mutex );
 
-  std::string id = key.str() + spec.cacheId();
-
-  _objects.push_front(CachedObject());
-  CachedObject& entry = _objects.front();
+  ObjectList::iterator itr = find( shard, key, spec );
+  if ( itr != shard._objects.end() )
+  {
+      // replace an existing entry in place
+      shard._sizeInBytes -= itr->_sizeInBytes;
+      shard._objects.erase( itr );
+  }
 
-  //CachedObject entry;
+  shard._objects.push_front(CachedObject());
+  CachedObject& entry = shard._objects.front();
   entry._object = referenced;
-  entry._key = id;
-  //_objects.push_front(entry);
+  entry._cacheId = spec.cacheId();
+  entry._tileCode = tileCode(key);
+  entry._sizeInBytes = sizeInBytes;
 
-  _keyToIterMap[id] = _objects.begin();
+  shard._keyToIterMap[entry._cacheId][entry._tileCode] = shard._objects.begin();
+  shard._sizeInBytes += sizeInBytes;
 
-  if (_objects.size() > _maxNumTilesInCache)
-  {
-      _keyToIterMap.erase( _objects.back()._key );
-      _objects.pop_back();
-    //CachedObject toRemove = _objects.back();
-    //_objects.pop_back();
-    //_keyToIterMap.erase(toRemove._key);
-  }
+  trim( shard );
+}
+
+void
+MemCache::trim( Shard& shard )
+{
+    // the limits are divided evenly amongst the shards.
+    unsigned int  maxTiles = osg::maximum( 1u, _maxNumTilesInCache / (unsigned int)_shards.size() );
+    unsigned long maxBytes = _maxSizeInBytes / _shards.size();
+
+    // always keep the newest entry, even if on its own it exceeds the byte budget.
+    while(
+        shard._objects.size() > 1 &&
+        ( shard._objects.size() > maxTiles || (maxBytes > 0 && shard._sizeInBytes > maxBytes) ) )
+    {
+        shard._sizeInBytes -= shard._objects.back()._sizeInBytes;
+        const CachedObject& last = shard._objects.back();
+        KeyToIteratorMap::iterator i = shard._keyToIterMap.find( last._cacheId );
+        i->second.erase( last._tileCode );
+        if ( i->second.empty() )
+            shard._keyToIterMap.erase( i );
+        shard._objects.pop_back();
+        shard._evictions++;
+    }
 }
 
 bool
 MemCache::isCached(const osgEarth::TileKey& key, const CacheSpec& spec) const
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( const_cast<MemCache*>(this)->_mutex);
-    std::string id = key.str() + spec.cacheId();
-    return _keyToIterMap.find(id) != _keyToIterMap.end();
-	//osg::ref_ptr<osg::Image> image = getImage(key,spec);
-	//return image.valid();
+    Shard& shard = getShard( key, spec );
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( shard._mutex );
+    return find( shard, key, spec ) != shard._objects.end();
 }
 
 //------------------------------------------------------------------------
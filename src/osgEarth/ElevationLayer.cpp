@@ -219,6 +219,33 @@ ElevationLayer::createGeoHeightField(const TileKey& key, ProgressCallback* progr
 
 osg::HeightField*
 ElevationLayer::createHeightField(const osgEarth::TileKey& key, ProgressCallback* progress )
+{
+    // If another thread is already fetching this tile, wait for it and share the result.
+    osg::ref_ptr<PendingTile> pending;
+    while( !beginTileRequest(key, pending) )
+    {
+        osg::ref_ptr<osg::Object> hf;
+        GeoExtent extent;
+        if ( waitForTile(pending.get(), hf, extent) )
+        {
+            return static_cast<osg::HeightField*>( hf.release() );
+        }
+
+        if ( progress && progress->isCanceled() )
+            return 0L;
+
+        // the other fetch was canceled, so try again ourselves.
+        pending = 0L;
+    }
+
+    // hold a reference while the waiters share it, and hand it back unreferenced.
+    osg::ref_ptr<osg::HeightField> result = doCreateHeightField( key, progress );
+    endTileRequest( key, pending.get(), result.get(), key.getExtent(), progress );
+    return result.release();
+}
+
+osg::HeightField*
+ElevationLayer::doCreateHeightField(const osgEarth::TileKey& key, ProgressCallback* progress )
 {
     osg::HeightField* result = 0L;
     //osg::ref_ptr<osg::HeightField> result;
@@ -10,6 +10,35 @@
 using namespace osgEarth;
 using namespace OpenThreads;
 
+namespace
+{
+    // Builds the heightfield for one tile of a batch query (see getElevations).
+    struct BuildHeightField
+    {
+        void init( const MapFrame* mapf, const TileKey& key, ElevationInterpolation interp, osg::ref_ptr<osg::HeightField>* out_hf, char* done )
+        {
+            _mapf   = mapf;
+            _key    = key;
+            _interp = interp;
+            _out_hf = out_hf;
+            _done   = done;
+        }
+
+        void execute()
+        {
+            _mapf->getHeightField( _key, true, *_out_hf, 0L, _interp );
+            *_done = 1;
+        }
+
+        const MapFrame*                 _mapf;
+        TileKey                         _key;
+        ElevationInterpolation          _interp;
+        osg::ref_ptr<osg::HeightField>* _out_hf;
+        char*                           _done;
+    };
+
+}
+
 ElevationQuery::ElevationQuery( const Map* map ) :
 _mapf( map, Map::ELEVATION_LAYERS )
 {
@@ -112,33 +141,193 @@ ElevationQuery::getElevations(osg::Vec3dArray*        points,
                               bool                    ignoreZ,
                               double                  desiredResolution )
 {
-    sync();
-    for( osg::Vec3dArray::iterator i = points->begin(); i != points->end(); ++i )
+    std::vector<osg::Vec3d> input( points->begin(), points->end() );
+    std::vector<double>     elevations;
+    std::vector<bool>       successes;
+
+    getElevations( input, pointsSRS, elevations, desiredResolution, 0L, &successes );
+
+    for( unsigned i = 0; i < points->size(); ++i )
     {
-        double elevation;
-        double z = (*i).z();
-        if ( getElevationImpl( *i, pointsSRS, elevation, desiredResolution ) )
+        if ( successes[i] )
         {
-            (*i).z() = ignoreZ ? elevation : elevation + z;
+            double z = (*points)[i].z();
+            (*points)[i].z() = ignoreZ ? elevations[i] : elevations[i] + z;
         }
     }
     return true;
 }
 
 bool
-ElevationQuery::getElevationImpl(const osg::Vec3d&       point,
-                                 const SpatialReference* pointSRS,
-                                 double&                 out_elevation,
-                                 double                  desiredResolution,
-                                 double*                 out_actualResolution)
+ElevationQuery::getElevations(const std::vector<osg::Vec3d>& points,
+                              const SpatialReference*        pointsSRS,
+                              std::vector<double>&           out_elevations,
+                              double                         desiredResolution,
+                              std::vector<double>*           out_actualResolutions,
+                              std::vector<bool>*             out_successes )
 {
+    sync();
+
+    unsigned numPoints = points.size();
+    out_elevations.assign( numPoints, 0.0 );
+    if ( out_actualResolutions )
+        out_actualResolutions->assign( numPoints, 0.0 );
+    if ( out_successes )
+        out_successes->assign( numPoints, false );
+
     if ( _maxDataLevel == 0 || _tileSize == 0 )
     {
         // this means there are no heightfields.
-        out_elevation = 0.0;
+        if ( out_successes )
+            out_successes->assign( numPoints, true );
         return true;
     }
-   
+
+    if ( numPoints == 0 )
+        return true;
+
+    unsigned int level = getBestAvailableLevel( desiredResolution );
+
+    // transform all the input coords to map coords in one pass:
+    std::vector<double> x( numPoints ), y( numPoints );
+    for( unsigned i = 0; i < numPoints; ++i )
+    {
+        x[i] = points[i].x();
+        y[i] = points[i].y();
+    }
+
+    const Profile* profile = _mapf.getProfile();
+    if ( pointsSRS && !pointsSRS->isEquivalentTo( profile->getSRS() ) )
+    {
+        // ignore errors; any points that fail to transform will fall outside the profile.
+        pointsSRS->transformPoints( profile->getSRS(), &x[0], &y[0], numPoints, 0L, true );
+    }
+
+    // group the points by tile. We compute the tile indices directly rather than
+    // calling Profile::createTileKey so that we only build a TileKey once per tile.
+    const GeoExtent& pex = profile->getExtent();
+    unsigned tilesX, tilesY;
+    profile->getNumTiles( level, tilesX, tilesY );
+
+    typedef std::map< std::pair<unsigned,unsigned>, unsigned > GroupIndex;
+    GroupIndex groupIndex;
+    std::vector<PointGroup> groups;
+
+    for( unsigned i = 0; i < numPoints; ++i )
+    {
+        if ( !pex.contains( x[i], y[i] ) )
+            continue;
+
+        double rx = (x[i] - pex.xMin()) / pex.width();
+        double ry = (y[i] - pex.yMin()) / pex.height();
+        unsigned tx = osg::clampBelow( (unsigned)(rx * (double)tilesX), tilesX-1 );
+        unsigned ty = osg::clampBelow( (unsigned)((1.0-ry) * (double)tilesY), tilesY-1 );
+
+        std::pair<GroupIndex::iterator,bool> r = groupIndex.insert(
+            std::make_pair( std::make_pair(tx, ty), (unsigned)groups.size() ) );
+
+        if ( r.second )
+        {
+            groups.push_back( PointGroup() );
+            groups.back()._key = TileKey( level, tx, ty, profile );
+        }
+        groups[r.first->second]._indices.push_back( i );
+    }
+
+    // resolve each group's heightfield, first from the local cache:
+    std::vector<unsigned> misses;
+    for( unsigned g = 0; g < groups.size(); ++g )
+    {
+        PointGroup& group = groups[g];
+
+        TileCache::Record record = _tileCache.get( group._key );
+        if ( record.valid() )
+            group._cached = record.value();
+
+        if ( !group._cached._hf.valid() )
+        {
+            group._cached._tile = 0L;
+            misses.push_back( g );
+        }
+    }
+
+    // ...and then build the ones we're missing, in parallel if possible.
+    // (not vector<bool>; tasks finish concurrently)
+    std::vector<char> done( misses.size(), 0 );
+
+    if ( _service.valid() && misses.size() > 1 )
+    {
+        Threading::MultiEvent semaphore( misses.size() );
+
+        for( unsigned m = 0; m < misses.size(); ++m )
+        {
+            PointGroup& group = groups[misses[m]];
+            ParallelTask<BuildHeightField>* task = new ParallelTask<BuildHeightField>( &semaphore );
+            task->init( &_mapf, group._key, _interpolation, &group._cached._hf, &done[m] );
+            task->setPriority( -(float)group._key.getLevelOfDetail() );
+            _service->add( task );
+        }
+
+        semaphore.wait();
+    }
+
+    // build serially if there's no service, or if the service dropped a task.
+    for( unsigned m = 0; m < misses.size(); ++m )
+    {
+        if ( !done[m] )
+        {
+            PointGroup& group = groups[misses[m]];
+            _mapf.getHeightField( group._key, true, group._cached._hf, 0L, _interpolation );
+        }
+    }
+
+    for( unsigned m = 0; m < misses.size(); ++m )
+    {
+        PointGroup& group = groups[misses[m]];
+        if ( group._cached._hf.valid() )
+        {
+            _tileCache.insert( group._key, group._cached );
+        }
+        else
+        {
+            OE_WARN << LC << "Unable to create heightfield for key " << group._key.str() << std::endl;
+        }
+    }
+
+    // finally, sample each group.
+    unsigned numSucceeded = 0;
+
+    for( unsigned g = 0; g < groups.size(); ++g )
+    {
+        PointGroup& group = groups[g];
+        if ( !group._cached._hf.valid() )
+            continue;
+
+        double resolution = (double)group._cached._hf->getXInterval();
+
+        if ( _technique == TECHNIQUE_GEOMETRIC )
+            ensureTerrainTile( group._key, group._cached );
+
+        for( std::vector<unsigned>::const_iterator i = group._indices.begin(); i != group._indices.end(); ++i )
+        {
+            if ( sampleHeightField( group._key, group._cached, osg::Vec3d(x[*i], y[*i], 0.0), out_elevations[*i] ) )
+            {
+                if ( out_actualResolutions ) (*out_actualResolutions)[*i] = resolution;
+                if ( out_successes ) (*out_successes)[*i] = true;
+                ++numSucceeded;
+            }
+        }
+    }
+
+    OE_DEBUG << LC << "Batch of " << numPoints << " points spanned " << groups.size() << " tiles ("
+        << misses.size() << " cache misses), " << numSucceeded << " succeeded" << std::endl;
+
+    return numSucceeded == numPoints;
+}
+
+unsigned int
+ElevationQuery::getBestAvailableLevel( double desiredResolution ) const
+{
     // this is the ideal LOD for the requested resolution:
     unsigned int idealLevel = desiredResolution > 0.0
         ? _mapf.getProfile()->getLevelOfDetailForHorizResolution( desiredResolution, _tileSize )
@@ -150,6 +339,78 @@ ElevationQuery::getElevationImpl(const osg::Vec3d&       point,
     {
         bestAvailLevel = osg::minimum(bestAvailLevel, (unsigned int)_maxLevelOverride);
     }
+    return bestAvailLevel;
+}
+
+osgTerrain::TerrainTile*
+ElevationQuery::createTerrainTile( const TileKey& key, osg::HeightField* hf ) const
+{
+    // All this stuff is only required for GEOMETRIC mode.
+    GeoLocator* locator = GeoLocator::createForKey( key, _mapf.getMapInfo() );
+
+    osgTerrain::TerrainTile* tile = new osgTerrain::TerrainTile();
+
+    osgTerrain::HeightFieldLayer* layer = new osgTerrain::HeightFieldLayer( hf );
+    layer->setLocator( locator );
+
+    tile->setElevationLayer( layer );
+    tile->setRequiresNormals( false );
+    tile->setTerrainTechnique( new osgTerrain::GeometryTechnique );
+
+    return tile;
+}
+
+void
+ElevationQuery::ensureTerrainTile( const TileKey& key, CachedTile& cached )
+{
+    // tesselate the tile on demand, and update the cache entry so we only do it once.
+    if ( !cached._tile.valid() )
+    {
+        cached._tile = createTerrainTile( key, cached._hf.get() );
+        _tileCache.insert( key, cached );
+    }
+}
+
+bool
+ElevationQuery::sampleHeightField(const TileKey&    key,
+                                  const CachedTile& cached,
+                                  const osg::Vec3d& mapPoint,
+                                  double&           out_elevation ) const
+{
+    if ( _technique == TECHNIQUE_GEOMETRIC )
+    {
+        return intersectTile( cached._tile.get(), mapPoint, out_elevation );
+    }
+
+    const osg::HeightField* hf = cached._hf.get();
+    const GeoExtent& extent = key.getExtent();
+    double xInterval = extent.width()  / (double)(hf->getNumColumns()-1);
+    double yInterval = extent.height() / (double)(hf->getNumRows()-1);
+
+    // TRIANGULATED samples the plane of the grid triangle containing the point, which
+    // is where a vertical ray would hit the tesselated tile.
+    out_elevation = (double) HeightFieldUtils::getHeightAtLocation( 
+        hf, mapPoint.x(), mapPoint.y(), extent.xMin(), extent.yMin(), xInterval, yInterval,
+        _technique == TECHNIQUE_TRIANGULATED ? INTERP_TRIANGULATE : INTERP_BILINEAR );
+
+    return true;
+}
+
+bool
+ElevationQuery::getElevationImpl(const osg::Vec3d&       point,
+                                 const SpatialReference* pointSRS,
+                                 double&                 out_elevation,
+                                 double                  desiredResolution,
+                                 double*                 out_actualResolution)
+{
+    if ( _maxDataLevel == 0 || _tileSize == 0 )
+    {
+        // this means there are no heightfields.
+        out_elevation = 0.0;
+        return true;
+    }
+   
+    unsigned int bestAvailLevel = getBestAvailableLevel( desiredResolution );
     
     // transform the input coords to map coords:
     osg::Vec3d mapPoint = point;
@@ -162,9 +423,6 @@ ElevationQuery::getElevationImpl(const osg::Vec3d&       point,
         }
     }
 
-    osg::ref_ptr<osg::HeightField> hf;
-    osg::ref_ptr<osgTerrain::TerrainTile> tile;
-
     // get the tilekey corresponding to the tile we need:
     TileKey key = _mapf.getProfile()->createTileKey( mapPoint.x(), mapPoint.y(), bestAvailLevel );
     if ( !key.valid() )
@@ -180,105 +438,82 @@ ElevationQuery::getElevationImpl(const osg::Vec3d&       point,
     // fallback on a lower resolution, this cache will hold the final resolution heightfield
     // instead of trying to fetch the higher resolution one each tiem.
 
+    CachedTile cached;
     TileCache::Record record = _tileCache.get( key );
     if ( record.valid() )
-        tile = record.value().get();
-         
-    // if we found it, make sure it has a heightfield in it:
-    if ( tile.valid() )
-    {
-        osgTerrain::HeightFieldLayer* layer = dynamic_cast<osgTerrain::HeightFieldLayer*>(tile->getElevationLayer());
-        if ( layer )
-            hf = layer->getHeightField();
-
-        if ( !hf.valid() )
-            tile = 0L;
-    }
+        cached = record.value();
 
     // if we didn't find it (or it didn't have heightfield data), build it.
-    if ( !tile.valid() )
+    if ( !cached._hf.valid() )
     {
         // generate the heightfield corresponding to the tile key, automatically falling back
         // on lower resolution if necessary:
-        _mapf.getHeightField( key, true, hf, 0L, _interpolation );
+        _mapf.getHeightField( key, true, cached._hf, 0L, _interpolation );
 
         // bail out if we could not make a heightfield a all.
-        if ( !hf.valid() )
+        if ( !cached._hf.valid() )
         {
             OE_WARN << LC << "Unable to create heightfield for key " << key.str() << std::endl;
             return false;
         }
 
-        // All this stuff is requires for GEOMETRIC mode. An optimization would be to
-        // defer this so that PARAMETRIC mode doesn't waste time
-        GeoLocator* locator = GeoLocator::createForKey( key, _mapf.getMapInfo() );
-
-        tile = new osgTerrain::TerrainTile();
-
-        osgTerrain::HeightFieldLayer* layer = new osgTerrain::HeightFieldLayer( hf.get() );
-        layer->setLocator( locator );
-
-        tile->setElevationLayer( layer );
-        tile->setRequiresNormals( false );
-        tile->setTerrainTechnique( new osgTerrain::GeometryTechnique );
-
-        // store it in the local tile cache.
-        _tileCache.insert( key, tile.get() );
+        // store it in the local tile cache. We only tesselate the tile if GEOMETRIC mode needs it.
+        cached._tile = 0L;
+        _tileCache.insert( key, cached );
     }
 
     OE_DEBUG << LC << "LRU Cache, hit ratio = " << _tileCache.getHitRatio() << std::endl;
 
     // see what the actual resolution of the heightfield is.
     if ( out_actualResolution )
-        *out_actualResolution = (double)hf->getXInterval();
+        *out_actualResolution = (double)cached._hf->getXInterval();
 
     // finally it's time to get a height value:
-    if ( _technique == TECHNIQUE_PARAMETRIC )
-    {
-        const GeoExtent& extent = key.getExtent();
-        double xInterval = extent.width()  / (double)(hf->getNumColumns()-1);
-        double yInterval = extent.height() / (double)(hf->getNumRows()-1);
-        out_elevation = (double) HeightFieldUtils::getHeightAtLocation( 
-            hf.get(), mapPoint.x(), mapPoint.y(), extent.xMin(), extent.yMin(), xInterval, yInterval );
-        return true;
-    }
-    else // ( _technique == TECHNIQUE_GEOMETRIC )
-    {
-        osg::Vec3d start, end, zero;
+    if ( _technique == TECHNIQUE_GEOMETRIC )
+        ensureTerrainTile( key, cached );
 
-        if ( _mapf.getMapInfo().isGeocentric() )
-        {
-            const SpatialReference* mapSRS = _mapf.getProfile()->getSRS();
+    return sampleHeightField( key, cached, mapPoint, out_elevation );
+}
 
-            mapSRS->transformToECEF( osg::Vec3d(mapPoint.y(), mapPoint.x(),  50000.0), start );
-            mapSRS->transformToECEF( osg::Vec3d(mapPoint.y(), mapPoint.x(), -50000.0), end );
-            mapSRS->transformToECEF( osg::Vec3d(mapPoint.y(), mapPoint.x(),      0.0), zero );
-        }
-        else // PROJECTED
-        {
-            start.set( mapPoint.x(), mapPoint.y(),  50000.0 );
-            end.set  ( mapPoint.x(), mapPoint.y(), -50000.0 );
-            zero.set ( mapPoint.x(), mapPoint.y(),      0.0 );
-        }
+bool
+ElevationQuery::intersectTile(osgTerrain::TerrainTile* tile,
+                              const osg::Vec3d&        mapPoint,
+                              double&                  out_elevation ) const
+{
+    osg::Vec3d start, end, zero;
 
-        osgUtil::LineSegmentIntersector* i = new osgUtil::LineSegmentIntersector( start, end );
-        osgUtil::IntersectionVisitor iv;
-        iv.setIntersector( i );
+    if ( _mapf.getMapInfo().isGeocentric() )
+    {
+        const SpatialReference* mapSRS = _mapf.getProfile()->getSRS();
 
-        tile->accept( iv );
+        mapSRS->transformToECEF( osg::Vec3d(mapPoint.y(), mapPoint.x(),  50000.0), start );
+        mapSRS->transformToECEF( osg::Vec3d(mapPoint.y(), mapPoint.x(), -50000.0), end );
+        mapSRS->transformToECEF( osg::Vec3d(mapPoint.y(), mapPoint.x(),      0.0), zero );
+    }
+    else // PROJECTED
+    {
+        start.set( mapPoint.x(), mapPoint.y(),  50000.0 );
+        end.set  ( mapPoint.x(), mapPoint.y(), -50000.0 );
+        zero.set ( mapPoint.x(), mapPoint.y(),      0.0 );
+    }
 
-        osgUtil::LineSegmentIntersector::Intersections& results = i->getIntersections();
-        if ( !results.empty() )
-        {
-            const osgUtil::LineSegmentIntersector::Intersection& result = *results.begin();
-            osg::Vec3d isectPoint = result.getWorldIntersectPoint();
-            out_elevation = (isectPoint-end).length2() > (zero-end).length2()
-                ? (isectPoint-zero).length()
-                : -(isectPoint-zero).length();
-            return true;            
-        }
+    osgUtil::LineSegmentIntersector* i = new osgUtil::LineSegmentIntersector( start, end );
+    osgUtil::IntersectionVisitor iv;
+    iv.setIntersector( i );
 
-        OE_DEBUG << LC << "No intersection" << std::endl;
-        return false;
+    tile->accept( iv );
+
+    osgUtil::LineSegmentIntersector::Intersections& results = i->getIntersections();
+    if ( !results.empty() )
+    {
+        const osgUtil::LineSegmentIntersector::Intersection& result = *results.begin();
+        osg::Vec3d isectPoint = result.getWorldIntersectPoint();
+        out_elevation = (isectPoint-end).length2() > (zero-end).length2()
+            ? (isectPoint-zero).length()
+            : -(isectPoint-zero).length();
+        return true;            
     }
+
+    OE_DEBUG << LC << "No intersection" << std::endl;
+    return false;
 }
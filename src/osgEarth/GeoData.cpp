@@ -24,6 +24,7 @@
 
 #include <osg/Notify>
 #include <osg/Timer>
+#include <osg/Math>
 
 #include <gdal_priv.h>
 #include <gdalwarper.h>
@@ -534,7 +535,7 @@ GeoImage::crop( const GeoExtent& extent, bool exact, unsigned int width, unsigne
                 OE_DEBUG << "[osgEarth::GeoImage::crop] Computed output image size " << width << "x" << height << std::endl;
             }
 
-            //Note:  Passing in the current SRS simply forces GDAL to not do any warping
+            //Note:  Passing in the current SRS means no warping, just resampling
             return reproject( getSRS(), &extent, width, height);
         }
         else
@@ -742,9 +743,186 @@ reprojectImage(osg::Image* srcImage, const std::string srcWKT, double srcMinX, d
     return result;
 }    
 
+namespace
+{
+    // spacing, in destination pixels, of the control grid that manualReproject transforms exactly.
+    const unsigned CONTROL_GRID_SPACING = 16;
+
+    inline bool isValidPoint( double x, double y )
+    {
+        return !osg::isNaN(x) && !osg::isNaN(y) && fabs(x) < 1e30 && fabs(y) < 1e30;
+    }
+
+    /**
+     * Computes the source-SRS location of each destination pixel center, storing it in
+     * out_x/out_y at index (col*height + row).
+     *
+     * Rather than transforming every pixel, this transforms a sparse control grid and
+     * interpolates across each grid cell. A cell is only interpolated if the interpolated
+     * location of its center pixel is within "tolerance" source pixels of the exact one;
+     * otherwise every pixel in the cell is transformed. A tolerance of zero disables
+     * the approximation.
+     */
+    void
+    computeSourcePoints(const GeoExtent& src_extent, const GeoExtent& dest_extent,
+                        unsigned width, unsigned height,
+                        double srcPixelsPerUnitX, double srcPixelsPerUnitY,
+                        double tolerance,
+                        double* out_x, double* out_y)
+    {
+        const SpatialReference* destSRS = dest_extent.getSRS();
+        const SpatialReference* srcSRS  = src_extent.getSRS();
+
+        const double dx = dest_extent.width() / (double)width;
+        const double dy = dest_extent.height() / (double)height;
+        const double x0 = dest_extent.xMin() + 0.5*dx;
+        const double y0 = dest_extent.yMin() + 0.5*dy;
+
+        const unsigned S = CONTROL_GRID_SPACING;
+
+        // Interpolating across a discontinuity (e.g. a cube face edge) would be wrong.
+        bool approximate =
+            tolerance > 0.0 &&
+            (width > S || height > S) &&
+            srcSRS->isContiguous() && destSRS->isContiguous();
+
+        if ( !approximate )
+        {
+            for( unsigned c=0; c<width; ++c )
+            {
+                for( unsigned r=0; r<height; ++r )
+                {
+                    out_x[c*height + r] = x0 + dx*(double)c;
+                    out_y[c*height + r] = y0 + dy*(double)r;
+                }
+            }
+            destSRS->transformPoints( srcSRS, out_x, out_y, width*height, 0L, true );
+            return;
+        }
+
+        // control grid columns and rows, always including the last ones.
+        std::vector<unsigned> gc, gr;
+        for( unsigned c=0; c+1<width; c += S ) gc.push_back( c );
+        gc.push_back( width-1 );
+        for( unsigned r=0; r+1<height; r += S ) gr.push_back( r );
+        gr.push_back( height-1 );
+
+        const unsigned numGC = gc.size(), numGR = gr.size();
+
+        // transform the control points exactly:
+        std::vector<double> gx( numGC*numGR ), gy( numGC*numGR );
+        for( unsigned i=0; i<numGC; ++i )
+        {
+            for( unsigned j=0; j<numGR; ++j )
+            {
+                gx[i*numGR + j] = x0 + dx*(double)gc[i];
+                gy[i*numGR + j] = y0 + dy*(double)gr[j];
+            }
+        }
+        destSRS->transformPoints( srcSRS, &gx[0], &gy[0], gx.size(), 0L, true );
+
+        // the cells, or a single row/column of them if the image is only one pixel thick.
+        const unsigned numCellCols = osg::maximum( numGC-1, 1u );
+        const unsigned numCellRows = osg::maximum( numGR-1, 1u );
+        const unsigned numCells = numCellCols * numCellRows;
+
+        // transform the center pixel of each cell exactly, to measure the interpolation error:
+        std::vector<double> cx( numCells ), cy( numCells );
+        for( unsigned i=0; i<numCellCols; ++i )
+        {
+            unsigned c0 = gc[i], c1 = gc[osg::minimum(i+1, numGC-1)];
+            for( unsigned j=0; j<numCellRows; ++j )
+            {
+                unsigned r0 = gr[j], r1 = gr[osg::minimum(j+1, numGR-1)];
+                cx[i*numCellRows + j] = x0 + dx*(double)((c0+c1)/2);
+                cy[i*numCellRows + j] = y0 + dy*(double)((r0+r1)/2);
+            }
+        }
+        destSRS->transformPoints( srcSRS, &cx[0], &cy[0], numCells, 0L, true );
+
+        std::vector<double> exactX, exactY;
+        std::vector<unsigned> exactIndex;
+
+        for( unsigned i=0; i<numCellCols; ++i )
+        {
+            unsigned i1 = osg::minimum(i+1, numGC-1);
+            unsigned c0 = gc[i], c1 = gc[i1];
+            double   cw = c1 > c0 ? (double)(c1-c0) : 1.0;
+
+            for( unsigned j=0; j<numCellRows; ++j )
+            {
+                unsigned j1 = osg::minimum(j+1, numGR-1);
+                unsigned r0 = gr[j], r1 = gr[j1];
+                double   rh = r1 > r0 ? (double)(r1-r0) : 1.0;
+
+                // corners: 00 = (c0,r0), 10 = (c1,r0), 01 = (c0,r1), 11 = (c1,r1)
+                double x00 = gx[i*numGR + j],  y00 = gy[i*numGR + j];
+                double x10 = gx[i1*numGR + j], y10 = gy[i1*numGR + j];
+                double x01 = gx[i*numGR + j1], y01 = gy[i*numGR + j1];
+                double x11 = gx[i1*numGR + j1], y11 = gy[i1*numGR + j1];
+
+                bool ok =
+                    isValidPoint(x00, y00) && isValidPoint(x10, y10) &&
+                    isValidPoint(x01, y01) && isValidPoint(x11, y11);
+
+                if ( ok )
+                {
+                    // compare the interpolated center against the exact one, in source pixels.
+                    double u = (double)((c0+c1)/2 - c0) / cw;
+                    double v = (double)((r0+r1)/2 - r0) / rh;
+                    double ix = (1.0-v)*((1.0-u)*x00 + u*x10) + v*((1.0-u)*x01 + u*x11);
+                    double iy = (1.0-v)*((1.0-u)*y00 + u*y10) + v*((1.0-u)*y01 + u*y11);
+                    double ex = cx[i*numCellRows + j], ey = cy[i*numCellRows + j];
+
+                    ok =
+                        isValidPoint(ex, ey) &&
+                        fabs(ix-ex)*srcPixelsPerUnitX <= tolerance &&
+                        fabs(iy-ey)*srcPixelsPerUnitY <= tolerance;
+                }
+
+                for( unsigned c=c0; c<=c1; ++c )
+                {
+                    double u = (double)(c-c0) / cw;
+                    for( unsigned r=r0; r<=r1; ++r )
+                    {
+                        unsigned index = c*height + r;
+                        if ( ok )
+                        {
+                            double v = (double)(r-r0) / rh;
+                            out_x[index] = (1.0-v)*((1.0-u)*x00 + u*x10) + v*((1.0-u)*x01 + u*x11);
+                            out_y[index] = (1.0-v)*((1.0-u)*y00 + u*y10) + v*((1.0-u)*y01 + u*y11);
+                        }
+                        else
+                        {
+                            exactIndex.push_back( index );
+                            exactX.push_back( x0 + dx*(double)c );
+                            exactY.push_back( y0 + dy*(double)r );
+                        }
+                    }
+                }
+            }
+        }
+
+        // cells that failed the error test get an exact transform for every pixel. These are
+        // written last, so they also win on edges shared with interpolated cells.
+        if ( exactIndex.size() > 0 )
+        {
+            destSRS->transformPoints( srcSRS, &exactX[0], &exactY[0], exactX.size(), 0L, true );
+            for( unsigned k=0; k<exactIndex.size(); ++k )
+            {
+                out_x[exactIndex[k]] = exactX[k];
+                out_y[exactIndex[k]] = exactY[k];
+            }
+        }
+
+        OE_DEBUG << LC << "manualReproject: transformed " << gx.size() + cx.size() + exactX.size()
+            << " of " << width*height << " points" << std::endl;
+    }
+}
+
 static osg::Image*
 manualReproject(const osg::Image* image, const GeoExtent& src_extent, const GeoExtent& dest_extent,
-                unsigned int width = 0, unsigned int height = 0)
+                unsigned int width = 0, unsigned int height = 0, double errorTolerance = 0.0)
 {
     //TODO:  Compute the optimal destination size
     if (width == 0 || height == 0)
@@ -763,8 +941,6 @@ manualReproject(const osg::Image* image, const GeoExtent& src_extent, const GeoE
     memset(result->data(), 0, result->getImageSizeInBytes());
 
     ImageUtils::PixelReader ra(result);
-    const double dx = dest_extent.width() / (double)width;
-    const double dy = dest_extent.height() / (double)height;
 
     // offset the sample points by 1/2 a pixel so we are sampling "pixel center".
     // (This is especially useful in the UnifiedCubeProfile since it nullifes the chances for
@@ -772,35 +948,48 @@ manualReproject(const osg::Image* image, const GeoExtent& src_extent, const GeoE
 
     unsigned int numPixels = width * height;
 
-    // Start by creating a sample grid over the destination
-    // extent. These will be the source coordinates. Then, reproject
-    // the sample grid into the source coordinate system.
+    double xfac = (image->s() - 1) / src_extent.width();
+    double yfac = (image->t() - 1) / src_extent.height();
+
+    // Find the source coordinates of each destination pixel center.
     double *srcPointsX = new double[numPixels * 2];
     double *srcPointsY = srcPointsX + numPixels;
-    dest_extent.getSRS()->transformExtentPoints(
-        src_extent.getSRS(),
-        dest_extent.xMin() + .5 * dx, dest_extent.yMin() + .5 * dy,
-        dest_extent.xMax() - .5 * dx, dest_extent.yMax() - .5 * dy,
-        srcPointsX, srcPointsY, width, height, 0, true);
+    computeSourcePoints(
+        src_extent, dest_extent, width, height, xfac, yfac, errorTolerance,
+        srcPointsX, srcPointsY );
+
+    // Read the whole source image up front, one row at a time, so that the sampling below
+    // doesn't go through the pixel reader four times per destination pixel.
+    struct SourcePixels
+    {
+        std::vector<osg::Vec4f> _data;
+        int _width;
+        const osg::Vec4f& operator()(int s, int t) const { return _data[t*_width + s]; }
+    } ia;
+
+    ia._width = image->s();
+    ia._data.resize( image->s() * image->t() );
+    {
+        ImageUtils::PixelReader reader(image);
+        for( int t=0; t<image->t(); ++t )
+            reader.readSpan( &ia._data[t*image->s()], 0, t, image->s() );
+    }
 
     // Next, go through the source-SRS sample grid, read the color at each point from the source image,
-    // and write it to the corresponding pixel in the destination image.
-    int pixel = 0;
-    ImageUtils::PixelReader ia(image);
-    double xfac = (image->s() - 1) / src_extent.width();
-    double yfac = (image->t() - 1) / src_extent.height();
-    for (unsigned int c = 0; c < width; ++c)
+    // and write it to the corresponding pixel in the destination image. Walk the output
+    // in row order so that writes are sequential.
+    for (unsigned int r = 0; r < height; ++r)
     {
-        for (unsigned int r = 0; r < height; ++r)
+        for (unsigned int c = 0; c < width; ++c)
         {   
+            int pixel = c*height + r;
             double src_x = srcPointsX[pixel];
             double src_y = srcPointsY[pixel];
 
             if ( src_x < src_extent.xMin() || src_x > src_extent.xMax() || src_y < src_extent.yMin() || src_y > src_extent.yMax() )
             {
-                //If the sample point is outside of the bound of the source extent, increment the pixel and keep looping through.
+                //If the sample point is outside of the bound of the source extent, keep looping through.
                 //OE_WARN << LC << "ERROR: sample point out of bounds: " << src_x << ", " << src_y << std::endl;
-                pixel++;
                 continue;
             }
 
@@ -908,8 +1097,6 @@ manualReproject(const osg::Image* image, const GeoExtent& src_extent, const GeoE
             rgba[1] = (unsigned char)(color.g() * 255);
             rgba[2] = (unsigned char)(color.b() * 255);
             rgba[3] = (unsigned char)(color.a() * 255);
-
-            pixel++;            
         }
     }
 
@@ -921,7 +1108,7 @@ manualReproject(const osg::Image* image, const GeoExtent& src_extent, const GeoE
 
 
 GeoImage
-GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent, unsigned int width, unsigned int height) const
+GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent, unsigned int width, unsigned int height, double errorTolerance) const
 {  
     GeoExtent destExtent;
     if (to_extent)
@@ -935,13 +1122,15 @@ GeoImage::reproject(const SpatialReference* to_srs, const GeoExtent* to_extent,
 
     osg::Image* resultImage = 0L;
 
+    // The manual path handles custom projections, which GDAL will not recognize, and is
+    // much faster than a GDAL warp thanks to the control-grid approximation. We only fall
+    // back on GDAL when the caller wants it to suggest the output image size.
     if ( getSRS()->isUserDefined() || to_srs->isUserDefined() ||
         ( getSRS()->isMercator() && to_srs->isGeographic() ) ||
-        ( getSRS()->isGeographic() && to_srs->isMercator() ) )
+        ( getSRS()->isGeographic() && to_srs->isMercator() ) ||
+        ( width > 0 && height > 0 ) )
     {
-        // if either of the SRS is a custom projection, we have to do a manual reprojection since
-        // GDAL will not recognize the SRS.
-        resultImage = manualReproject(getImage(), getExtent(), *to_extent, width, height);
+        resultImage = manualReproject(getImage(), getExtent(), destExtent, width, height, errorTolerance);
     }
     else
     {
@@ -1100,6 +1289,12 @@ GeoHeightField::getExtent() const
     return _extent;
 }
 
+const VerticalSpatialReference*
+GeoHeightField::getVerticalSRS() const
+{
+    return _vsrs.get();
+}
+
 const osg::HeightField*
 GeoHeightField::getHeightField() const
 {
@@ -25,6 +25,7 @@
 #include <osgDB/Registry>
 #include <osgDB/FileNameUtils>
 #include <osg/Notify>
+#include <OpenThreads/ScopedLock>
 #include <string.h>
 #include <sstream>
 #include <fstream>
@@ -252,42 +253,61 @@ HTTPResponse::getMimeType() const {
 #define QUOTE(X) QUOTE_(X)
 #define USER_AGENT "osgearth" QUOTE(OSGEARTH_MAJOR_VERSION) "." QUOTE(OSGEARTH_MINOR_VERSION)
 
-typedef std::map< OpenThreads::Thread*, osg::ref_ptr<HTTPClient> >    ThreadClientMap;        
-static Threading::ReadWriteMutex   _threadClientMapMutex;
-static ThreadClientMap             _threadClientMap;
+typedef std::vector< osg::ref_ptr<HTTPClient> > ClientPool;
+static OpenThreads::Mutex          _clientPoolMutex;
+static ClientPool                  _clientPool;
 static optional<ProxySettings>     _proxySettings;
 static std::string                 _userAgent = USER_AGENT;
-
-HTTPClient& HTTPClient::getClient()
+static unsigned int                _maxConnectionsPerHost = 6;
+static unsigned int                _maxConnections = 32;
+
+/**
+ * Checks an HTTPClient out of the pool of idle clients, creating a new one if the
+ * pool is empty, and returns it when done. Each client's CURL handle keeps its own
+ * connection cache, so recycling clients (rather than keeping one per thread forever)
+ * preserves keep-alive connections while bounding the number of handles to the
+ * number of concurrent requests.
+ */
+class HTTPClient::ScopedClient
 {
-    OpenThreads::Thread* current = OpenThreads::Thread::CurrentThread();
-
-    // first try the map:
+public:
+    ScopedClient()
     {
-        Threading::ScopedReadLock sharedLock(_threadClientMapMutex);
-        ThreadClientMap::iterator i = _threadClientMap.find(current);
-        if ( i != _threadClientMap.end() )
-            return *i->second.get();
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _clientPoolMutex );
+            if ( _clientPool.size() > 0 )
+            {
+                _client = _clientPool.back();
+                _clientPool.pop_back();
+            }
+        }
+        if ( !_client.valid() )
+            _client = new HTTPClient();
     }
 
-    // not there; add it.
+    ~ScopedClient()
     {
-        Threading::ScopedWriteLock exclusiveLock(_threadClientMapMutex);
-
-        // normally, we'd double check b/c of the race condition, but since the map is being 
-        // indexed by the actual thread pointer, there's no chance of a race.
-        HTTPClient* client = new HTTPClient();
-        _threadClientMap[current] = client;
-        return *client;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _clientPoolMutex );
+        if ( _clientPool.size() < _maxConnections )
+            _clientPool.push_back( _client.get() );
     }
-}
+
+    HTTPClient* operator -> () { return _client.get(); }
+
+private:
+    osg::ref_ptr<HTTPClient> _client;
+};
 
 HTTPClient::HTTPClient()
 {
     _previousHttpAuthentication = 0;
     _curl_handle = curl_easy_init();
+    initHandle( _curl_handle );
+}
 
-
+void
+HTTPClient::initHandle( void* curl_handle )
+{
 	//Get the user agent
 	std::string userAgent = _userAgent;
 	const char* userAgentEnv = getenv("OSGEARTH_USERAGENT");
@@ -298,13 +318,19 @@ HTTPClient::HTTPClient()
 
 	OE_DEBUG << LC << "HTTPClient setting userAgent=" << userAgent << std::endl;
 
-    curl_easy_setopt( _curl_handle, CURLOPT_USERAGENT, userAgent.c_str() );
-    curl_easy_setopt( _curl_handle, CURLOPT_WRITEFUNCTION, osgEarth::StreamObjectReadCallback );
-    curl_easy_setopt( _curl_handle, CURLOPT_FOLLOWLOCATION, (void*)1 );
-    curl_easy_setopt( _curl_handle, CURLOPT_MAXREDIRS, (void*)5 );
-    curl_easy_setopt( _curl_handle, CURLOPT_PROGRESSFUNCTION, &CurlProgressCallback);
-    curl_easy_setopt( _curl_handle, CURLOPT_NOPROGRESS, (void*)0 ); //FALSE);
-    //curl_easy_setopt( _curl_handle, CURLOPT_TIMEOUT, 1L );
+    // note: curl copies string options (7.17.0+)
+    curl_easy_setopt( curl_handle, CURLOPT_USERAGENT, userAgent.c_str() );
+    curl_easy_setopt( curl_handle, CURLOPT_WRITEFUNCTION, osgEarth::StreamObjectReadCallback );
+    curl_easy_setopt( curl_handle, CURLOPT_FOLLOWLOCATION, (void*)1 );
+    curl_easy_setopt( curl_handle, CURLOPT_MAXREDIRS, (void*)5 );
+    curl_easy_setopt( curl_handle, CURLOPT_PROGRESSFUNCTION, &CurlProgressCallback);
+    curl_easy_setopt( curl_handle, CURLOPT_NOPROGRESS, (void*)0 ); //FALSE);
+    //curl_easy_setopt( curl_handle, CURLOPT_TIMEOUT, 1L );
+
+#if LIBCURL_VERSION_NUM >= 0x071900
+    // keep idle connections alive so they can be reused for the next tile
+    curl_easy_setopt( curl_handle, CURLOPT_TCP_KEEPALIVE, 1L );
+#endif
 }
 
 HTTPClient::~HTTPClient()
@@ -330,7 +356,31 @@ void  HTTPClient::setUserAgent(const std::string& userAgent)
 }
 
 void
-HTTPClient::readOptions( const osgDB::ReaderWriter::Options* options, std::string& proxy_host, std::string& proxy_port) const
+HTTPClient::setMaxConnectionsPerHost( unsigned int value )
+{
+    _maxConnectionsPerHost = osg::maximum( value, 1u );
+}
+
+unsigned int
+HTTPClient::getMaxConnectionsPerHost()
+{
+    return _maxConnectionsPerHost;
+}
+
+void
+HTTPClient::setMaxConnections( unsigned int value )
+{
+    _maxConnections = osg::maximum( value, 1u );
+}
+
+unsigned int
+HTTPClient::getMaxConnections()
+{
+    return _maxConnections;
+}
+
+void
+HTTPClient::readOptions( const osgDB::ReaderWriter::Options* options, std::string& proxy_host, std::string& proxy_port)
 {
     // try to set proxy host/port by reading the CURL proxy options
     if ( options )
@@ -382,7 +432,7 @@ tokenize_str(const std::string & str, const std::string & delims=", \t")
 void
 HTTPClient::decodeMultipartStream(const std::string&   boundary,
                                   HTTPResponse::Part*  input,
-                                  HTTPResponse::Parts& output) const
+                                  HTTPResponse::Parts& output)
 {
     std::string bstr = std::string("--") + boundary;
     std::string line;
@@ -469,7 +519,8 @@ HTTPClient::get( const HTTPRequest& request,
                  const osgDB::ReaderWriter::Options* options,
                  ProgressCallback* callback)
 {
-    return getClient().doGet( request, options, callback );
+    ScopedClient client;
+    return client->doGet( request, options, callback );
 }
 
 HTTPResponse 
@@ -477,7 +528,8 @@ HTTPClient::get( const std::string &url,
                  const osgDB::ReaderWriter::Options* options,
                  ProgressCallback* callback)
 {
-    return getClient().doGet( url, options, callback);
+    ScopedClient client;
+    return client->doGet( url, options, callback);
 }
 
 HTTPClient::ResultCode
@@ -486,7 +538,8 @@ HTTPClient::readImageFile(const std::string &filename,
                           const osgDB::ReaderWriter::Options *options,
                           osgEarth::ProgressCallback *callback)
 {
-    return getClient().doReadImageFile( filename, output, options, callback );
+    ScopedClient client;
+    return client->doReadImageFile( filename, output, options, callback );
 }
 
 HTTPClient::ResultCode
@@ -495,7 +548,8 @@ HTTPClient::readNodeFile(const std::string& filename,
                          const osgDB::ReaderWriter::Options *options,
                          osgEarth::ProgressCallback *callback)
 {
-    return getClient().doReadNodeFile( filename, output, options, callback );
+    ScopedClient client;
+    return client->doReadNodeFile( filename, output, options, callback );
 }
 
 HTTPClient::ResultCode
@@ -503,23 +557,16 @@ HTTPClient::readString(const std::string& filename,
                        std::string& output,
                        osgEarth::ProgressCallback* callback)
 {
-    return getClient().doReadString( filename, output, callback );
+    ScopedClient client;
+    return client->doReadString( filename, output, callback );
 }
 
-HTTPResponse
-HTTPClient::doGet( const HTTPRequest& request, const osgDB::ReaderWriter::Options* options, ProgressCallback* callback) const
+void
+HTTPClient::getProxySettings( const osgDB::ReaderWriter::Options* options, std::string& proxy_addr, std::string& proxy_auth )
 {
-    OE_DEBUG << LC << "doGet " << request.getURL() << std::endl;
-
-    const osgDB::AuthenticationMap* authenticationMap = (options && options->getAuthenticationMap()) ? 
-            options->getAuthenticationMap() :
-            osgDB::Registry::instance()->getAuthenticationMap();
-
     std::string proxy_host;
     std::string proxy_port = "8080";
 
-	std::string proxy_auth;
-
 	//Try to get the proxy settings from the global settings
 	if (_proxySettings.isSet())
 	{
@@ -559,7 +606,6 @@ HTTPClient::doGet( const HTTPRequest& request, const osgDB::ReaderWriter::Option
 	}
 
     // Set up proxy server:
-    std::string proxy_addr;
     if ( !proxy_host.empty() )
     {
         std::stringstream buf;
@@ -567,7 +613,93 @@ HTTPClient::doGet( const HTTPRequest& request, const osgDB::ReaderWriter::Option
 		std::string bufStr;
 		bufStr = buf.str();
         proxy_addr = bufStr;
-    
+    }
+}
+
+const osgDB::AuthenticationDetails*
+HTTPClient::getAuthenticationDetails( const std::string& url, const osgDB::ReaderWriter::Options* options )
+{
+    const osgDB::AuthenticationMap* authenticationMap = (options && options->getAuthenticationMap()) ? 
+            options->getAuthenticationMap() :
+            osgDB::Registry::instance()->getAuthenticationMap();
+
+    return authenticationMap ?
+        authenticationMap->getAuthenticationDetails(url) :
+        0;
+}
+
+HTTPResponse
+HTTPClient::makeResponse( void* curl_handle, int curl_result, HTTPResponse::Part* part, const std::string& url )
+{
+    CURLcode res = (CURLcode)curl_result;
+
+    long response_code = 0L;
+    curl_easy_getinfo( curl_handle, CURLINFO_RESPONSE_CODE, &response_code );     
+
+	OE_DEBUG << LC << "got response, code = " << response_code << std::endl;
+
+    HTTPResponse response( response_code );
+   
+    if ( response_code == 200L && res != CURLE_ABORTED_BY_CALLBACK && res != CURLE_OPERATION_TIMEDOUT ) //res == 0 )
+    {
+        // check for multipart content:
+        char* content_type_cp;
+        curl_easy_getinfo( curl_handle, CURLINFO_CONTENT_TYPE, &content_type_cp );
+        if ( content_type_cp == NULL )
+        {
+            OE_NOTICE << LC
+                << "NULL Content-Type (protocol violation) " 
+                << "URL=" << url << std::endl;
+            return NULL;
+        }
+
+        // NOTE:
+        //   WCS 1.1 specified a "multipart/mixed" response, but ArcGIS Server gives a "multipart/related"
+        //   content type ...
+
+        std::string content_type( content_type_cp );
+        //OE_NOTICE << "[osgEarth.HTTPClient] content-type = \"" << content_type << "\"" << std::endl;
+        if ( content_type.length() > 9 && ::strstr( content_type.c_str(), "multipart" ) == content_type.c_str() )
+        //if ( content_type == "multipart/mixed; boundary=wcs" ) //todo: parse this.
+        {
+            //OE_NOTICE << "[osgEarth.HTTPClient] detected multipart data; decoding..." << std::endl;
+            //TODO: parse out the "wcs" -- this is WCS-specific
+            decodeMultipartStream( "wcs", part, response._parts );
+        }
+        else
+        {
+            //OE_NOTICE << "[osgEarth.HTTPClient] detected single part data" << std::endl;
+            response._parts.push_back( part );
+        }
+    }
+    else if (res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_OPERATION_TIMEDOUT)
+    {
+        //If we were aborted by a callback, then it was cancelled by a user
+        response._cancelled = true;
+    }
+
+    // Store the mime-type, if any. (Note: CURL manages the buffer returned by
+    // this call.)
+    char* ctbuf = NULL;
+    if ( curl_easy_getinfo(curl_handle, CURLINFO_CONTENT_TYPE, &ctbuf) == 0 && ctbuf )
+    {
+        response._mimeType = ctbuf;
+    }
+
+    return response;
+}
+
+HTTPResponse
+HTTPClient::doGet( const HTTPRequest& request, const osgDB::ReaderWriter::Options* options, ProgressCallback* callback) const
+{
+    OE_DEBUG << LC << "doGet " << request.getURL() << std::endl;
+
+    std::string proxy_addr;
+	std::string proxy_auth;
+    getProxySettings( options, proxy_addr, proxy_auth );
+
+    if ( !proxy_addr.empty() )
+    {
         OE_DEBUG << LC << "setting proxy: " << proxy_addr << std::endl;
 		//curl_easy_setopt( _curl_handle, CURLOPT_HTTPPROXYTUNNEL, 1 ); 
         curl_easy_setopt( _curl_handle, CURLOPT_PROXY, proxy_addr.c_str() );
@@ -580,9 +712,7 @@ HTTPClient::doGet( const HTTPRequest& request, const osgDB::ReaderWriter::Option
 		}
     }
 
-    const osgDB::AuthenticationDetails* details = authenticationMap ?
-        authenticationMap->getAuthenticationDetails(request.getURL()) :
-        0;
+    const osgDB::AuthenticationDetails* details = getAuthenticationDetails( request.getURL(), options );
 
         if (details)
         {
@@ -639,88 +769,18 @@ HTTPClient::doGet( const HTTPRequest& request, const osgDB::ReaderWriter::Option
     CURLcode res = curl_easy_perform( _curl_handle );
     curl_easy_setopt( _curl_handle, CURLOPT_WRITEDATA, (void*)0 );
     curl_easy_setopt( _curl_handle, CURLOPT_PROGRESSDATA, (void*)0);
+    curl_easy_setopt( _curl_handle, CURLOPT_ERRORBUFFER, (void*)0 );
 
-    long response_code = 0L;
 	if (!proxy_addr.empty())
 	{
 		long connect_code = 0L;
         curl_easy_getinfo( _curl_handle, CURLINFO_HTTP_CONNECTCODE, &connect_code );
 		OE_DEBUG << LC << "proxy connect code " << connect_code << std::endl;
 	}
-	
-    curl_easy_getinfo( _curl_handle, CURLINFO_RESPONSE_CODE, &response_code );     
 
-	OE_DEBUG << LC << "got response, code = " << response_code << std::endl;
-
-    HTTPResponse response( response_code );
-   
-    if ( response_code == 200L && res != CURLE_ABORTED_BY_CALLBACK && res != CURLE_OPERATION_TIMEDOUT ) //res == 0 )
-    {
-        // check for multipart content:
-        char* content_type_cp;
-        curl_easy_getinfo( _curl_handle, CURLINFO_CONTENT_TYPE, &content_type_cp );
-        if ( content_type_cp == NULL )
-        {
-            OE_NOTICE << LC
-                << "NULL Content-Type (protocol violation) " 
-                << "URL=" << request.getURL() << std::endl;
-            return NULL;
-        }
-
-        // NOTE:
-        //   WCS 1.1 specified a "multipart/mixed" response, but ArcGIS Server gives a "multipart/related"
-        //   content type ...
-
-        std::string content_type( content_type_cp );
-        //OE_NOTICE << "[osgEarth.HTTPClient] content-type = \"" << content_type << "\"" << std::endl;
-        if ( content_type.length() > 9 && ::strstr( content_type.c_str(), "multipart" ) == content_type.c_str() )
-        //if ( content_type == "multipart/mixed; boundary=wcs" ) //todo: parse this.
-        {
-            //OE_NOTICE << "[osgEarth.HTTPClient] detected multipart data; decoding..." << std::endl;
-            //TODO: parse out the "wcs" -- this is WCS-specific
-            decodeMultipartStream( "wcs", part.get(), response._parts );
-        }
-        else
-        {
-            //OE_NOTICE << "[osgEarth.HTTPClient] detected single part data" << std::endl;
-            response._parts.push_back( part.get() );
-        }
-    }
-    else if (res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_OPERATION_TIMEDOUT)
-    {
-        //If we were aborted by a callback, then it was cancelled by a user
-        response._cancelled = true;
-    }
-    else
-    {        
-        //if ( callback )
-        //{
-        //    if ( errorBuf[0] ) {
-        //        callback->message() = errorBuf;
-        //    }
-        //    else {
-        //        std::stringstream buf;
-        //        buf << "HTTP Code " << response.getCode();
-        //        callback->message() = buf.str();
-        //    }
-        //}
-        //else {
-        //    OE_NOTICE << "[osgEarth] [HTTP] error, code = " << code << std::endl;
-        //}
-    }
-
-    // Store the mime-type, if any. (Note: CURL manages the buffer returned by
-    // this call.)
-    char* ctbuf = NULL;
-    if ( curl_easy_getinfo(_curl_handle, CURLINFO_CONTENT_TYPE, &ctbuf) == 0 && ctbuf )
-    {
-        response._mimeType = ctbuf;
-    }
-
-    return response;
+    return makeResponse( _curl_handle, res, part.get(), request.getURL() );
 }
 
-
 HTTPResponse
 HTTPClient::doGet( const std::string& url, const osgDB::ReaderWriter::Options* options, ProgressCallback* callback) const
 {
@@ -993,3 +1053,310 @@ HTTPClient::doReadString(const std::string& filename,
 
     return result;
 }
+
+/****************************************************************************/
+
+HTTPFuture::HTTPFuture(const HTTPRequest&                  request,
+                       const osgDB::ReaderWriter::Options* options,
+                       ProgressCallback*                   progress,
+                       Callback*                           callback ) :
+_request ( request ),
+_options ( options ),
+_progress( progress ),
+_callback( callback )
+{
+    //nop
+}
+
+bool
+HTTPFuture::isAvailable() const
+{
+    return _ready.isSet();
+}
+
+const HTTPResponse&
+HTTPFuture::getResponse() const
+{
+    // loop to guard against spurious wakeups
+    while( !_ready.isSet() )
+        _ready.wait();
+    return _response;
+}
+
+/****************************************************************************/
+
+namespace osgEarth
+{
+    /**
+     * Services all asynchronous HTTP requests from a single I/O thread, using a CURL
+     * "multi" handle. The multi handle owns a shared connection cache, so requests to
+     * the same server reuse keep-alive connections (and multiplex over HTTP/2 where
+     * the server supports it).
+     */
+    class HTTPAsyncService : public OpenThreads::Thread
+    {
+    public:
+        static HTTPAsyncService* instance()
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock( s_mutex );
+            if ( !s_holder._service )
+            {
+                s_holder._service = new HTTPAsyncService();
+                s_holder._service->start();
+            }
+            return s_holder._service;
+        }
+
+        void submit( HTTPFuture* future )
+        {
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _queueMutex );
+                _queue.push_back( future );
+            }
+            _wake.set();
+        }
+
+        void run()
+        {
+            CURLM* multi = curl_multi_init();
+            unsigned int maxPerHost = 0, maxConnections = 0;
+
+            while( !_done )
+            {
+                // pick up any new requests:
+                std::vector< osg::ref_ptr<HTTPFuture> > incoming;
+                {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _queueMutex );
+                    incoming.swap( _queue );
+                }
+
+                // the connection limits may change at any time; a multi handle may only
+                // be touched from this thread, so apply them here.
+                if ( maxPerHost != _maxConnectionsPerHost || maxConnections != _maxConnections )
+                {
+                    maxPerHost     = _maxConnectionsPerHost;
+                    maxConnections = _maxConnections;
+#if LIBCURL_VERSION_NUM >= 0x071003
+                    curl_multi_setopt( multi, CURLMOPT_MAXCONNECTS, (long)maxConnections );
+#endif
+#if LIBCURL_VERSION_NUM >= 0x071e00
+                    curl_multi_setopt( multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)maxPerHost );
+                    curl_multi_setopt( multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)maxConnections );
+#endif
+#ifdef CURLPIPE_MULTIPLEX
+                    curl_multi_setopt( multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+#endif
+                }
+
+                for( unsigned int i=0; i<incoming.size(); ++i )
+                {
+                    startTransfer( multi, incoming[i].get() );
+                }
+
+                if ( _transfers.empty() )
+                {
+                    // nothing to do; sleep until someone submits a request.
+                    _wake.waitAndReset();
+                    continue;
+                }
+
+                int running = 0;
+                curl_multi_perform( multi, &running );
+
+                CURLMsg* msg;
+                int msgsLeft = 0;
+                while( (msg = curl_multi_info_read(multi, &msgsLeft)) != 0L )
+                {
+                    if ( msg->msg == CURLMSG_DONE )
+                    {
+                        finishTransfer( multi, msg->easy_handle, msg->data.result );
+                    }
+                }
+
+                if ( running > 0 )
+                {
+                    // wait for socket activity, but wake up regularly to pick up new requests.
+#if LIBCURL_VERSION_NUM >= 0x071c00
+                    curl_multi_wait( multi, 0L, 0, 10, 0L );
+#else
+                    fd_set readfds, writefds, errfds;
+                    FD_ZERO( &readfds );
+                    FD_ZERO( &writefds );
+                    FD_ZERO( &errfds );
+                    int maxfd = -1;
+                    curl_multi_fdset( multi, &readfds, &writefds, &errfds, &maxfd );
+                    if ( maxfd >= 0 )
+                    {
+                        struct timeval timeout;
+                        timeout.tv_sec  = 0;
+                        timeout.tv_usec = 10000;
+                        ::select( maxfd+1, &readfds, &writefds, &errfds, &timeout );
+                    }
+                    else
+                    {
+                        OpenThreads::Thread::microSleep( 10000 );
+                    }
+#endif
+                }
+            }
+
+            // shutting down: anything still in flight is cancelled.
+            for( Transfers::iterator i = _transfers.begin(); i != _transfers.end(); ++i )
+            {
+                curl_multi_remove_handle( multi, i->first );
+                curl_easy_cleanup( i->first );
+                i->second->_future->_response._cancelled = true;
+                i->second->_future->_ready.set();
+                delete i->second;
+            }
+            _transfers.clear();
+
+            for( unsigned int i=0; i<_idleHandles.size(); ++i )
+                curl_easy_cleanup( _idleHandles[i] );
+            _idleHandles.clear();
+
+            curl_multi_cleanup( multi );
+        }
+
+        int cancel()
+        {
+            if ( isRunning() )
+            {
+                _done = true;
+                _wake.set();
+                while( isRunning() )
+                    OpenThreads::Thread::YieldCurrentThread();
+            }
+            return 0;
+        }
+
+    private:
+        // Deletes the service (stopping its thread) at exit.
+        struct Holder
+        {
+            Holder() : _service( 0L ) { }
+            ~Holder() { if ( _service ) { _service->cancel(); delete _service; } }
+            HTTPAsyncService* _service;
+        };
+
+        // Everything that has to outlive a single in-flight request.
+        struct Transfer
+        {
+            Transfer( HTTPFuture* future ) :
+                _future( future ),
+                _part  ( new HTTPResponse::Part() ),
+                _stream( &_part->_stream ) { }
+
+            osg::ref_ptr<HTTPFuture>         _future;
+            osg::ref_ptr<HTTPResponse::Part> _part;
+            StreamObject                     _stream;
+            std::string                      _url;
+            std::string                      _proxyAddr;
+            std::string                      _proxyAuth;
+            std::string                      _userPassword;
+        };
+
+        typedef std::map< CURL*, Transfer* > Transfers;
+
+        static OpenThreads::Mutex s_mutex;
+        static Holder             s_holder;
+
+        HTTPAsyncService() : _done( false ) { }
+
+        void startTransfer( CURLM* multi, HTTPFuture* future )
+        {
+            CURL* handle;
+            if ( _idleHandles.size() > 0 )
+            {
+                handle = _idleHandles.back();
+                _idleHandles.pop_back();
+            }
+            else
+            {
+                handle = curl_easy_init();
+            }
+            HTTPClient::initHandle( handle );
+
+            Transfer* t = new Transfer( future );
+            t->_url = future->getRequest().getURL();
+
+            OE_DEBUG << LC << "getAsync " << t->_url << std::endl;
+
+            HTTPClient::getProxySettings( future->_options.get(), t->_proxyAddr, t->_proxyAuth );
+            if ( !t->_proxyAddr.empty() )
+            {
+                curl_easy_setopt( handle, CURLOPT_PROXY, t->_proxyAddr.c_str() );
+                if ( !t->_proxyAuth.empty() )
+                    curl_easy_setopt( handle, CURLOPT_PROXYUSERPWD, t->_proxyAuth.c_str() );
+            }
+
+            const osgDB::AuthenticationDetails* details =
+                HTTPClient::getAuthenticationDetails( t->_url, future->_options.get() );
+            if ( details )
+            {
+                t->_userPassword = details->username + std::string(":") + details->password;
+                curl_easy_setopt( handle, CURLOPT_USERPWD, t->_userPassword.c_str() );
+#if LIBCURL_VERSION_NUM >= 0x070a07
+                curl_easy_setopt( handle, CURLOPT_HTTPAUTH, details->httpAuthentication );
+#endif
+            }
+
+            curl_easy_setopt( handle, CURLOPT_URL, t->_url.c_str() );
+            curl_easy_setopt( handle, CURLOPT_WRITEDATA, (void*)&t->_stream );
+            curl_easy_setopt( handle, CURLOPT_PROGRESSDATA, (void*)future->_progress.get() );
+
+            _transfers[handle] = t;
+            curl_multi_add_handle( multi, handle );
+        }
+
+        void finishTransfer( CURLM* multi, CURL* handle, CURLcode result )
+        {
+            Transfers::iterator i = _transfers.find( handle );
+            if ( i == _transfers.end() )
+                return;
+
+            Transfer* t = i->second;
+            _transfers.erase( i );
+
+            curl_multi_remove_handle( multi, handle );
+
+            HTTPFuture* future = t->_future.get();
+            future->_response = HTTPClient::makeResponse( handle, result, t->_part.get(), t->_url );
+
+            // recycle the handle. Connections live in the multi handle's cache, so this
+            // just saves re-creating the easy handle.
+            curl_easy_reset( handle );
+            if ( _idleHandles.size() < _maxConnections )
+                _idleHandles.push_back( handle );
+            else
+                curl_easy_cleanup( handle );
+
+            future->_ready.set();
+            if ( future->_callback.valid() )
+                future->_callback->onResponse( future );
+
+            delete t;
+        }
+
+        volatile bool                           _done;
+        Threading::Event                        _wake;
+        OpenThreads::Mutex                      _queueMutex;
+        std::vector< osg::ref_ptr<HTTPFuture> > _queue;
+        Transfers                               _transfers;
+        std::vector<CURL*>                      _idleHandles;
+    };
+
+    OpenThreads::Mutex       HTTPAsyncService::s_mutex;
+    HTTPAsyncService::Holder HTTPAsyncService::s_holder;
+}
+
+HTTPFuture*
+HTTPClient::getAsync(const HTTPRequest&                  request,
+                     const osgDB::ReaderWriter::Options* options,
+                     ProgressCallback*                   progress,
+                     HTTPFuture::Callback*               callback )
+{
+    HTTPFuture* future = new HTTPFuture( request, options, progress, callback );
+    HTTPAsyncService::instance()->submit( future );
+    return future;
+}
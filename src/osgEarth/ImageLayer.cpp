@@ -138,6 +138,18 @@ namespace
         ImageLayerTileProcessor _processor;
     };
     
+    /**
+     * Takes ownership of an image fetched from a cache. A persistent cache hands
+     * back a freshly decoded image that nothing else references, so there's no
+     * need to copy it; an image shared with a memory cache has to be cloned.
+     */
+    osg::Image* takeCachedImage( osg::ref_ptr<const osg::Image>& cached )
+    {
+        if ( cached.valid() && cached->referenceCount() == 1 )
+            return const_cast<osg::Image*>( cached.release() );
+        return ImageUtils::cloneImage( cached.get() );
+    }
+
     struct ApplyChromaKey
     {
         osg::Vec4f _chromaKey;
@@ -350,8 +362,47 @@ ImageLayer::initPreCacheOp()
     _preCacheOp = op;
 }
 
+bool
+ImageLayer::isCachedInMapProfile( const Profile* mapProfile ) const
+{
+    const Profile* layerProfile = getProfile();
+    if ( !layerProfile || mapProfile->isEquivalentTo( layerProfile ) )
+        return true;
+
+	//If the map profile and layer profile are in the same SRS but with different tiling scemes and exact cropping is not required, cache in the layer profile.
+    return !( mapProfile->getSRS()->isEquivalentTo( layerProfile->getSRS() ) && _options.exactCropping() == false );
+}
+
 GeoImage
 ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
+{
+    // If another thread is already fetching this tile, wait for it and share the result.
+    osg::ref_ptr<PendingTile> pending;
+    while( !beginTileRequest(key, pending) )
+    {
+        osg::ref_ptr<osg::Object> image;
+        GeoExtent extent;
+        if ( waitForTile(pending.get(), image, extent) )
+        {
+            return image.valid() ?
+                GeoImage( static_cast<osg::Image*>(image.get()), extent ) :
+                GeoImage::INVALID;
+        }
+
+        if ( progress && progress->isCanceled() )
+            return GeoImage::INVALID;
+
+        // the other fetch was canceled, so try again ourselves.
+        pending = 0L;
+    }
+
+    GeoImage result = doCreateImage( key, progress );
+    endTileRequest( key, pending.get(), result.getImage(), result.getExtent(), progress );
+    return result;
+}
+
+GeoImage
+ImageLayer::doCreateImage( const TileKey& key, ProgressCallback* progress)
 {
     GeoImage result;
 
@@ -372,18 +423,7 @@ ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
 	}
 
 	//Determine whether we should cache in the Map profile or the Layer profile.
-	bool cacheInMapProfile = true;
-	if (mapProfile->isEquivalentTo( layerProfile ))
-	{
-		OE_DEBUG << LC << "Layer \"" << getName() << "\": Map and Layer profiles are equivalent " << std::endl;
-	}
-	//If the map profile and layer profile are in the same SRS but with different tiling scemes and exact cropping is not required, cache in the layer profile.
-    else if (mapProfile->getSRS()->isEquivalentTo( layerProfile->getSRS()) && _options.exactCropping() == false )
-	{
-		OE_DEBUG << LC << "Layer \"" << getName() << "\": Map and Layer profiles are in the same SRS and non-exact cropping is allowed, caching in layer profile." << std::endl;
-		cacheInMapProfile = false;
-	}
-
+	bool cacheInMapProfile = isCachedInMapProfile( mapProfile );
 	bool cacheInLayerProfile = !cacheInMapProfile;
 
     //Write the cache TMS file if it hasn't been written yet.
@@ -406,7 +446,7 @@ ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
 		{
 			OE_DEBUG << LC << "Layer \"" << getName()<< "\" got tile " << key.str() << " from map cache " << std::endl;
 
-            result = GeoImage( ImageUtils::cloneImage(cachedImage.get()), key.getExtent() );
+            result = GeoImage( takeCachedImage(cachedImage), key.getExtent() );
             ImageUtils::normalizeImage( result.getImage() );
             return result;
 		}
@@ -580,10 +620,12 @@ ImageLayer::createImage( const TileKey& key, ProgressCallback* progress)
 
                 // We actually need to reproject the image.  Note: GeoImage::reproject() will automatically
                 // crop the image to the correct extents, so there is no need to crop after reprojection.
+                GeoExtent keyExtent = key.getExtent();
                 result = mosaic.reproject( 
                     key.getProfile()->getSRS(),
-                    &key.getExtent(), 
-                    _options.reprojectedTileSize().value(), _options.reprojectedTileSize().value() );
+                    &keyExtent, 
+                    _options.reprojectedTileSize().value(), _options.reprojectedTileSize().value(),
+                    _options.reprojectionTolerance().value() );
             }
             else
             {
@@ -645,7 +687,16 @@ ImageLayer::createImageWrapper(const TileKey& key,
 		if ( _cache->getImage( key, _cacheSpec, cachedImage ) )
 	    {
             OE_INFO << LC << " Layer \"" << getName() << "\" got " << key.str() << " from cache " << std::endl;
-            return ImageUtils::cloneImage(cachedImage.get());
+
+            // Tiles cached in the layer profile still get mosaicked and cropped into the
+            // map profile, which needs readable pixels; expand compressed tiles (e.g. from
+            // an osgearth_dxt cache). If we can't, fall through and build the tile anew.
+            if ( !ImageUtils::isCompressed(cachedImage.get()) )
+                return takeCachedImage(cachedImage);
+
+            osg::Image* image = ImageUtils::decompress( cachedImage.get() );
+            if ( image )
+                return image;
     	}
     }
 
@@ -26,6 +26,11 @@
 #include <string.h>
 #include <memory.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define OE_IMAGEUTILS_SSE2 1
+#endif
+
 #define LC "[ImageUtils] "
 
 using namespace osgEarth;
@@ -90,11 +95,13 @@ ImageUtils::copyAsSubImage(const osg::Image* src, osg::Image* dst, int dst_start
         PixelReader read(src);
         PixelWriter write(dst);
 
-        for( int src_t=0, dst_t=dst_start_row; src_t < src->t(); src_t++, dst_t++ )
+        if ( src->s() > 0 )
         {
-            for( int src_s=0, dst_s=dst_start_col; src_s < src->s(); src_s++, dst_s++ )
-            {           
-                write( read(src_s, src_t), dst_s, dst_t );
+            std::vector<osg::Vec4f> row( src->s() );
+            for( int src_t=0, dst_t=dst_start_row; src_t < src->t(); src_t++, dst_t++ )
+            {
+                read.readSpan( &row[0], 0, src_t, src->s() );
+                write.writeSpan( &row[0], dst_start_col, dst_t, src->s() );
             }
         }
     }
@@ -157,12 +164,22 @@ ImageUtils::resizeImage(const osg::Image* input,
         PixelReader read( input );
         PixelWriter write( output.get() );
 
-        unsigned int pixel_size_bytes = input->getRowSizeInBytes() / in_s;
+        // nearest-neighbor: the input column for each output column is the same on every row,
+        // so compute them once.
+        std::vector<int> input_cols( out_s );
+        for( unsigned int output_col = 0; output_col < out_s; output_col++ )
+        {
+            float output_col_ratio = (float)output_col/(float)out_s;
+            int input_col = (unsigned int)( output_col_ratio * (float)in_s );
+            if ( input_col >= (int)in_s ) input_col = in_s-1;
+            input_cols[output_col] = input_col;
+        }
 
-        unsigned char* dataOffset = output->getMipmapData(mipmapLevel);
-        unsigned int   dataRowSizeBytes = output->getRowSizeInBytes() >> mipmapLevel;
+        std::vector<osg::Vec4f> input_row_buf( in_s );
+        std::vector<osg::Vec4f> output_row_buf( out_s );
+        int last_input_row = -1;
 
-        for( unsigned int output_row=0; output_row < out_t; output_row++ )
+        for( unsigned int output_row=0; output_row < out_t && out_s > 0 && in_s > 0; output_row++ )
         {
             // get an appropriate input row
             float output_row_ratio = (float)output_row/(float)out_t;
@@ -170,16 +187,16 @@ ImageUtils::resizeImage(const osg::Image* input,
             if ( input_row >= input->t() ) input_row = in_t-1;
             else if ( input_row < 0 ) input_row = 0;
 
-            for( unsigned int output_col = 0; output_col < out_s; output_col++ )
+            // when enlarging, consecutive output rows sample the same input row.
+            if ( input_row != last_input_row )
             {
-                float output_col_ratio = (float)output_col/(float)out_s;
-                int input_col = (unsigned int)( output_col_ratio * (float)in_s );
-                if ( input_col >= (int)in_s ) input_col = in_s-1;
-                else if ( input_row < 0 ) input_row = 0;
-
-                osg::Vec4 color = read( input_col, input_row ); // read pixel from mip level 0
-                write( color, output_col, output_row, 0, mipmapLevel ); // write to target mip level
+                read.readSpan( &input_row_buf[0], 0, input_row, in_s ); // read from mip level 0
+                for( unsigned int output_col = 0; output_col < out_s; output_col++ )
+                    output_row_buf[output_col] = input_row_buf[input_cols[output_col]];
+                last_input_row = input_row;
             }
+
+            write.writeSpan( &output_row_buf[0], 0, output_row, out_s, 0, mipmapLevel ); // write to target mip level
         }
     }
 
@@ -505,6 +522,133 @@ ImageUtils::isCompressed(const osg::Image *image)
     }
 }
 
+namespace
+{
+    // expands a 5:6:5 color to 8 bits per channel.
+    void decode565( unsigned short c, unsigned char* out )
+    {
+        unsigned r = (c >> 11) & 0x1f, g = (c >> 5) & 0x3f, b = c & 0x1f;
+        out[0] = (unsigned char)((r << 3) | (r >> 2));
+        out[1] = (unsigned char)((g << 2) | (g >> 4));
+        out[2] = (unsigned char)((b << 3) | (b >> 2));
+        out[3] = 255;
+    }
+
+    // decodes the 8-byte color part of a block into 16 RGBA pixels.
+    void decodeColorBlock( const unsigned char* block, bool dxt1, bool dxt1Alpha, unsigned char* out )
+    {
+        unsigned short c0 = block[0] | (block[1] << 8);
+        unsigned short c1 = block[2] | (block[3] << 8);
+        unsigned char palette[4][4];
+        decode565( c0, palette[0] );
+        decode565( c1, palette[1] );
+
+        // DXT1 with c0 <= c1 is the 3-color mode, whose 4th entry is transparent black.
+        bool fourColor = !dxt1 || c0 > c1;
+        for( unsigned k = 0; k < 3; ++k )
+        {
+            if ( fourColor )
+            {
+                palette[2][k] = (unsigned char)((2*palette[0][k] + palette[1][k]) / 3);
+                palette[3][k] = (unsigned char)((palette[0][k] + 2*palette[1][k]) / 3);
+            }
+            else
+            {
+                palette[2][k] = (unsigned char)((palette[0][k] + palette[1][k]) / 2);
+                palette[3][k] = 0;
+            }
+        }
+        palette[2][3] = 255;
+        palette[3][3] = fourColor || !dxt1Alpha ? 255 : 0;
+
+        unsigned bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned)block[7] << 24);
+        for( unsigned i = 0; i < 16; ++i, bits >>= 2 )
+            memcpy( out + 4*i, palette[bits & 3], 4 );
+    }
+}
+
+osg::Image*
+ImageUtils::decompress( const osg::Image* image )
+{
+    if ( !image || !image->data() )
+        return 0L;
+
+    GLenum format = image->getPixelFormat();
+    bool dxt1 = format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    bool dxt3 = format == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+    bool dxt5 = format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    if ( !dxt1 && !dxt3 && !dxt5 )
+        return 0L;
+
+    unsigned blockSize = dxt1 ? 8 : 16;
+    unsigned blocksX = (image->s() + 3) / 4;
+    unsigned blocksY = (image->t() + 3) / 4;
+    if ( image->getImageSizeInBytes() < blocksX * blocksY * blockSize )
+        return 0L;
+
+    osg::Image* result = new osg::Image();
+    result->allocateImage( image->s(), image->t(), 1, GL_RGBA, GL_UNSIGNED_BYTE );
+    result->setInternalTextureFormat( GL_RGBA8 );
+
+    const unsigned char* block = image->data();
+    unsigned char pixels[16*4];
+
+    for( unsigned by = 0; by < blocksY; ++by )
+    {
+        for( unsigned bx = 0; bx < blocksX; ++bx, block += blockSize )
+        {
+            decodeColorBlock( dxt1 ? block : block+8, dxt1, format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, pixels );
+
+            if ( dxt3 )
+            {
+                // 4 bits of explicit alpha per pixel.
+                for( unsigned i = 0; i < 16; ++i )
+                {
+                    unsigned a = (block[i/2] >> ((i & 1) * 4)) & 0x0f;
+                    pixels[4*i+3] = (unsigned char)(a * 17);
+                }
+            }
+            else if ( dxt5 )
+            {
+                // two alpha endpoints and 3-bit indices into an interpolated ramp.
+                unsigned a0 = block[0], a1 = block[1];
+                unsigned char ramp[8];
+                ramp[0] = (unsigned char)a0;
+                ramp[1] = (unsigned char)a1;
+                if ( a0 > a1 )
+                {
+                    for( unsigned k = 1; k < 7; ++k )
+                        ramp[k+1] = (unsigned char)(((7-k)*a0 + k*a1) / 7);
+                }
+                else
+                {
+                    for( unsigned k = 1; k < 5; ++k )
+                        ramp[k+1] = (unsigned char)(((5-k)*a0 + k*a1) / 5);
+                    ramp[6] = 0;
+                    ramp[7] = 255;
+                }
+
+                unsigned long long bits = 0;
+                for( unsigned k = 0; k < 6; ++k )
+                    bits |= (unsigned long long)block[2+k] << (8*k);
+                for( unsigned i = 0; i < 16; ++i, bits >>= 3 )
+                    pixels[4*i+3] = ramp[bits & 7];
+            }
+
+            // copy the 4x4 block into place, clipping at the image edges.
+            for( unsigned y = 0; y < 4 && by*4+y < (unsigned)image->t(); ++y )
+            {
+                for( unsigned x = 0; x < 4 && bx*4+x < (unsigned)image->s(); ++x )
+                {
+                    memcpy( result->data(bx*4+x, by*4+y), pixels + 4*(4*y+x), 4 );
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
 //------------------------------------------------------------------------
 
 namespace
@@ -870,6 +1014,160 @@ namespace
         }
     };
 
+    //--------------------------------------------------------------------
+    // Span readers and writers. Each one produces bit-for-bit the same values as
+    // calling the corresponding per-pixel ColorReader/ColorWriter in a loop.
+
+    // fallback: one call through the per-pixel function pointer for each pixel.
+    void readSpanGeneric(const ImageUtils::PixelReader* ia, osg::Vec4f* out, int s, int t, int r, int m, unsigned count)
+    {
+        for( unsigned i=0; i<count; ++i )
+            out[i] = (*ia->_reader)(ia, s+i, t, r, m);
+    }
+
+    void writeSpanGeneric(const ImageUtils::PixelWriter* iw, const osg::Vec4f* in, int s, int t, int r, int m, unsigned count)
+    {
+        for( unsigned i=0; i<count; ++i )
+            (*iw->_writer)(iw, in[i], s+i, t, r, m);
+    }
+
+    void readSpanRGBA8(const ImageUtils::PixelReader* ia, osg::Vec4f* out, int s, int t, int r, int m, unsigned count)
+    {
+        const GLubyte* ptr = (const GLubyte*)ia->data(s, t, r, m);
+        const float scale = GLTypeTraits<GLubyte>::scale();
+        unsigned i = 0;
+
+#ifdef OE_IMAGEUTILS_SSE2
+        // four pixels (16 bytes) per iteration: widen bytes to 32-bit ints, convert, scale.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 vscale = _mm_set1_ps( scale );
+        for( ; i+4 <= count; i += 4, ptr += 16 )
+        {
+            __m128i bytes = _mm_loadu_si128( (const __m128i*)ptr );
+            __m128i lo = _mm_unpacklo_epi8( bytes, zero );
+            __m128i hi = _mm_unpackhi_epi8( bytes, zero );
+            _mm_storeu_ps( out[i+0].ptr(), _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), vscale) );
+            _mm_storeu_ps( out[i+1].ptr(), _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), vscale) );
+            _mm_storeu_ps( out[i+2].ptr(), _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), vscale) );
+            _mm_storeu_ps( out[i+3].ptr(), _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), vscale) );
+        }
+#endif
+
+        for( ; i<count; ++i, ptr += 4 )
+        {
+            out[i].set( float(ptr[0]) * scale, float(ptr[1]) * scale, float(ptr[2]) * scale, float(ptr[3]) * scale );
+        }
+    }
+
+    void readSpanRGB8(const ImageUtils::PixelReader* ia, osg::Vec4f* out, int s, int t, int r, int m, unsigned count)
+    {
+        const GLubyte* ptr = (const GLubyte*)ia->data(s, t, r, m);
+        const float scale = GLTypeTraits<GLubyte>::scale();
+        for( unsigned i=0; i<count; ++i, ptr += 3 )
+        {
+            out[i].set( float(ptr[0]) * scale, float(ptr[1]) * scale, float(ptr[2]) * scale, 1.0f );
+        }
+    }
+
+    void readSpanRGBA32F(const ImageUtils::PixelReader* ia, osg::Vec4f* out, int s, int t, int r, int m, unsigned count)
+    {
+        // the scale for floats is 1.0, so this is a straight copy.
+        ::memcpy( out, ia->data(s, t, r, m), count * 4 * sizeof(GLfloat) );
+    }
+
+    void readSpanRGB32F(const ImageUtils::PixelReader* ia, osg::Vec4f* out, int s, int t, int r, int m, unsigned count)
+    {
+        const GLfloat* ptr = (const GLfloat*)ia->data(s, t, r, m);
+        for( unsigned i=0; i<count; ++i, ptr += 3 )
+        {
+            out[i].set( ptr[0], ptr[1], ptr[2], 1.0f );
+        }
+    }
+
+    void readSpanLuminance32F(const ImageUtils::PixelReader* ia, osg::Vec4f* out, int s, int t, int r, int m, unsigned count)
+    {
+        const GLfloat* ptr = (const GLfloat*)ia->data(s, t, r, m);
+        for( unsigned i=0; i<count; ++i )
+        {
+            out[i].set( ptr[i], ptr[i], ptr[i], 1.0f );
+        }
+    }
+
+    void writeSpanRGBA8(const ImageUtils::PixelWriter* iw, const osg::Vec4f* in, int s, int t, int r, int m, unsigned count)
+    {
+        GLubyte* ptr = (GLubyte*)iw->data(s, t, r, m);
+        const float scale = GLTypeTraits<GLubyte>::scale();
+        unsigned i = 0;
+
+#ifdef OE_IMAGEUTILS_SSE2
+        // four pixels per iteration. The scalar writer divides by the scale and truncates
+        // to int, keeping the low byte; masking before packing reproduces that exactly
+        // (including for out-of-range values) since the packs can then never saturate.
+        const __m128 vscale = _mm_set1_ps( scale );
+        const __m128i mask = _mm_set1_epi32( 0xff );
+        for( ; i+4 <= count; i += 4, ptr += 16 )
+        {
+            __m128i p0 = _mm_and_si128( _mm_cvttps_epi32(_mm_div_ps(_mm_loadu_ps(in[i+0].ptr()), vscale)), mask );
+            __m128i p1 = _mm_and_si128( _mm_cvttps_epi32(_mm_div_ps(_mm_loadu_ps(in[i+1].ptr()), vscale)), mask );
+            __m128i p2 = _mm_and_si128( _mm_cvttps_epi32(_mm_div_ps(_mm_loadu_ps(in[i+2].ptr()), vscale)), mask );
+            __m128i p3 = _mm_and_si128( _mm_cvttps_epi32(_mm_div_ps(_mm_loadu_ps(in[i+3].ptr()), vscale)), mask );
+            __m128i bytes = _mm_packus_epi16( _mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3) );
+            _mm_storeu_si128( (__m128i*)ptr, bytes );
+        }
+#endif
+
+        for( ; i<count; ++i, ptr += 4 )
+        {
+            ptr[0] = (GLubyte)( in[i].r() / scale );
+            ptr[1] = (GLubyte)( in[i].g() / scale );
+            ptr[2] = (GLubyte)( in[i].b() / scale );
+            ptr[3] = (GLubyte)( in[i].a() / scale );
+        }
+    }
+
+    void writeSpanRGB8(const ImageUtils::PixelWriter* iw, const osg::Vec4f* in, int s, int t, int r, int m, unsigned count)
+    {
+        GLubyte* ptr = (GLubyte*)iw->data(s, t, r, m);
+        const float scale = GLTypeTraits<GLubyte>::scale();
+        for( unsigned i=0; i<count; ++i, ptr += 3 )
+        {
+            ptr[0] = (GLubyte)( in[i].r() / scale );
+            ptr[1] = (GLubyte)( in[i].g() / scale );
+            ptr[2] = (GLubyte)( in[i].b() / scale );
+        }
+    }
+
+    inline ImageUtils::PixelReader::SpanReaderFunc
+    getSpanReader( GLenum pixelFormat, GLenum dataType )
+    {
+        if ( dataType == GL_UNSIGNED_BYTE )
+        {
+            if ( pixelFormat == GL_RGBA ) return &readSpanRGBA8;
+            if ( pixelFormat == GL_RGB )  return &readSpanRGB8;
+        }
+        else if ( dataType == GL_FLOAT )
+        {
+            if ( pixelFormat == GL_RGBA )      return &readSpanRGBA32F;
+            if ( pixelFormat == GL_RGB )       return &readSpanRGB32F;
+            if ( pixelFormat == GL_LUMINANCE ) return &readSpanLuminance32F;
+        }
+        return &readSpanGeneric;
+    }
+
+    // Note: there are no float span writers; the per-pixel float writers narrow each
+    // component to GLubyte, and the span versions must match them.
+    inline ImageUtils::PixelWriter::SpanWriterFunc
+    getSpanWriter( GLenum pixelFormat, GLenum dataType )
+    {
+        if ( dataType == GL_UNSIGNED_BYTE )
+        {
+            if ( pixelFormat == GL_RGBA ) return &writeSpanRGBA8;
+            if ( pixelFormat == GL_RGB )  return &writeSpanRGB8;
+        }
+        return &writeSpanGeneric;
+    }
+
+
     template<int GLFormat>
     inline ImageUtils::PixelReader::ReaderFunc
     chooseReader(GLenum dataType)
@@ -951,6 +1249,7 @@ _image(image)
         OE_WARN << "[PixelReader] No reader found for pixel format " << std::hex << _image->getPixelFormat() << std::endl; 
         _reader = &ColorReader<0,GLbyte>::read;
     }
+    _spanReader = getSpanReader( _image->getPixelFormat(), dataType );
 }
 
 bool
@@ -1039,6 +1338,7 @@ _image(image)
         OE_WARN << "[PixelWriter] No writer found for pixel format " << std::hex << _image->getPixelFormat() << std::endl; 
         _writer = &ColorWriter<0, GLbyte>::write;
     }
+    _spanWriter = getSpanWriter( _image->getPixelFormat(), dataType );
 }
 
 bool
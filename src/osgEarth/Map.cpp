@@ -17,10 +17,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/Map>
+#include <osgEarth/HeightFieldUtils>
 #include <osgEarth/Registry>
 #include <osgEarth/TileSource>
 #include <OpenThreads/ScopedLock>
 #include <iterator>
+#include <algorithm>
 
 using namespace osgEarth;
 using namespace OpenThreads;
@@ -884,6 +886,100 @@ Map::calculateProfile()
 
 namespace
 {
+    /**
+     * Resamples a heightfield into a width x height grid of posts aligned with
+     * the extent "ex", writing NO_DATA_VALUE wherever the source has no coverage.
+     * Sources that share the grid's SRS (and need no vertical datum shift) are
+     * sampled directly by pixel; anything else goes through the general
+     * GeoHeightField::getElevation path.
+     */
+    void
+    s_resampleToGrid(const GeoHeightField& source,
+                     const GeoExtent& ex,
+                     unsigned width, unsigned height,
+                     ElevationInterpolation interpolation,
+                     const VerticalSpatialReference* vsrs,
+                     std::vector<double>& scratch,
+                     float* out)
+    {
+        const osg::HeightField* hf = source.getHeightField();
+        const GeoExtent& srcEx = source.getExtent();
+
+        double dx = ex.width()  / (double)(width-1);
+        double dy = ex.height() / (double)(height-1);
+
+        bool direct =
+            srcEx.getSRS()->isEquivalentTo( ex.getSRS() ) &&
+            !VerticalSpatialReference::canTransform( source.getVerticalSRS(), vsrs );
+
+        if ( !direct )
+        {
+            for (unsigned r = 0; r < height; ++r)
+            {
+                double y = ex.yMin() + dy * (double)r;
+                float* row = out + r*width;
+                for (unsigned c = 0; c < width; ++c)
+                {
+                    float h;
+                    if ( !source.getElevation(ex.getSRS(), ex.xMin() + dx * (double)c, y, interpolation, vsrs, h) || h == NO_DATA_VALUE )
+                        h = NO_DATA_VALUE;
+                    row[c] = h;
+                }
+            }
+            return;
+        }
+
+        unsigned srcCols = hf->getNumColumns();
+        unsigned srcRows = hf->getNumRows();
+
+        // Identical grids: no resampling necessary.
+        if ( srcCols == width && srcRows == height && srcEx == ex )
+        {
+            const float* heights = &hf->getHeightList().front();
+            std::copy( heights, heights + width*height, out );
+            return;
+        }
+
+        double srcDX = srcEx.width()  / (double)(srcCols-1);
+        double srcDY = srcEx.height() / (double)(srcRows-1);
+
+        // The source pixel column for each output column, computed once per tile.
+        // A negative value marks a column outside the source extent.
+        scratch.resize( width );
+        for (unsigned c = 0; c < width; ++c)
+        {
+            double x = ex.xMin() + dx * (double)c;
+            if ( osg::equivalent(x, srcEx.xMin()) ) x = srcEx.xMin();
+            if ( osg::equivalent(x, srcEx.xMax()) ) x = srcEx.xMax();
+            scratch[c] = x >= srcEx.xMin() && x <= srcEx.xMax() ?
+                osg::clampBetween( (x - srcEx.xMin()) / srcDX, 0.0, (double)(srcCols-1) ) :
+                -1.0;
+        }
+
+        for (unsigned r = 0; r < height; ++r)
+        {
+            float* row = out + r*width;
+
+            double y = ex.yMin() + dy * (double)r;
+            if ( osg::equivalent(y, srcEx.yMin()) ) y = srcEx.yMin();
+            if ( osg::equivalent(y, srcEx.yMax()) ) y = srcEx.yMax();
+
+            if ( y < srcEx.yMin() || y > srcEx.yMax() )
+            {
+                std::fill( row, row + width, NO_DATA_VALUE );
+                continue;
+            }
+
+            double py = osg::clampBetween( (y - srcEx.yMin()) / srcDY, 0.0, (double)(srcRows-1) );
+
+            for (unsigned c = 0; c < width; ++c)
+            {
+                row[c] = scratch[c] < 0.0 ? NO_DATA_VALUE :
+                    HeightFieldUtils::getHeightAtPixel( hf, scratch[c], py, interpolation );
+            }
+        }
+    }
+
     bool
     s_getHeightField(const TileKey& key,
                      const ElevationLayerVector& elevLayers,
@@ -1007,74 +1103,72 @@ namespace
 		    out_result = new osg::HeightField();
 		    out_result->allocate( width, height );
 
-		    //Go ahead and set up the heightfield so we don't have to worry about it later
-            double minx, miny, maxx, maxy;
-            key.getExtent().getBounds(minx, miny, maxx, maxy);
-            double dx = (maxx - minx)/(double)(out_result->getNumColumns()-1);
-            double dy = (maxy - miny)/(double)(out_result->getNumRows()-1);
-
             const VerticalSpatialReference* vsrs = mapProfile->getVerticalSRS();
-            
-		    //Create the new heightfield by sampling all of them.
-            for (unsigned int c = 0; c < width; ++c)
-            {
-                double geoX = minx + (dx * (double)c);
-                for (unsigned r = 0; r < height; ++r)
-                {
-                    double geoY = miny + (dy * (double)r);
 
-                    //Collect elevations from all of the layers
-                    std::vector<float> elevations;
-                    for (GeoHeightFieldVector::iterator itr = heightFields.begin(); itr != heightFields.end(); ++itr)
-                    {
-                        const GeoHeightField& geoHF = *itr;
+            // Resample each source once into a tile-aligned grid, then fold the
+            // grids together with the sample policy. All the scratch space is
+            // allocated up front so there is no per-post allocation.
+            unsigned numPosts = width * height;
+            std::vector<float> grid( numPosts );
+            std::vector<double> scratch;
+            std::vector<unsigned> counts;
 
-                        float elevation = 0.0f;
-                        if ( geoHF.getElevation(key.getExtent().getSRS(), geoX, geoY, interpolation, vsrs, elevation) )
-                        {
-                            if (elevation != NO_DATA_VALUE)
-                            {
-                                elevations.push_back(elevation);
-                            }
-                        }
-                    }
+            float* result = &out_result->getHeightList().front();
+            std::fill( result, result + numPosts, NO_DATA_VALUE );
 
-                    float elevation = NO_DATA_VALUE;
+            if ( samplePolicy == SAMPLE_AVERAGE )
+                counts.assign( numPosts, 0u );
+
+            for (GeoHeightFieldVector::const_iterator itr = heightFields.begin(); itr != heightFields.end(); ++itr)
+            {
+                float* src = &grid.front();
+                s_resampleToGrid( *itr, key.getExtent(), width, height, interpolation, vsrs, scratch, src );
 
-                    //The list of elevations only contains valid values
-                    if (elevations.size() > 0)
+                if (samplePolicy == SAMPLE_FIRST_VALID)
+                {
+                    for (unsigned i = 0; i < numPosts; ++i)
                     {
-                        if (samplePolicy == SAMPLE_FIRST_VALID)
-                        {
-                            elevation = elevations[0];
-                        }
-                        else if (samplePolicy == SAMPLE_HIGHEST)
-                        {
-                            elevation = -FLT_MAX;
-                            for (unsigned int i = 0; i < elevations.size(); ++i)
-                            {
-                                if (elevation < elevations[i]) elevation = elevations[i];
-                            }
-                        }
-                        else if (samplePolicy == SAMPLE_LOWEST)
-                        {
-                            elevation = FLT_MAX;
-                            for (unsigned i = 0; i < elevations.size(); ++i)
-                            {
-                                if (elevation > elevations[i]) elevation = elevations[i];
-                            }
-                        }
-                        else if (samplePolicy == SAMPLE_AVERAGE)
+                        if ( result[i] == NO_DATA_VALUE )
+                            result[i] = src[i];
+                    }
+                }
+                else if (samplePolicy == SAMPLE_HIGHEST)
+                {
+                    for (unsigned i = 0; i < numPosts; ++i)
+                    {
+                        if ( src[i] != NO_DATA_VALUE && (result[i] == NO_DATA_VALUE || src[i] > result[i]) )
+                            result[i] = src[i];
+                    }
+                }
+                else if (samplePolicy == SAMPLE_LOWEST)
+                {
+                    for (unsigned i = 0; i < numPosts; ++i)
+                    {
+                        if ( src[i] != NO_DATA_VALUE && (result[i] == NO_DATA_VALUE || src[i] < result[i]) )
+                            result[i] = src[i];
+                    }
+                }
+                else if (samplePolicy == SAMPLE_AVERAGE)
+                {
+                    unsigned* count = &counts.front();
+                    for (unsigned i = 0; i < numPosts; ++i)
+                    {
+                        if ( src[i] != NO_DATA_VALUE )
                         {
-                            elevation = 0.0;
-                            for (unsigned i = 0; i < elevations.size(); ++i)
-                            {
-                                elevation += elevations[i];
-                            }
-                            elevation /= (float)elevations.size();
+                            result[i] = count[i] == 0 ? src[i] : result[i] + src[i];
+                            ++count[i];
                         }
                     }
-                    out_result->setHeight(c, r, elevation);
+                }
+            }
+
+            if (samplePolicy == SAMPLE_AVERAGE)
+            {
+                const unsigned* count = &counts.front();
+                for (unsigned i = 0; i < numPosts; ++i)
+                {
+                    if ( count[i] > 1 )
+                        result[i] /= (float)count[i];
                 }
             }
 	    }
@@ -23,6 +23,8 @@
 #include <osgEarth/Cube>
 #include <osgEarth/SpatialReference>
 #include <osgDB/FileNameUtils>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
 #include <algorithm>
 #include <sstream>
 
@@ -252,13 +254,26 @@ Profile::create( const ProfileOptions& options )
 /****************************************************************************/
 
 
+namespace
+{
+    OpenThreads::Mutex s_uidMutex;
+    unsigned int       s_uidGen = 0;
+
+    unsigned int nextUID()
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( s_uidMutex );
+        return ++s_uidGen;
+    }
+}
+
 Profile::Profile(const SpatialReference* srs,
                  double xmin, double ymin, double xmax, double ymax,
                  const VerticalSpatialReference* vsrs,
                  unsigned int numTilesWideAtLod0,
                  unsigned int numTilesHighAtLod0) :
 osg::Referenced( true ),
-_vsrs( vsrs )
+_vsrs( vsrs ),
+_uid( nextUID() )
 {
     _extent = GeoExtent( srs, xmin, ymin, xmax, ymax );
 
@@ -281,7 +296,8 @@ Profile::Profile(const SpatialReference* srs,
                  unsigned int numTilesWideAtLod0,
                  unsigned int numTilesHighAtLod0 ) :
 osg::Referenced( true ),
-_vsrs( vsrs )
+_vsrs( vsrs ),
+_uid( nextUID() )
 {
     _extent = GeoExtent( srs, xmin, ymin, xmax, ymax );
 
@@ -541,25 +557,13 @@ Profile::addIntersectingTiles(const GeoExtent& key_ext, std::vector<TileKey>& ou
     //OE_DEBUG << std::fixed << "  Source Tile: " << key.getLevelOfDetail() << " (" << keyWidth << ", " << keyHeight << ")" << std::endl;
     OE_DEBUG << std::fixed << "  Dest Size: " << destLOD << " (" << destTileWidth << ", " << destTileHeight << ")" << std::endl;
 
-    int tileMinX = (int)((key_ext.xMin() - _extent.xMin()) / destTileWidth);
-    int tileMaxX = (int)((key_ext.xMax() - _extent.xMin()) / destTileWidth);
-
-    int tileMinY = (int)((_extent.yMax() - key_ext.yMax()) / destTileHeight); 
-    int tileMaxY = (int)((_extent.yMax() - key_ext.yMin()) / destTileHeight); 
-
-    unsigned int numWide, numHigh;
-    getNumTiles(destLOD, numWide, numHigh);
-
-    tileMinX = osg::clampBetween(tileMinX, 0, (int)numWide-1);
-    tileMaxX = osg::clampBetween(tileMaxX, 0, (int)numWide-1);
-    tileMinY = osg::clampBetween(tileMinY, 0, (int)numHigh-1);
-    tileMaxY = osg::clampBetween(tileMaxY, 0, (int)numHigh-1);
+    TileRange r = getTileRange( key_ext, destLOD );
 
-    OE_DEBUG << std::fixed << "  Dest Tiles: " << tileMinX << "," << tileMinY << " => " << tileMaxX << "," << tileMaxY << std::endl;
+    OE_DEBUG << std::fixed << "  Dest Tiles: " << r._xmin << "," << r._ymin << " => " << r._xmax << "," << r._ymax << std::endl;
 
-    for (int i = tileMinX; i <= tileMaxX; ++i)
+    for (unsigned int i = r._xmin; i <= r._xmax; ++i)
     {
-        for (int j = tileMinY; j <= tileMaxY; ++j)
+        for (unsigned int j = r._ymin; j <= r._ymax; ++j)
         {
             //TODO: does not support multi-face destination keys.
             out_intersectingKeys.push_back( TileKey(destLOD, i, j, this) );
@@ -615,3 +619,170 @@ Profile::getIntersectingTiles(const GeoExtent& extent, std::vector<TileKey>& out
         addIntersectingTiles( ext, out_intersectingKeys );
     }
 }
+
+TileRange
+Profile::getTileRange( const GeoExtent& ext, unsigned int lod ) const
+{
+    double w, h;
+    getTileDimensions( lod, w, h );
+
+    unsigned int numWide, numHigh;
+    getNumTiles( lod, numWide, numHigh );
+
+    return TileRange(
+        lod,
+        (unsigned int)osg::clampBetween( (int)floor((ext.xMin() - _extent.xMin()) / w), 0, (int)numWide-1 ),
+        (unsigned int)osg::clampBetween( (int)floor((_extent.yMax() - ext.yMax()) / h), 0, (int)numHigh-1 ),
+        (unsigned int)osg::clampBetween( (int)floor((ext.xMax() - _extent.xMin()) / w), 0, (int)numWide-1 ),
+        (unsigned int)osg::clampBetween( (int)floor((_extent.yMax() - ext.yMin()) / h), 0, (int)numHigh-1 ) );
+}
+
+void
+Profile::getIntersectingTileRanges(const GeoExtent& extent,
+                                   unsigned int minLevel,
+                                   unsigned int maxLevel,
+                                   TileRangeVector& out_ranges) const
+{
+    GeoExtent ext = extent;
+
+    // reproject into the profile's SRS if necessary:
+    if ( ! getSRS()->isEquivalentTo( extent.getSRS() ) )
+    {
+        ext = clampAndTransformExtent( extent );
+        if ( !ext.isValid() )
+            return;
+    }
+
+    std::vector<GeoExtent> parts;
+    if ( ext.crossesDateLine() )
+    {
+        GeoExtent first, second;
+        if ( ext.splitAcrossDateLine( first, second ) )
+        {
+            parts.push_back( first );
+            parts.push_back( second );
+        }
+    }
+    else
+    {
+        parts.push_back( ext );
+    }
+
+    for( unsigned int lod = minLevel; lod <= maxLevel; ++lod )
+    {
+        for( unsigned int i = 0; i < parts.size(); ++i )
+        {
+            const GeoExtent& part = parts[i];
+            if ( part.xMax() < _extent.xMin() || part.xMin() > _extent.xMax() ||
+                 part.yMax() < _extent.yMin() || part.yMin() > _extent.yMax() )
+            {
+                continue;
+            }
+            out_ranges.push_back( getTileRange(part, lod) );
+        }
+    }
+}
+
+void
+Profile::partitionTileRanges(const TileRangeVector& ranges,
+                             unsigned int numPartitions,
+                             std::vector<TileRangeVector>& out_partitions)
+{
+    out_partitions.clear();
+
+    unsigned long long total = 0;
+    for( TileRangeVector::const_iterator i = ranges.begin(); i != ranges.end(); ++i )
+        total += i->getNumTiles();
+
+    if ( total == 0 || numPartitions == 0 )
+        return;
+
+    unsigned long long target = (total + numPartitions - 1) / numPartitions;
+
+    out_partitions.push_back( TileRangeVector() );
+    unsigned long long count = 0; // tiles in the current partition
+
+    for( TileRangeVector::const_iterator i = ranges.begin(); i != ranges.end(); ++i )
+    {
+        unsigned int lod = i->_lod;
+        unsigned long long rowWidth = i->_xmax - i->_xmin + 1;
+        unsigned int y = i->_ymin;
+        unsigned int x = i->_xmin; // first unassigned column in row y
+
+        while( y <= i->_ymax )
+        {
+            if ( count == target )
+            {
+                out_partitions.push_back( TileRangeVector() );
+                count = 0;
+            }
+            TileRangeVector& part = out_partitions.back();
+            unsigned long long room = target - count;
+
+            if ( x > i->_xmin )
+            {
+                // finish off a partially-assigned row.
+                unsigned int n = (unsigned int)osg::minimum( room, (unsigned long long)(i->_xmax - x + 1) );
+                part.push_back( TileRange(lod, x, y, x+n-1, y) );
+                count += n;
+                x += n;
+                if ( x > i->_xmax ) { x = i->_xmin; ++y; }
+            }
+            else if ( room >= rowWidth )
+            {
+                // take as many whole rows as will fit.
+                unsigned int rows = (unsigned int)osg::minimum( room / rowWidth, (unsigned long long)(i->_ymax - y + 1) );
+                part.push_back( TileRange(lod, i->_xmin, y, i->_xmax, y+rows-1) );
+                count += rows * rowWidth;
+                y += rows;
+            }
+            else
+            {
+                // start a row that will spill into the next partition.
+                unsigned int n = (unsigned int)room; // less than rowWidth
+                part.push_back( TileRange(lod, x, y, x+n-1, y) );
+                count += n;
+                x += n;
+            }
+        }
+    }
+}
+
+bool
+TileRangeIterator::next( unsigned int& out_lod, unsigned int& out_x, unsigned int& out_y )
+{
+    if ( !_started )
+    {
+        _started = true;
+        _range = 0;
+        if ( _range < _ranges.size() )
+        {
+            _x = _ranges[0]._xmin;
+            _y = _ranges[0]._ymin;
+        }
+    }
+    else if ( _range < _ranges.size() )
+    {
+        const TileRange& r = _ranges[_range];
+        if ( ++_x > r._xmax )
+        {
+            _x = r._xmin;
+            if ( ++_y > r._ymax )
+            {
+                if ( ++_range < _ranges.size() )
+                {
+                    _x = _ranges[_range]._xmin;
+                    _y = _ranges[_range]._ymin;
+                }
+            }
+        }
+    }
+
+    if ( _range >= _ranges.size() )
+        return false;
+
+    out_lod = _ranges[_range]._lod;
+    out_x   = _x;
+    out_y   = _y;
+    return true;
+}
@@ -255,6 +255,7 @@ Registry::createUID()
 }
 
 //Simple class used to add a file extension alias for the earth_tile to the earth plugin
+//(and for the DXT flavor of raw cache images to the raw image plugin)
 class RegisterEarthTileExtension
 {
 public:
@@ -262,6 +263,7 @@ public:
     {
         osg::Referenced::setThreadSafeReferenceCounting( true );
         osgDB::Registry::instance()->addFileExtensionAlias("earth_tile", "earth");
+        osgDB::Registry::instance()->addFileExtensionAlias("osgearth_dxt", "osgearth_raw");
     }
 };
 static RegisterEarthTileExtension s_registerEarthTileExtension;
@@ -314,12 +314,10 @@ SpatialReference::~SpatialReference()
 {
     if ( _handle )
     {
-        GDAL_SCOPED_LOCK;
+        // (entries destroy their own handles)
+        _transformHandleCache.clear();
 
-        for (TransformHandleCache::iterator itr = _transformHandleCache.begin(); itr != _transformHandleCache.end(); ++itr)
-        {
-            OCTDestroyCoordinateTransformation(itr->second);
-        }
+        GDAL_SCOPED_LOCK;
 
         if ( _owns_handle )
         {
@@ -604,17 +602,6 @@ SpatialReference::transform(double x, double y,
     if ( !_initialized )
         const_cast<SpatialReference*>(this)->init();
 
-    //Check for equivalence and return if the coordinate systems are the same.
-    if (isEquivalentTo(out_srs))
-    {
-        out_x = x;
-        out_y = y;
-        return true;
-    }
-
-        if ( !_initialized )
-        const_cast<SpatialReference*>(this)->init();
-
     //Check for equivalence and return if the coordinate systems are the same.
     if (isEquivalentTo(out_srs))
     {
@@ -665,6 +652,81 @@ geographicToMercator( double* x, double* y, int numPoints )
     return true;
 }
 
+// Upper bound on cached transformation entries per source SRS. Once it's reached,
+// the least recently used idle entries go first.
+#define MAX_TRANSFORM_CACHE_ENTRIES 64
+
+SpatialReference::TransformCacheEntry::~TransformCacheEntry()
+{
+    if ( _handle )
+    {
+        GDAL_SCOPED_LOCK;
+        OCTDestroyCoordinateTransformation( _handle );
+    }
+}
+
+bool
+SpatialReference::getTransformCacheEntry(const SpatialReference*            out_srs,
+                                         osg::ref_ptr<TransformCacheEntry>& out_entry ) const
+{
+    // Entries are keyed by thread, so only the calling thread ever uses its own entry;
+    // the lock protects the structure of the map and the eviction of idle entries.
+    // Unknown threads all map to the NULL thread and share that entry.
+    const OpenThreads::Thread* thread = OpenThreads::Thread::CurrentThread();
+    TransformCacheKey key( thread, out_srs );
+    {
+        Threading::ScopedReadLock lock( _transformHandleCacheMutex );
+        TransformHandleCache::iterator i = _transformHandleCache.find( key );
+        if ( i != _transformHandleCache.end() && i->second->_srs.get() == out_srs )
+        {
+            out_entry = i->second.get();
+            out_entry->_lastUsed.exchange( ++_transformCacheClock );
+            return true;
+        }
+    }
+
+    // Create the handle before taking the write lock, so we never wait on the GDAL
+    // lock while holding it. (A NULL handle is cached too; it means "not possible".)
+    void* handle = 0L;
+    {
+        GDAL_SCOPED_LOCK;
+        handle = OCTNewCoordinateTransformation( _handle, out_srs->_handle );
+    }
+
+    out_entry = new TransformCacheEntry( out_srs, handle, thread == 0L );
+    out_entry->_lastUsed.exchange( ++_transformCacheClock );
+
+    // evicted entries are released after the lock, since that takes the GDAL lock.
+    std::vector< osg::ref_ptr<TransformCacheEntry> > evicted;
+    {
+        Threading::ScopedWriteLock lock( _transformHandleCacheMutex );
+
+        // replaces any entry whose target was deleted and its address reused.
+        osg::ref_ptr<TransformCacheEntry>& slot = _transformHandleCache[key];
+        evicted.push_back( slot.get() );
+        slot = out_entry.get();
+
+        // An entry is idle if only the cache holds it; no one can take a new reference
+        // while we hold the write lock.
+        while ( _transformHandleCache.size() > MAX_TRANSFORM_CACHE_ENTRIES )
+        {
+            TransformHandleCache::iterator lru = _transformHandleCache.end();
+            for( TransformHandleCache::iterator i = _transformHandleCache.begin(); i != _transformHandleCache.end(); ++i )
+            {
+                if ( i->second->referenceCount() == 1 &&
+                     (lru == _transformHandleCache.end() || (unsigned)i->second->_lastUsed < (unsigned)lru->second->_lastUsed) )
+                    lru = i;
+            }
+            if ( lru == _transformHandleCache.end() )
+                break;
+            evicted.push_back( lru->second.get() );
+            _transformHandleCache.erase( lru );
+        }
+    }
+
+    return true;
+}
+
 bool
 SpatialReference::transformPoints(const SpatialReference* out_srs,
                                   double* x, double* y,
@@ -701,35 +763,30 @@ SpatialReference::transformPoints(const SpatialReference* out_srs,
 #endif
 
     {    
-        GDAL_SCOPED_LOCK;
-
-        void* xform_handle = NULL;
-        TransformHandleCache::const_iterator itr = _transformHandleCache.find(out_srs->getWKT());
-        if (itr != _transformHandleCache.end())
+        // OCTTransform accepts a NULL z array, so there's no need for a z buffer.
+        osg::ref_ptr<TransformCacheEntry> entry;
+        if ( getTransformCacheEntry( out_srs, entry ) )
         {
-            //OE_DEBUG << "SpatialRefernece: using cached transform handle" << std::endl;
-            xform_handle = itr->second;
-        }
-        else
-        {
-            xform_handle = OCTNewCoordinateTransformation( _handle, out_srs->_handle);
-            const_cast<SpatialReference*>(this)->_transformHandleCache[out_srs->getWKT()] = xform_handle;
-        }
+            if ( !entry->_handle )
+            {
+                OE_WARN << LC
+                    << "SRS xform not possible" << std::endl
+                    << "    From => " << getName() << std::endl
+                    << "    To   => " << out_srs->getName() << std::endl;
+                return false;
+            }
 
-        if ( !xform_handle )
-        {
-            OE_WARN << LC
-                << "SRS xform not possible" << std::endl
-                << "    From => " << getName() << std::endl
-                << "    To   => " << out_srs->getName() << std::endl;
-            return false;
+            if ( entry->_shared )
+            {
+                GDAL_SCOPED_LOCK;
+                success = OCTTransform( entry->_handle, numPoints, x, y, 0L ) > 0;
+            }
+            else
+            {
+                // the handle belongs to this thread, so it needs no lock.
+                success = OCTTransform( entry->_handle, numPoints, x, y, 0L ) > 0;
+            }
         }
-
-        double* temp_z = new double[numPoints];
-        success = OCTTransform( xform_handle, numPoints, x, y, temp_z ) > 0;
-        delete[] temp_z;
-
-        // END GDAL_SCOPE_LOCK
     }
 
     if ( success || ignore_errors )
@@ -761,8 +818,25 @@ SpatialReference::transformPoints(const SpatialReference* out_srs,
     if (isEquivalentTo(out_srs)) return true;
 
     int numPoints = points->size();
-    double* x = new double[numPoints];
-    double* y = new double[numPoints];
+    if ( numPoints == 0 )
+        return true;
+
+    // De-interleave into the calling thread's scratch buffer so we don't allocate on
+    // every call. A subclass's pre/postTransform could re-enter with the same target,
+    // and threads unknown to OpenThreads share their cached state; both fall back on a
+    // temporary buffer.
+    osg::ref_ptr<TransformCacheEntry> entry;
+    std::vector<double> temp;
+    bool useScratch = getTransformCacheEntry( out_srs, entry ) && !entry->_shared && !entry->_scratchInUse;
+    std::vector<double>& buf = useScratch ? entry->_scratch : temp;
+    if ( useScratch )
+        entry->_scratchInUse = true;
+
+    if ( (int)buf.size() < 2*numPoints )
+        buf.resize( 2*numPoints );
+
+    double* x = &buf[0];
+    double* y = &buf[numPoints];
 
     for( int i=0; i<numPoints; i++ )
     {
@@ -781,8 +855,8 @@ SpatialReference::transformPoints(const SpatialReference* out_srs,
         }
     }
 
-    delete[] x;
-    delete[] y;
+    if ( useScratch )
+        entry->_scratchInUse = false;
 
     return success;
 }
@@ -816,13 +890,17 @@ SpatialReference::transformToECEF(osg::Vec3dArray*    points,
     const SpatialReference* geoSRS = getGeographicSRS();
     const osg::EllipsoidModel* ellipsoid = geoSRS->getEllipsoid();
 
+    // convert to lat/long in one batch, rather than point by point:
+    if ( !isGeographic() )
+    {
+        if ( !transformPoints( geoSRS, points, 0L, ignoreErrors ) && !ignoreErrors )
+            return false;
+    }
+
     for( unsigned i=0; i<points->size(); ++i )
     {
         osg::Vec3d& p = (*points)[i];
 
-        if ( !isGeographic() )
-            transform( p.x(), p.y(), geoSRS, p.x(), p.y() );
-
         ellipsoid->convertLatLongHeightToXYZ(
             osg::DegreesToRadians( p.y() ), osg::DegreesToRadians( p.x() ), p.z(),
             p.x(), p.y(), p.z() );
@@ -865,12 +943,14 @@ SpatialReference::transformFromECEF(osg::Vec3dArray* points,
 {
     bool ok = true;
 
+    const osg::EllipsoidModel* ellipsoid = getGeographicSRS()->getEllipsoid();
+
     // first convert all the points to lat/long (in place):
     for( unsigned i=0; i<points->size(); ++i )
     {
         osg::Vec3d& p = (*points)[i];
         osg::Vec3d geo;
-        getGeographicSRS()->getEllipsoid()->convertXYZToLatLongHeight(
+        ellipsoid->convertXYZToLatLongHeight(
             p.x(), p.y(), p.z(),
             geo.y(), geo.x(), geo.z() );
         geo.x() = osg::RadiansToDegrees( geo.x() );
@@ -29,7 +29,10 @@ using namespace OpenThreads;
 TaskRequest::TaskRequest( float priority ) :
 osg::Referenced( true ),
 _priority( priority ),
-_state( STATE_IDLE )
+_state( STATE_IDLE ),
+_queueTime( 0 ),
+_startTime( 0 ),
+_endTime( 0 )
 {
     _progress = new ProgressCallback();
 }
@@ -66,85 +69,353 @@ TaskRequest::wasCanceled() const
 
 TaskRequestQueue::TaskRequestQueue() :
 osg::Referenced( true ),
-_done( false )
+_numLanes( 1 ),
+_nextLane( 0 ),
+_numPending( 0 ),
+_done( false ),
+_totalWaitTime( 0.0 ),
+_totalRunTime( 0.0 ),
+_stamp( 0 )
 {
+    // always have at least one lane so add() has somewhere to go before
+    // any threads start up.
+    _lanes[0] = new Lane();
+}
+
+TaskRequestQueue::~TaskRequestQueue()
+{
+    for( unsigned i=0; i<_numLanes; ++i )
+        delete _lanes[i];
+}
+
+unsigned
+TaskRequestQueue::getNumLanes() const
+{
+    ScopedLock<Mutex> lock( _lanesMutex );
+    return _numLanes;
 }
 
 void
 TaskRequestQueue::clear()
 {
-    ScopedLock<Mutex> lock(_mutex);
-    _requests.clear();
+    TaskRequestVector dead;
+
+    unsigned numLanes = getNumLanes();
+    for( unsigned i=0; i<numLanes; ++i )
+    {
+        ScopedLock<Mutex> lock( _lanes[i]->_mutex );
+        for( TaskRequestPriorityMap::iterator r = _lanes[i]->_requests.begin(); r != _lanes[i]->_requests.end(); ++r )
+            dead.push_back( r->second );
+        _lanes[i]->_requests.clear();
+    }
+
+    retire( dead );
 }
 
 unsigned int
 TaskRequestQueue::getNumRequests() const
 {
-    ScopedLock<Mutex> lock(const_cast<TaskRequestQueue*>(this)->_mutex);
-    return _requests.size();
+    return _numPending;
+}
+
+unsigned
+TaskRequestQueue::acquireLane()
+{
+    ScopedLock<Mutex> lock( _lanesMutex );
+
+    for( unsigned i=0; i<_numLanes; ++i )
+    {
+        if ( _lanes[i]->_numOwners == 0 )
+        {
+            _lanes[i]->_numOwners++;
+            return i;
+        }
+    }
+
+    if ( _numLanes < MAX_LANES )
+    {
+        _lanes[_numLanes] = new Lane();
+        _lanes[_numLanes]->_numOwners++;
+        return _numLanes++;
+    }
+
+    // more threads than lanes; share the least busy one.
+    unsigned best = 0;
+    for( unsigned i=1; i<_numLanes; ++i )
+    {
+        if ( _lanes[i]->_numOwners < _lanes[best]->_numOwners )
+            best = i;
+    }
+    _lanes[best]->_numOwners++;
+    return best;
+}
+
+void
+TaskRequestQueue::releaseLane( unsigned lane )
+{
+    {
+        ScopedLock<Mutex> lock( _lanesMutex );
+        if ( _lanes[lane]->_numOwners > 0 )
+            _lanes[lane]->_numOwners--;
+    }
+
+    // anything left in the lane will be stolen; make sure someone is awake to do it.
+    ScopedLock<Mutex> lock(_mutex);
+    if ( _numPending > 0 )
+        _cond.signal();
 }
 
 void 
 TaskRequestQueue::add( TaskRequest* request )
 {
     request->setState( TaskRequest::STATE_PENDING );
+    request->setQueueTime( osg::Timer::instance()->tick() );
 
     // install a progress callback if one isn't already installed
     if ( !request->getProgressCallback() )
         request->setProgressCallback( new ProgressCallback() );
 
+    // a request spawned by one of our own worker threads goes into that thread's lane;
+    // anything else is dealt round-robin across the lanes.
+    unsigned lane;
+    TaskThread* thread = dynamic_cast<TaskThread*>( OpenThreads::Thread::CurrentThread() );
+    if ( thread && thread->getQueue() == this )
+    {
+        lane = thread->getLane();
+    }
+    else
+    {
+        ScopedLock<Mutex> lock( _lanesMutex );
+        lane = (_nextLane++) % _numLanes;
+    }
+
+    // count the request before it becomes visible in its lane, so that a worker that
+    // pops it right away can't decrement the count ahead of the increment.
     ScopedLock<Mutex> lock(_mutex);
+    {
+        ScopedLock<Mutex> laneLock( _lanes[lane]->_mutex );
+        _lanes[lane]->_requests.insert( std::make_pair(request->getPriority(), osg::ref_ptr<TaskRequest>(request)) );
+    }
+
+    _numPending++;
+    _stats._numAdded++;
+    if ( _numPending > _stats._maxQueueDepth )
+        _stats._maxQueueDepth = _numPending;
+
+    // since there is data in the queue, wake up one waiting task thread.
+    _cond.signal();
+}
+
+TaskRequest*
+TaskRequestQueue::pop( unsigned lane )
+{
+    osg::ref_ptr<TaskRequest> next;
+    {
+        Lane* l = _lanes[lane];
+        ScopedLock<Mutex> lock( l->_mutex );
+        if ( l->_requests.empty() )
+            return 0L;
+
+        // lowest value first; FIFO among equal priorities.
+        TaskRequestPriorityMap::iterator i = l->_requests.begin();
+        next = i->second.get();
+        l->_requests.erase( i );
+    }
+
+    ScopedLock<Mutex> lock(_mutex);
+    _numPending--;
+
+    return next.release();
+}
 
-    // insert by priority.
-    _requests.insert( std::pair<float,TaskRequest*>(request->getPriority(), request) );
+TaskRequest*
+TaskRequestQueue::steal( unsigned lane )
+{
+    unsigned numLanes = getNumLanes();
 
-#if 0
-    // insert by priority.
-    bool inserted = false;
-    for( TaskRequestList::iterator i = _requests.begin(); i != _requests.end(); i++ )
+    // find the lane holding the best pending request.
+    int   bestLane = -1;
+    float bestPriority = 0.0f;
+    for( unsigned k=1; k<numLanes; ++k )
     {
-        if ( request->getPriority() > i->get()->getPriority() )
+        unsigned i = (lane + k) % numLanes;
+        ScopedLock<Mutex> lock( _lanes[i]->_mutex );
+        if ( !_lanes[i]->_requests.empty() )
         {
-            _requests.insert( i, request );
-            inserted = true;
-            //OE_NOTICE << "TaskRequestQueue size=" << _requests.size() << std::endl;
-            break;
+            float p = _lanes[i]->_requests.begin()->first;
+            if ( bestLane < 0 || p < bestPriority )
+            {
+                bestLane = i;
+                bestPriority = p;
+            }
         }
     }
 
-    if ( !inserted )
-        _requests.push_back( request );
-#endif
-
-    // since there is data in the queue, wake up one waiting task thread.
-    _cond.signal();
+    // the victim may have emptied in the meantime, in which case the caller tries again.
+    TaskRequest* request = bestLane >= 0 ? pop( bestLane ) : 0L;
+    if ( request )
+    {
+        ScopedLock<Mutex> lock(_mutex);
+        _stats._numStolen++;
+    }
+    return request;
 }
 
 TaskRequest* 
-TaskRequestQueue::get()
+TaskRequestQueue::get( unsigned lane )
+{
+    for( ;; )
+    {
+        if ( _done )
+            return 0L;
+
+        TaskRequest* request = pop( lane );
+        if ( !request )
+            request = steal( lane );
+        if ( request )
+            return request;
+
+        ScopedLock<Mutex> lock(_mutex);
+        while ( !_done && _numPending == 0 )
+        {
+            // releases the mutex and waits on the condition.
+            _cond.wait( &_mutex );
+        }
+    }
+}
+
+void
+TaskRequestQueue::retire( TaskRequestVector& requests )
 {
+    if ( requests.empty() )
+        return;
+
+    for( TaskRequestVector::iterator i = requests.begin(); i != requests.end(); ++i )
+    {
+        TaskRequest* request = i->get();
+        request->cancel();
+        request->setState( TaskRequest::STATE_COMPLETED );
+        if ( request->getProgressCallback() )
+            request->getProgressCallback()->onCompleted();
+
+        // release anyone waiting on the request.
+        request->abandon();
+    }
+
     ScopedLock<Mutex> lock(_mutex);
+    _numPending -= requests.size();
+    _stats._numCanceled += requests.size();
+}
+
+void
+TaskRequestQueue::reprioritize( const TaskPriorityCallback* callback )
+{
+    TaskRequestVector dead;
 
-    while ( !_done && _requests.empty() )
+    unsigned numLanes = getNumLanes();
+    for( unsigned k=0; k<numLanes; ++k )
     {
-        // releases the mutex and waits on the condition.
-        _cond.wait( &_mutex );
+        Lane* l = _lanes[k];
+        ScopedLock<Mutex> lock( l->_mutex );
+
+        // only the requests whose priority changed get moved.
+        TaskRequestVector moved;
+        for( TaskRequestPriorityMap::iterator i = l->_requests.begin(); i != l->_requests.end(); )
+        {
+            // (the progress callback gets a chance to cancel a request that has gone stale)
+            TaskRequest* request = i->second.get();
+            if ( request->getState() != TaskRequest::STATE_PENDING ||
+                 request->wasCanceled() ||
+                 (request->getProgressCallback() && request->getProgressCallback()->reportProgress(0, 0)) )
+            {
+                dead.push_back( request );
+                l->_requests.erase( i++ );
+                continue;
+            }
+
+            if ( callback )
+                request->setPriority( (*callback)(request) );
+
+            if ( request->getPriority() != i->first )
+            {
+                moved.push_back( request );
+                l->_requests.erase( i++ );
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        for( TaskRequestVector::iterator i = moved.begin(); i != moved.end(); ++i )
+            l->_requests.insert( std::make_pair(i->get()->getPriority(), *i) );
     }
 
-    if ( _done )
+    retire( dead );
+}
+
+unsigned
+TaskRequestQueue::cancel( float threshold )
+{
+    TaskRequestVector dead;
+
+    unsigned numLanes = getNumLanes();
+    for( unsigned k=0; k<numLanes; ++k )
     {
-        return 0L;
+        Lane* l = _lanes[k];
+        ScopedLock<Mutex> lock( l->_mutex );
+
+        TaskRequestPriorityMap::iterator start = l->_requests.upper_bound( threshold );
+        for( TaskRequestPriorityMap::iterator i = start; i != l->_requests.end(); ++i )
+            dead.push_back( i->second );
+        l->_requests.erase( start, l->_requests.end() );
     }
 
-    osg::ref_ptr<TaskRequest> next = _requests.begin()->second.get(); //_requests.front();
-    _requests.erase( _requests.begin() ); //_requests.pop_front();
+    retire( dead );
+    return dead.size();
+}
 
-    // I'm done, someone else take a turn:
-    // (technically this shouldn't be necessary since add() bumps the semaphore once
-    // for each request in the queue)
-    _cond.signal();
+void
+TaskRequestQueue::complete( TaskRequest* request, bool ran )
+{
+    ScopedLock<Mutex> lock(_mutex);
+    if ( ran )
+    {
+        double wait = request->waitTime();
+        _totalWaitTime += wait;
+        _totalRunTime  += request->runTime();
+        if ( wait > _stats._maxWaitTime )
+            _stats._maxWaitTime = wait;
+        _stats._numCompleted++;
+    }
+    else
+    {
+        _stats._numCanceled++;
+    }
+}
 
-    return next.release();
+TaskRequestQueue::Stats
+TaskRequestQueue::getStats() const
+{
+    ScopedLock<Mutex> lock( const_cast<TaskRequestQueue*>(this)->_mutex );
+    Stats stats = _stats;
+    stats._queueDepth = _numPending;
+    if ( stats._numCompleted > 0 )
+    {
+        stats._avgWaitTime = _totalWaitTime / (double)stats._numCompleted;
+        stats._avgRunTime  = _totalRunTime  / (double)stats._numCompleted;
+    }
+    return stats;
+}
+
+void
+TaskRequestQueue::resetStats()
+{
+    ScopedLock<Mutex> lock(_mutex);
+    _stats = Stats();
+    _stats._maxQueueDepth = _numPending;
+    _totalWaitTime = 0.0;
+    _totalRunTime = 0.0;
 }
 
 void
@@ -167,7 +438,8 @@ TaskRequestQueue::setDone()
 
 TaskThread::TaskThread( TaskRequestQueue* queue ) :
 _queue( queue ),
-_done( false )
+_done( false ),
+_lane( 0 )
 {
     //nop
 }
@@ -175,15 +447,18 @@ _done( false )
 void
 TaskThread::run()
 {
+    _lane = _queue->acquireLane();
+
     while( !_done )
     {
-        _request = _queue->get();
-
-        if ( _done )
-            break;
+        // note: a request handed to a thread that was told to quit while it was
+        // waiting still gets run, so it is never lost.
+        _request = _queue->get( _lane );
 
         if (_request.valid())
         { 
+            bool ran = false;
+
             // discard a completed or canceled request:
             if ( _request->getState() != TaskRequest::STATE_PENDING )
             {
@@ -197,6 +472,7 @@ TaskThread::run()
 
                 _request->setState( TaskRequest::STATE_IN_PROGRESS );
                 _request->run();
+                ran = true;
 
                 //OE_INFO << LC << "Task \"" << _request->getName() << "\" runtime = " << _request->runTime() << " s." << std::endl;
             }
@@ -211,10 +487,18 @@ TaskThread::run()
             if ( _request->getProgressCallback() )
                 _request->getProgressCallback()->onCompleted();
 
+            // a request that didn't run still has to release anyone waiting on it.
+            if ( !ran )
+                _request->abandon();
+
+            _queue->complete( _request.get(), ran );
+
             // Release the request
             _request = 0;
         }
     }
+
+    _queue->releaseLane( _lane );
 }
 
 int
@@ -241,7 +525,9 @@ TaskThread::cancel()
 
 TaskService::TaskService( const std::string& name, int numThreads ):
 osg::Referenced( true ),
+_numThreads(0),
 _lastRemoveFinishedThreadsStamp(0),
+_lastReprioritizeStamp(0),
 _name(name)
 {
     _queue = new TaskRequestQueue();
@@ -275,6 +561,9 @@ TaskService::~TaskService()
         (*i)->cancel();
         delete (*i);
     }
+
+    // drop whatever never got to run.
+    _queue->clear();
 }
 
 int
@@ -286,6 +575,14 @@ TaskService::getStamp() const
 void
 TaskService::setStamp( int stamp )
 {
+    // every few frames, let the callback re-rank whatever is still waiting, and drop
+    // the requests that were canceled while they sat in the queue.
+    if ( stamp - _lastReprioritizeStamp >= 10 || stamp < _lastReprioritizeStamp )
+    {
+        _queue->reprioritize( _priorityCallback.get() );
+        _lastReprioritizeStamp = stamp;
+    }
+
     _queue->setStamp( stamp );
     //Remove finished threads every 60 frames
     if (stamp - _lastRemoveFinishedThreadsStamp > 60)
@@ -295,6 +592,35 @@ TaskService::setStamp( int stamp )
     }
 }
 
+void
+TaskService::reprioritize()
+{
+    _queue->reprioritize( _priorityCallback.get() );
+}
+
+unsigned
+TaskService::cancelRequestsAfter( float threshold )
+{
+    unsigned numCanceled = _queue->cancel( threshold );
+    if ( numCanceled > 0 )
+    {
+        OE_DEBUG << LC << "TaskService [" << _name << "] canceled " << numCanceled << " requests" << std::endl;
+    }
+    return numCanceled;
+}
+
+TaskService::Stats
+TaskService::getStats() const
+{
+    return _queue->getStats();
+}
+
+void
+TaskService::resetStats()
+{
+    _queue->resetStats();
+}
+
 int
 TaskService::getNumThreads() const
 {
@@ -477,6 +803,16 @@ TaskServiceManager::setWeight( TaskService* service, float weight )
     }    
 }
 
+void
+TaskServiceManager::getStats( StatsMap& out_stats ) const
+{
+    ScopedLock<Mutex> lock( const_cast<TaskServiceManager*>(this)->_taskServiceMgrMutex );
+    for( TaskServiceMap::const_iterator i = _services.begin(); i != _services.end(); ++i )
+    {
+        out_stats[i->first] = i->second.first->getStats();
+    }
+}
+
 void
 TaskServiceManager::reallocate( int numThreads )
 {
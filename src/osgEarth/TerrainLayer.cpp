@@ -20,6 +20,7 @@
 #include <osgEarth/TileSource>
 #include <osgEarth/Registry>
 #include <osgEarth/StringUtils>
+#include <osgEarth/ImageUtils>
 #include <osgDB/WriteFile>
 #include <osg/Version>
 #include <OpenThreads/ScopedLock>
@@ -41,8 +42,8 @@ _cacheOnly( false ),
 _loadingWeight( 1.0f ),
 _exactCropping( false ),
 _enabled( true ),
-_reprojectedTileSize( 256 )
-
+_reprojectedTileSize( 256 ),
+_reprojectionTolerance( 0.125 )
 {
     setDefaults();
     fromConfig( _conf ); 
@@ -63,6 +64,7 @@ TerrainLayerOptions::setDefaults()
     _enabled.init( true );
     _exactCropping.init( false );
     _reprojectedTileSize.init( 256 );
+    _reprojectionTolerance.init( 0.125 );
     _cacheEnabled.init( true );
     _cacheOnly.init( false );
     _loadingWeight.init( 1.0f );
@@ -85,6 +87,7 @@ TerrainLayerOptions::getConfig() const
     conf.updateIfSet( "loading_weight", _loadingWeight );
     conf.updateIfSet( "enabled", _enabled );
     conf.updateIfSet( "edge_buffer_ratio", _edgeBufferRatio);
+    conf.updateIfSet( "reprojection_tolerance", _reprojectionTolerance );
     conf.updateObjIfSet( "profile", _profile );
     conf.updateIfSet( "max_data_level", _maxDataLevel);
 
@@ -104,6 +107,7 @@ TerrainLayerOptions::fromConfig( const Config& conf )
     conf.getIfSet( "loading_weight", _loadingWeight );
     conf.getIfSet( "enabled", _enabled );
     conf.getIfSet( "edge_buffer_ratio", _edgeBufferRatio);
+    conf.getIfSet( "reprojection_tolerance", _reprojectionTolerance );
     conf.getObjIfSet( "profile", _profile );
     conf.getIfSet( "max_data_level", _maxDataLevel);
 
@@ -390,3 +394,88 @@ TerrainLayer::setCacheOnly( bool value )
 {
     _overrideCacheOnly = value;
 }
+
+bool
+TerrainLayer::beginTileRequest( const TileKey& key, osg::ref_ptr<PendingTile>& out_pending )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _pendingTilesMutex );
+
+    std::pair<const Profile*, TileKey> id( key.getProfile(), key );
+    PendingTiles::iterator i = _pendingTiles.find( id );
+    if ( i != _pendingTiles.end() )
+    {
+        out_pending = i->second.get();
+        ++out_pending->_waiters;
+        return false;
+    }
+
+    out_pending = new PendingTile();
+    _pendingTiles[id] = out_pending.get();
+    return true;
+}
+
+void
+TerrainLayer::endTileRequest(const TileKey&    key,
+                             PendingTile*      pending,
+                             osg::Object*      result,
+                             const GeoExtent&  extent,
+                             ProgressCallback* progress )
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _pendingTilesMutex );
+        _pendingTiles.erase( std::make_pair(key.getProfile(), key) );
+
+        // once it's out of the map no one else can join, so the waiter count is final.
+        if ( pending->_waiters == 0 )
+            return;
+    }
+
+    // a canceled fetch tells us nothing about the tile, so let the waiters try again.
+    if ( progress && (progress->isCanceled() || progress->needsRetry()) )
+    {
+        pending->_abandoned = true;
+    }
+    else
+    {
+        pending->_result = result;
+        pending->_extent = extent;
+    }
+
+    pending->_ready.set();
+
+    // the caller is free to modify its result once we return, so wait for the
+    // waiters to finish copying it, and drop our reference to it.
+    while( !pending->_released.isSet() )
+        pending->_released.wait();
+
+    pending->_result = 0L;
+}
+
+bool
+TerrainLayer::waitForTile(PendingTile*               pending,
+                          osg::ref_ptr<osg::Object>& out_result,
+                          GeoExtent&                 out_extent ) const
+{
+    OE_DEBUG << LC << "Layer \"" << getName() << "\" waiting on in-progress tile fetch" << std::endl;
+
+    while( !pending->_ready.isSet() )
+        pending->_ready.wait();
+
+    bool ok = !pending->_abandoned;
+    if ( ok )
+    {
+        const osg::Object* result = pending->_result.get();
+        const osg::Image*  image  = dynamic_cast<const osg::Image*>( result );
+        out_result =
+            image  ? ImageUtils::cloneImage( image ) :
+            result ? result->clone( osg::CopyOp::DEEP_COPY_ALL ) :
+            0L;
+        out_extent = pending->_extent;
+    }
+
+    // the last one out lets the publisher go.
+    if ( --pending->_waiters == 0 )
+        pending->_released.set();
+
+    return ok;
+}
@@ -18,6 +18,9 @@
  */
 
 #include <osgEarth/TileKey>
+#include <osgEarth/Notify>
+
+#define LC "[TileKey] "
 
 using namespace osgEarth;
 
@@ -27,59 +30,65 @@ TileKey TileKey::INVALID( 0, 0, 0, 0L );
 
 //------------------------------------------------------------------------
 
-TileKey::TileKey( unsigned int lod, unsigned int tile_x, unsigned int tile_y, const Profile* profile)
+TileKey::TileKey( unsigned int lod, unsigned int tile_x, unsigned int tile_y, const Profile* profile) :
+_code( 0 )
 {
-    _x = tile_x;
-    _y = tile_y;
-    _lod = lod;
-    _profile = profile;
-
-    double width, height;
-    if ( _profile.valid() )
-    {
-        _profile->getTileDimensions(lod, width, height);
-
-        double xmin = _profile->getExtent().xMin() + (width * (double)_x);
-        double ymax = _profile->getExtent().yMax() - (height * (double)_y);
-        double xmax = xmin + width;
-        double ymin = ymax - height;
-
-        _extent = GeoExtent( _profile->getSRS(), xmin, ymin, xmax, ymax );
-
-        std::stringstream buf;
-        buf << _lod << "_" << _x << "_" << _y;
-        _key = buf.str();
-    }
-    else
+    // the fields can't be truncated to fit, or distinct tiles would share a code.
+    if ( lod > (unsigned int)MAX_LOD || tile_x > (unsigned int)MAX_TILE_INDEX || tile_y > (unsigned int)MAX_TILE_INDEX )
     {
-        _extent = GeoExtent::INVALID;
-        _key = "invalid";
+        OE_WARN << LC << "Tile (" << lod << ", " << tile_x << ", " << tile_y
+            << ") is past the supported range; treating it as invalid" << std::endl;
+        return;
     }
+
+    _code =
+        ((unsigned long long)lod    << 58) |
+        ((unsigned long long)tile_x << 29) |
+         (unsigned long long)tile_y;
+    _profile = profile;
 }
 
 TileKey::TileKey( const TileKey& rhs ) :
-_key( rhs._key ),
-_lod(rhs._lod),
-_x(rhs._x),
-_y(rhs._y),
-_profile( rhs._profile.get() ),
-_extent( rhs._extent )
+_code( rhs._code ),
+_profile( rhs._profile.get() )
 {
     //NOP
 }
 
-const Profile*
-TileKey::getProfile() const
+GeoExtent
+TileKey::getExtent() const
 {
-    return _profile.get();
+    if ( !_profile.valid() )
+        return GeoExtent::INVALID;
+
+    double width, height;
+    _profile->getTileDimensions( getLevelOfDetail(), width, height );
+
+    double xmin = _profile->getExtent().xMin() + (width * (double)getTileX());
+    double ymax = _profile->getExtent().yMax() - (height * (double)getTileY());
+    double xmax = xmin + width;
+    double ymin = ymax - height;
+
+    return GeoExtent( _profile->getSRS(), xmin, ymin, xmax, ymax );
+}
+
+std::string
+TileKey::str() const
+{
+    if ( !_profile.valid() )
+        return "invalid";
+
+    std::stringstream buf;
+    buf << getLevelOfDetail() << "_" << getTileX() << "_" << getTileY();
+    return buf.str();
 }
 
 void
 TileKey::getTileXY(unsigned int& out_tile_x,
                    unsigned int& out_tile_y) const
 {
-    out_tile_x = _x;
-    out_tile_y = _y;
+    out_tile_x = getTileX();
+    out_tile_y = getTileY();
 }
 
 osgTerrain::TileID
@@ -87,13 +96,7 @@ TileKey::getTileId() const
 {
     //TODO: will this be an issue with multi-face? perhaps not since each face will
     // exist within its own scene graph.. ?
-    return osgTerrain::TileID(_lod, _x, _y);
-}
-
-unsigned int
-TileKey::getLevelOfDetail() const
-{
-    return _lod;
+    return osgTerrain::TileID(getLevelOfDetail(), getTileX(), getTileY());
 }
 
 void
@@ -103,8 +106,8 @@ TileKey::getPixelExtents(unsigned int& xmin,
                          unsigned int& ymax,
                          const unsigned int &tile_size) const
 {
-    xmin = _x * tile_size;
-    ymin = _y * tile_size;
+    xmin = getTileX() * tile_size;
+    ymin = getTileY() * tile_size;
     xmax = xmin + tile_size;
     ymax = ymin + tile_size; 
 }
@@ -112,9 +115,9 @@ TileKey::getPixelExtents(unsigned int& xmin,
 TileKey
 TileKey::createChildKey( unsigned int quadrant ) const
 {
-    unsigned int lod = _lod + 1;
-    unsigned int x = _x * 2;
-    unsigned int y = _y * 2;
+    unsigned int lod = getLevelOfDetail() + 1;
+    unsigned int x = getTileX() * 2;
+    unsigned int y = getTileY() * 2;
 
     if (quadrant == 1)
     {
@@ -136,21 +139,21 @@ TileKey::createChildKey( unsigned int quadrant ) const
 TileKey
 TileKey::createParentKey() const
 {
-    if (_lod == 0) return TileKey::INVALID;
+    if (getLevelOfDetail() == 0) return TileKey::INVALID;
 
-    unsigned int lod = _lod - 1;
-    unsigned int x = _x / 2;
-    unsigned int y = _y / 2;
+    unsigned int lod = getLevelOfDetail() - 1;
+    unsigned int x = getTileX() / 2;
+    unsigned int y = getTileY() / 2;
     return TileKey( lod, x, y, _profile.get());
 }
 
 TileKey
 TileKey::createAncestorKey( int ancestorLod ) const
 {
-    if ( ancestorLod > (int)_lod ) return TileKey::INVALID;
+    if ( ancestorLod > (int)getLevelOfDetail() ) return TileKey::INVALID;
 
-    unsigned int x = _x, y = _y;
-    for( int i=_lod; i > ancestorLod; i-- )
+    unsigned int x = getTileX(), y = getTileY();
+    for( int i=getLevelOfDetail(); i > ancestorLod; i-- )
     {
         x /= 2;
         y /= 2;
@@ -161,20 +164,23 @@ TileKey::createAncestorKey( int ancestorLod ) const
 TileKey
 TileKey::createNeighborKey( TileKey::Direction dir ) const
 {
+    unsigned int lod = getLevelOfDetail();
     unsigned int tx, ty;
-    getProfile()->getNumTiles( _lod, tx, ty );
+    getProfile()->getNumTiles( lod, tx, ty );
+
+    unsigned int x0 = getTileX(), y0 = getTileY();
 
     unsigned int x =
-        dir == WEST ? _x > 0 ? _x-1 : tx-1 :
-        dir == EAST ? _x+1 < tx ? _x+1 : 0 :
-        _x;
+        dir == WEST ? x0 > 0 ? x0-1 : tx-1 :
+        dir == EAST ? x0+1 < tx ? x0+1 : 0 :
+        x0;
 
     unsigned int y = 
-        dir == SOUTH ? _y > 0 ? _y-1 : ty-1 :
-        dir == NORTH ? _y+1 < ty ? _y+1 : 0 :
-        _y;        
+        dir == SOUTH ? y0 > 0 ? y0-1 : ty-1 :
+        dir == NORTH ? y0+1 < ty ? y0+1 : 0 :
+        y0;        
 
-    return TileKey( _lod, x, y, _profile.get() );
+    return TileKey( lod, x, y, _profile.get() );
 }
 
 bool TileKey::isGeodetic() const
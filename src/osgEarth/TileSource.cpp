@@ -143,9 +143,16 @@ _options( options )
 {
     this->setThreadSafeRefUnref( true );
 
-    if ( *options.L2CacheSize() > 0 )
+    if ( *options.L2CacheSizeMB() > 0 )
     {
-        _memCache = new MemCache( *options.L2CacheSize() );
+        // a byte budget without an explicit tile count means "limit by size only"
+        int maxTiles = options.L2CacheSize().isSet() ? *options.L2CacheSize() : INT_MAX;
+        _memCache = new MemCache( maxTiles, osg::maximum(*options.L2CacheShards(), 1) );
+        _memCache->setMaxSizeInBytes( (unsigned long)(*options.L2CacheSizeMB()) * 1024 * 1024 );
+    }
+    else if ( *options.L2CacheSize() > 0 )
+    {
+        _memCache = new MemCache( *options.L2CacheSize(), osg::maximum(*options.L2CacheShards(), 1) );
     }
     else
     {
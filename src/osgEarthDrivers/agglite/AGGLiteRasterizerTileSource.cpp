@@ -81,6 +81,24 @@ public:
         return true;
     }
 
+    //override
+    double getQueryBuffer( const Style& style, const GeoExtent& imageExtent ) const
+    {
+        if ( _options.relativeLineSize() == true )
+            return FeatureTileSource::getQueryBuffer( style, imageExtent );
+
+        // line widths are in the feature SRS units; convert to the image's.
+        const LineSymbol* line = style.getSymbol<LineSymbol>();
+        if ( !line || !line->stroke()->width().isSet() )
+            return 0.0;
+
+        GeoExtent featureExtent = imageExtent.transform( _features->getFeatureProfile()->getSRS() );
+        if ( !featureExtent.isValid() || featureExtent.width() <= 0.0 )
+            return 0.0;
+
+        return line->stroke()->width().value() * imageExtent.width() / featureExtent.width();
+    }
+
     //override
     bool renderFeaturesForStyle(
         const Style&       style,
@@ -0,0 +1,375 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "PackedCacheOptions"
+#include "PackedTileFile"
+
+#include <osgEarth/FileUtils>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/TMS>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ReaderWriter>
+#include <osgDB/Registry>
+#include <osg/observer_ptr>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <sstream>
+
+// for the compressor stuff
+#if OSG_MIN_VERSION_REQUIRED(2,9,8)
+#  define USE_SERIALIZERS
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+using namespace OpenThreads;
+
+#define LC "[PackedCache] "
+
+// --------------------------------------------------------------------------
+
+namespace
+{
+    /**
+     * A layer's tile store along with the ReaderWriter that encodes its tiles.
+     */
+    struct PackedLayer : public osg::Referenced
+    {
+        osg::ref_ptr<PackedTileFile>                 _file;
+        osg::ref_ptr<osgDB::ReaderWriter>            _rw;
+        osg::ref_ptr<osgDB::ReaderWriter::Options>   _rwOptions;
+        bool                                         _jpeg;
+    };
+
+    typedef std::map< std::string, osg::ref_ptr<PackedLayer> > PackedLayersByName;
+
+    struct AsyncPurge : public TaskRequest
+    {
+        AsyncPurge( const std::string& cacheId, int olderThanUTC, Cache* cache )
+            : _cacheId(cacheId), _olderThanUTC(olderThanUTC), _cache(cache) { }
+
+        void operator()( ProgressCallback* progress ) {
+            osg::ref_ptr<Cache> cache = _cache.get();
+            if ( cache.valid() )
+                cache->purge( _cacheId, _olderThanUTC, false );
+        }
+
+        std::string _cacheId;
+        int _olderThanUTC;
+        osg::observer_ptr<Cache> _cache;
+    };
+
+    struct AsyncCompact : public TaskRequest
+    {
+        AsyncCompact( Cache* cache ) : _cache(cache) { }
+
+        void operator()( ProgressCallback* progress ) {
+            osg::ref_ptr<Cache> cache = _cache.get();
+            if ( cache.valid() )
+                cache->compact( false );
+        }
+
+        osg::observer_ptr<Cache> _cache;
+    };
+}
+
+// --------------------------------------------------------------------------
+
+/**
+ * Cache that stores each layer's tiles in one packed file. See PackedCacheOptions
+ * and PackedTileFile for the file layout and the threading model.
+ */
+class PackedCache : public Cache
+{
+public:
+    PackedCache( const CacheOptions& options )
+      : Cache(options), _options(options)
+    {
+        if ( _options.path().get().empty() || options.getReferenceURI().empty() )
+            _path = _options.path().get();
+        else
+            _path = osgEarth::getFullPath( options.getReferenceURI(), _options.path().get() );
+
+        setName( "packed" );
+
+        if ( _options.readOnly() == false && !_path.empty() && !osgDB::fileExists(_path) && !osgDB::makeDirectory(_path) )
+        {
+            OE_WARN << LC << "Couldn't create path " << _path << std::endl;
+        }
+
+        OE_INFO << LC << "options: " << _options.getConfig().toString() << std::endl;
+    }
+
+    // just here to satisfy the osg::Object requirements
+    PackedCache() { }
+    PackedCache( const PackedCache& rhs, const osg::CopyOp& op ) { }
+    META_Object(osgEarth,PackedCache);
+
+public: // Cache interface
+
+    bool isCached( const TileKey& key, const CacheSpec& spec ) const
+    {
+        osg::ref_ptr<PackedLayer> layer = getLayer( spec );
+        return layer.valid() && layer->_file->isCached( key.getLevelOfDetail(), key.getTileX(), key.getTileY() );
+    }
+
+    bool getImage( const TileKey& key, const CacheSpec& spec, osg::ref_ptr<const osg::Image>& out_image )
+    {
+        osg::ref_ptr<PackedLayer> layer = getLayer( spec );
+        if ( !layer.valid() )
+            return false;
+
+        std::string payload;
+        if ( !layer->_file->read(key.getLevelOfDetail(), key.getTileX(), key.getTileY(), payload) )
+            return false;
+
+        std::istringstream in( payload );
+        osgDB::ReaderWriter::ReadResult rr = layer->_rw->readImage( in, layer->_rwOptions.get() );
+        if ( !rr.success() )
+        {
+            OE_WARN << LC << "Failed to decode tile " << key.str() << " of \"" << spec.cacheId() << "\"" << std::endl;
+            return false;
+        }
+
+        out_image = rr.getImage();
+        return true;
+    }
+
+    void setImage( const TileKey& key, const CacheSpec& spec, const osg::Image* image )
+    {
+        osg::ref_ptr<PackedLayer> layer = getLayer( spec );
+        if ( !layer.valid() || !image )
+            return;
+
+        // encode outside of any lock; only the append is serialized.
+        std::ostringstream out;
+        osg::ref_ptr<osg::Image> rgb;
+        if ( layer->_jpeg && image->getPixelFormat() != GL_RGB )
+        {
+            rgb = ImageUtils::convertToRGB8( image );
+            image = rgb.get();
+            if ( !image )
+                return;
+        }
+
+        osgDB::ReaderWriter::WriteResult wr = layer->_rw->writeImage( *image, out, layer->_rwOptions.get() );
+        if ( !wr.success() )
+        {
+            OE_WARN << LC << "Failed to encode tile " << key.str() << " of \"" << spec.cacheId() << "\"" << std::endl;
+            return;
+        }
+
+        layer->_file->write( key.getLevelOfDetail(), key.getTileX(), key.getTileY(), out.str() );
+    }
+
+    void storeProperties( const CacheSpec& spec, const Profile* profile, unsigned int tileSize )
+    {
+        if ( spec.cacheId().empty() || profile == 0L )
+        {
+            OE_WARN << LC << "ILLEGAL: cannot cache a layer without a layer id" << std::endl;
+            return;
+        }
+
+        osg::ref_ptr<PackedLayer> layer = getLayer( spec );
+        if ( !layer.valid() )
+            return;
+
+        osg::ref_ptr<TileMap> tileMap = TileMap::create( "", profile, spec.format(), tileSize, tileSize );
+        tileMap->setTitle( spec.name() );
+
+        std::ostringstream out;
+        TileMapReaderWriter::write( tileMap.get(), out );
+        layer->_file->writeProperties( out.str() );
+    }
+
+    bool loadProperties(
+        const std::string&           cacheId,
+        CacheSpec&                   out_spec,
+        osg::ref_ptr<const Profile>& out_profile,
+        unsigned int&                out_tileSize )
+    {
+        osg::ref_ptr<PackedLayer> layer = getLayer( CacheSpec(cacheId, ""), false );
+        if ( !layer.valid() )
+            return false;
+
+        std::string props;
+        if ( !layer->_file->readProperties(props) )
+            return false;
+
+        std::istringstream in( props );
+        osg::ref_ptr<TileMap> tileMap = TileMapReaderWriter::read( in );
+        if ( !tileMap.valid() )
+        {
+            OE_WARN << LC << "Failed to load cache metadata for \"" << cacheId << "\"" << std::endl;
+            return false;
+        }
+
+        out_spec     = CacheSpec( cacheId, tileMap->getFormat().getExtension() );
+        out_profile  = tileMap->createProfile();
+        out_tileSize = tileMap->getFormat().getWidth();
+        return true;
+    }
+
+    bool compact( bool async )
+    {
+        if ( _options.readOnly() == true )
+            return false;
+
+        if ( async )
+        {
+            getService()->add( new AsyncCompact(this) );
+            return true;
+        }
+
+        // compact every layer in the directory, not just the ones opened this session.
+        osgDB::DirectoryContents files = osgDB::getDirectoryContents( _path );
+        for( osgDB::DirectoryContents::const_iterator i = files.begin(); i != files.end(); ++i )
+        {
+            if ( osgDB::getLowerCaseFileExtension(*i) == "tiles" )
+            {
+                osg::ref_ptr<PackedLayer> layer = getLayer( CacheSpec(osgDB::getNameLessExtension(*i), ""), false );
+                if ( layer.valid() )
+                    layer->_file->compact();
+            }
+        }
+        return true;
+    }
+
+    bool purge( const std::string& cacheId, int olderThanUTC, bool async )
+    {
+        if ( _options.readOnly() == true )
+            return false;
+
+        if ( async )
+        {
+            getService()->add( new AsyncPurge(cacheId, olderThanUTC, this) );
+            return true;
+        }
+
+        osg::ref_ptr<PackedLayer> layer = getLayer( CacheSpec(cacheId, ""), false );
+        return layer.valid() && layer->_file->purge( olderThanUTC );
+    }
+
+protected:
+
+    virtual ~PackedCache()
+    {
+        // stop the maintenance thread before the layers go away.
+        _service = 0L;
+    }
+
+private:
+
+    /**
+     * Opens the tile store for a layer, creating it if the cache is writable and
+     * "create" is set.
+     */
+    PackedLayer* getLayer( const CacheSpec& spec, bool create =true ) const
+    {
+        ScopedLock<Mutex> lock( _layersMutex );
+
+        PackedLayersByName::const_iterator i = _layers.find( spec.cacheId() );
+        if ( i != _layers.end() )
+            return i->second.get();
+
+        std::string basePath = osgDB::concatPaths( _path, spec.cacheId() );
+        if ( !create && !osgDB::fileExists(basePath + ".tiles") )
+            return 0L;
+
+        bool writable = _options.readOnly() == false;
+
+        std::string format = spec.format().empty() ? "png" : spec.format();
+#ifdef USE_SERIALIZERS
+        // raw images are stored as-is; serializing them would only add decode work.
+        if ( format != "osgearth_raw" && format != "osgearth_dxt" )
+            format = "osgb";
+#endif
+
+        osg::ref_ptr<PackedLayer> layer = new PackedLayer();
+        layer->_file = new PackedTileFile( basePath, _options.indexBatchSize().value() );
+
+        // remember a layer that doesn't exist in a read-only cache, so we don't keep looking for it.
+        if ( !layer->_file->open(writable, format) )
+        {
+            _layers[spec.cacheId()] = 0L;
+            return 0L;
+        }
+
+        format = layer->_file->getFormat();
+        layer->_rw = osgDB::Registry::instance()->getReaderWriterForExtension( format );
+        if ( !layer->_rw.valid() )
+        {
+            OE_WARN << LC << "Cannot initialize ReaderWriter for format \"" << format << "\"" << std::endl;
+            _layers[spec.cacheId()] = 0L;
+            return 0L;
+        }
+
+        if ( format == "osgb" )
+            layer->_rwOptions = new osgDB::ReaderWriter::Options( "Compressor=zlib" );
+        else if ( format == "osgearth_dxt" )
+            layer->_rwOptions = new osgDB::ReaderWriter::Options( "DXT" );
+
+        layer->_jpeg = format == "jpg" || format == "jpeg";
+
+        _layers[spec.cacheId()] = layer.get();
+        return layer.get();
+    }
+
+    TaskService* getService()
+    {
+        ScopedLock<Mutex> lock( _layersMutex );
+        if ( !_service.valid() )
+            _service = new TaskService( "PackedCache Maintenance Service", 1 );
+        return _service.get();
+    }
+
+    PackedCacheOptions _options;
+    std::string        _path;
+
+    mutable Mutex              _layersMutex;
+    mutable PackedLayersByName _layers;
+    osg::ref_ptr<TaskService>  _service;
+};
+
+// --------------------------------------------------------------------------
+
+class PackedCacheFactory : public CacheDriver
+{
+public:
+    PackedCacheFactory()
+    {
+        supportsExtension( "osgearth_cache_packed", "Packed single-file cache for osgEarth" );
+    }
+
+    virtual const char* className()
+    {
+        return "Packed single-file cache for osgEarth";
+    }
+
+    virtual ReadResult readObject(const std::string& file_name, const Options* options) const
+    {
+        if ( !acceptsExtension(osgDB::getLowerCaseFileExtension( file_name )))
+            return ReadResult::FILE_NOT_HANDLED;
+
+        return ReadResult( new PackedCache( getCacheOptions(options) ) );
+    }
+};
+
+REGISTER_OSGPLUGIN(osgearth_cache_packed, PackedCacheFactory)
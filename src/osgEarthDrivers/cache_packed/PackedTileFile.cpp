@@ -0,0 +1,980 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "PackedTileFile"
+
+#include <osgEarth/Notify>
+#include <osg/Math>
+#include <OpenThreads/ScopedLock>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <errno.h>
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+using namespace OpenThreads;
+
+#define LC "[PackedCache] "
+
+namespace
+{
+    const char         DATA_MAGIC[8]   = { 'O','E','P','A','C','K','0','1' };
+    const char         INDEX_MAGIC[8]  = { 'O','E','P','I','D','X','0','1' };
+    const unsigned int BYTE_ORDER_MARK = 0x01020304;
+    const unsigned int RECORD_MAGIC    = 0x454c4954; // "TILE"
+    const unsigned int PROPERTIES_LOD  = ~0u;        // lod of the record holding the layer properties
+
+    // buffer size for bulk copies during compaction
+    const unsigned int COPY_BUFFER_SIZE = 4 * 1024 * 1024;
+
+    /** Start of the data file */
+    struct DataHeader
+    {
+        char         _magic[8];
+        unsigned int _byteOrder;
+        char         _format[20];
+    };
+
+    /** Start of the index file; followed by _count PackedIndexEntry's */
+    struct IndexHeader
+    {
+        char         _magic[8];
+        unsigned int _byteOrder;
+        unsigned int _count;
+        unsigned int _dataSizeLo, _dataSizeHi;       // extent of the data file this index covers
+        unsigned int _propsOffsetLo, _propsOffsetHi;
+        unsigned int _propsSize;
+        unsigned int _reserved;
+    };
+
+    /** Precedes each tile's payload in the data file */
+    struct RecordHeader
+    {
+        unsigned int _magic;
+        unsigned int _lod, _x, _y;
+        unsigned int _timestamp;
+        unsigned int _size;
+    };
+
+    // shift in two steps; a single 32-bit shift is undefined when the offset type is 32 bits wide.
+    void splitOffset( PackedFileOffset offset, unsigned int& out_lo, unsigned int& out_hi )
+    {
+        out_lo = (unsigned int)(offset & 0xffffffff);
+        out_hi = (unsigned int)((offset >> 16) >> 16);
+    }
+
+    PackedFileOffset joinOffset( unsigned int lo, unsigned int hi )
+    {
+        return (((PackedFileOffset)hi << 16) << 16) | (PackedFileOffset)lo;
+    }
+
+    void initDataHeader( DataHeader& header, const std::string& format )
+    {
+        ::memset( &header, 0, sizeof(header) );
+        ::memcpy( header._magic, DATA_MAGIC, sizeof(DATA_MAGIC) );
+        header._byteOrder = BYTE_ORDER_MARK;
+        ::strncpy( header._format, format.c_str(), sizeof(header._format)-1 );
+    }
+
+    /** Appends a record (header and payload) to a buffer. */
+    void encodeRecord( const PackedIndexEntry& entry, const char* payload, std::string& buf )
+    {
+        RecordHeader rh;
+        rh._magic     = RECORD_MAGIC;
+        rh._lod       = entry._lod;
+        rh._x         = entry._x;
+        rh._y         = entry._y;
+        rh._timestamp = entry._timestamp;
+        rh._size      = entry._size;
+        buf.append( (const char*)&rh, sizeof(rh) );
+        buf.append( payload, entry._size );
+    }
+
+    /** Merges two sorted runs; entries in the newer run replace equal ones in the older. */
+    void mergeTwo( const PackedIndexRun* older, const PackedIndexRun* newer, std::vector<PackedIndexEntry>& out )
+    {
+        out.reserve( older->size() + newer->size() );
+        const PackedIndexEntry* a = older->begin();
+        const PackedIndexEntry* b = newer->begin();
+        while( a != older->end() && b != newer->end() )
+        {
+            if ( *a < *b )
+                out.push_back( *a++ );
+            else if ( *b < *a )
+                out.push_back( *b++ );
+            else
+                out.push_back( *b++ ), ++a;
+        }
+        out.insert( out.end(), a, older->end() );
+        out.insert( out.end(), b, newer->end() );
+    }
+
+    bool replaceFile( const std::string& from, const std::string& to )
+    {
+#ifdef _WIN32
+        return ::MoveFileExA( from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+        return ::rename( from.c_str(), to.c_str() ) == 0;
+#endif
+    }
+}
+
+//------------------------------------------------------------------------
+
+PackedFileOffset
+PackedIndexEntry::getOffset() const
+{
+    return joinOffset( _offsetLo, _offsetHi );
+}
+
+void
+PackedIndexEntry::setOffset( PackedFileOffset offset )
+{
+    splitOffset( offset, _offsetLo, _offsetHi );
+}
+
+//------------------------------------------------------------------------
+
+#ifdef _WIN32
+
+PackedDataFile::PackedDataFile() :
+_handle( INVALID_HANDLE_VALUE )
+{
+    //NOP
+}
+
+PackedDataFile::~PackedDataFile()
+{
+    if ( _handle != INVALID_HANDLE_VALUE )
+        ::CloseHandle( (HANDLE)_handle );
+}
+
+bool
+PackedDataFile::open( const std::string& path, bool writable )
+{
+    // FILE_SHARE_DELETE lets compaction replace the file while readers still hold it open.
+    _handle = ::CreateFileA(
+        path.c_str(),
+        writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        0L,
+        writable ? OPEN_ALWAYS : OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        0L );
+    return _handle != INVALID_HANDLE_VALUE;
+}
+
+bool
+PackedDataFile::isOpen() const
+{
+    return _handle != INVALID_HANDLE_VALUE;
+}
+
+bool
+PackedDataFile::readAt( PackedFileOffset offset, void* buf, unsigned int len ) const
+{
+    OVERLAPPED ov;
+    ::memset( &ov, 0, sizeof(ov) );
+    ov.Offset     = (DWORD)(offset & 0xffffffff);
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD numRead = 0;
+    return ::ReadFile( (HANDLE)_handle, buf, len, &numRead, &ov ) && numRead == len;
+}
+
+bool
+PackedDataFile::writeAt( PackedFileOffset offset, const void* buf, unsigned int len )
+{
+    OVERLAPPED ov;
+    ::memset( &ov, 0, sizeof(ov) );
+    ov.Offset     = (DWORD)(offset & 0xffffffff);
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD numWritten = 0;
+    return ::WriteFile( (HANDLE)_handle, buf, len, &numWritten, &ov ) && numWritten == len;
+}
+
+PackedFileOffset
+PackedDataFile::size() const
+{
+    LARGE_INTEGER size;
+    if ( !::GetFileSizeEx( (HANDLE)_handle, &size ) )
+        return 0;
+    return (PackedFileOffset)size.QuadPart;
+}
+
+PackedMappedFile::PackedMappedFile() :
+_data( 0L ),
+_size( 0 ),
+_mapping( 0L )
+{
+    //NOP
+}
+
+PackedMappedFile::~PackedMappedFile()
+{
+    if ( _data )
+        ::UnmapViewOfFile( _data );
+    if ( _mapping )
+        ::CloseHandle( (HANDLE)_mapping );
+}
+
+bool
+PackedMappedFile::map( const std::string& path )
+{
+    HANDLE file = ::CreateFileA(
+        path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        0L, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0L );
+    if ( file == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    if ( ::GetFileSizeEx( file, &size ) && size.QuadPart > 0 && size.HighPart == 0 )
+    {
+        _mapping = ::CreateFileMappingA( file, 0L, PAGE_READONLY, 0, 0, 0L );
+        if ( _mapping )
+        {
+            _data = (const char*)::MapViewOfFile( (HANDLE)_mapping, FILE_MAP_READ, 0, 0, 0 );
+            _size = size.LowPart;
+        }
+    }
+
+    // the mapping keeps the file open.
+    ::CloseHandle( file );
+    return _data != 0L;
+}
+
+#else // POSIX
+
+PackedDataFile::PackedDataFile() :
+_fd( -1 )
+{
+    //NOP
+}
+
+PackedDataFile::~PackedDataFile()
+{
+    if ( _fd >= 0 )
+        ::close( _fd );
+}
+
+bool
+PackedDataFile::open( const std::string& path, bool writable )
+{
+    _fd = ::open( path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644 );
+    return _fd >= 0;
+}
+
+bool
+PackedDataFile::isOpen() const
+{
+    return _fd >= 0;
+}
+
+bool
+PackedDataFile::readAt( PackedFileOffset offset, void* buf, unsigned int len ) const
+{
+    char* p = (char*)buf;
+    while( len > 0 )
+    {
+        ssize_t n = ::pread( _fd, p, len, offset );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return false;
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool
+PackedDataFile::writeAt( PackedFileOffset offset, const void* buf, unsigned int len )
+{
+    const char* p = (const char*)buf;
+    while( len > 0 )
+    {
+        ssize_t n = ::pwrite( _fd, p, len, offset );
+        if ( n < 0 && errno == EINTR )
+            continue;
+        if ( n <= 0 )
+            return false;
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+PackedFileOffset
+PackedDataFile::size() const
+{
+    struct stat st;
+    if ( ::fstat( _fd, &st ) != 0 )
+        return 0;
+    return st.st_size;
+}
+
+PackedMappedFile::PackedMappedFile() :
+_data( 0L ),
+_size( 0 )
+{
+    //NOP
+}
+
+PackedMappedFile::~PackedMappedFile()
+{
+    if ( _data )
+        ::munmap( (void*)_data, _size );
+}
+
+bool
+PackedMappedFile::map( const std::string& path )
+{
+    int fd = ::open( path.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        return false;
+
+    struct stat st;
+    if ( ::fstat( fd, &st ) == 0 && st.st_size > 0 && (PackedFileOffset)(unsigned int)st.st_size == st.st_size )
+    {
+        void* data = ::mmap( 0L, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+        if ( data != MAP_FAILED )
+        {
+            _data = (const char*)data;
+            _size = (unsigned int)st.st_size;
+        }
+    }
+
+    // the mapping stays valid after the descriptor is closed.
+    ::close( fd );
+    return _data != 0L;
+}
+
+#endif
+
+//------------------------------------------------------------------------
+
+PackedIndexRun::PackedIndexRun( PackedMappedFile* file, const PackedIndexEntry* begin, unsigned int count ) :
+_file ( file ),
+_begin( begin ),
+_count( count )
+{
+    //NOP
+}
+
+PackedIndexRun::PackedIndexRun( std::vector<PackedIndexEntry>& entries ) :
+_begin( 0L ),
+_count( entries.size() )
+{
+    _entries.swap( entries );
+    if ( _count > 0 )
+        _begin = &_entries[0];
+}
+
+const PackedIndexEntry*
+PackedIndexRun::find( unsigned int lod, unsigned int x, unsigned int y ) const
+{
+    PackedIndexEntry key;
+    key._lod = lod;
+    key._x   = x;
+    key._y   = y;
+
+    const PackedIndexEntry* i = std::lower_bound( begin(), end(), key );
+    return i != end() && !(key < *i) ? i : 0L;
+}
+
+const PackedIndexEntry*
+PackedSnapshot::find( unsigned int lod, unsigned int x, unsigned int y ) const
+{
+    // newest run first, so a rewritten tile is found before its stale entry.
+    for( PackedIndexRunVector::const_reverse_iterator i = _runs.rbegin(); i != _runs.rend(); ++i )
+    {
+        const PackedIndexEntry* entry = i->get()->find( lod, x, y );
+        if ( entry )
+            return entry;
+    }
+    return 0L;
+}
+
+//------------------------------------------------------------------------
+
+PackedTileFile::PackedTileFile( const std::string& basePath, unsigned int batchSize ) :
+_dataPath  ( basePath + ".tiles" ),
+_indexPath ( basePath + ".index" ),
+_batchSize ( osg::maximum(batchSize, 1u) ),
+_writable  ( false ),
+_dataEnd   ( 0 ),
+_indexDirty( false )
+{
+    //NOP
+}
+
+PackedTileFile::~PackedTileFile()
+{
+    flush();
+}
+
+bool
+PackedTileFile::open( bool writable, const std::string& format )
+{
+    _writable = writable;
+
+    osg::ref_ptr<PackedDataFile> data = new PackedDataFile();
+    if ( !data->open(_dataPath, writable) )
+    {
+        if ( writable )
+            OE_WARN << LC << "Unable to open " << _dataPath << std::endl;
+        return false;
+    }
+
+    PackedFileOffset size = data->size();
+
+    DataHeader dh;
+    if ( size == 0 && writable )
+    {
+        initDataHeader( dh, format );
+        if ( !data->writeAt(0, &dh, sizeof(dh)) )
+        {
+            OE_WARN << LC << "Unable to write to " << _dataPath << std::endl;
+            return false;
+        }
+        size = sizeof(dh);
+    }
+    else if (
+        size < (PackedFileOffset)sizeof(dh)      ||
+        !data->readAt(0, &dh, sizeof(dh))        ||
+        ::memcmp(dh._magic, DATA_MAGIC, sizeof(DATA_MAGIC)) != 0 ||
+        dh._byteOrder != BYTE_ORDER_MARK )
+    {
+        OE_WARN << LC << _dataPath << " is not a packed tile file" << std::endl;
+        return false;
+    }
+
+    dh._format[sizeof(dh._format)-1] = 0;
+    _format = dh._format;
+
+    osg::ref_ptr<PackedSnapshot> snapshot = new PackedSnapshot();
+    snapshot->_data = data.get();
+
+    // map the index, if it is consistent with the data file.
+    PackedFileOffset indexed = sizeof(DataHeader);
+    osg::ref_ptr<PackedMappedFile> index = new PackedMappedFile();
+    if ( index->map(_indexPath) )
+    {
+        const IndexHeader* ih = (const IndexHeader*)index->data();
+        if (index->size() >= sizeof(IndexHeader) &&
+            ::memcmp(ih->_magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+            ih->_byteOrder == BYTE_ORDER_MARK &&
+            index->size() == sizeof(IndexHeader) + ih->_count * sizeof(PackedIndexEntry) &&
+            joinOffset(ih->_dataSizeLo, ih->_dataSizeHi) >= indexed &&
+            joinOffset(ih->_dataSizeLo, ih->_dataSizeHi) <= size )
+        {
+            indexed = joinOffset( ih->_dataSizeLo, ih->_dataSizeHi );
+            snapshot->_propsOffset = joinOffset( ih->_propsOffsetLo, ih->_propsOffsetHi );
+            snapshot->_propsSize   = ih->_propsSize;
+            if ( ih->_count > 0 )
+            {
+                snapshot->_runs.push_back( new PackedIndexRun(
+                    index.get(), (const PackedIndexEntry*)(index->data() + sizeof(IndexHeader)), ih->_count) );
+            }
+        }
+        else
+        {
+            OE_WARN << LC << "Index " << _indexPath << " does not match its data file; rebuilding" << std::endl;
+        }
+    }
+
+    // index any records written after the index was.
+    _dataEnd = indexed;
+    if ( indexed < size )
+    {
+        std::vector<PackedIndexEntry> entries;
+        scan( snapshot.get(), indexed, entries );
+        if ( !entries.empty() )
+        {
+            OE_INFO << LC << "Indexed " << entries.size() << " tiles in " << _dataPath << std::endl;
+
+            // keep the last record written for each tile.
+            std::stable_sort( entries.begin(), entries.end() );
+            std::vector<PackedIndexEntry> unique;
+            unique.reserve( entries.size() );
+            for( unsigned int i = 0; i < entries.size(); ++i )
+            {
+                if ( i+1 < entries.size() && !(entries[i] < entries[i+1]) )
+                    continue;
+                unique.push_back( entries[i] );
+            }
+            snapshot->_runs.push_back( new PackedIndexRun(unique) );
+        }
+        _indexDirty = true;
+    }
+
+    publish( snapshot.get() );
+    return true;
+}
+
+void
+PackedTileFile::scan( PackedSnapshot* snapshot, PackedFileOffset start, std::vector<PackedIndexEntry>& out_entries )
+{
+    PackedDataFile*  file = snapshot->_data.get();
+    PackedFileOffset size = file->size();
+    PackedFileOffset pos  = start;
+
+    RecordHeader rh;
+    while(
+        pos + (PackedFileOffset)sizeof(rh) <= size &&
+        file->readAt(pos, &rh, sizeof(rh)) &&
+        rh._magic == RECORD_MAGIC &&
+        pos + (PackedFileOffset)sizeof(rh) + rh._size <= size )
+    {
+        if ( rh._lod == PROPERTIES_LOD )
+        {
+            snapshot->_propsOffset = pos;
+            snapshot->_propsSize   = rh._size;
+        }
+        else
+        {
+            PackedIndexEntry entry;
+            entry._lod       = rh._lod;
+            entry._x         = rh._x;
+            entry._y         = rh._y;
+            entry._timestamp = rh._timestamp;
+            entry._size      = rh._size;
+            entry._reserved  = 0;
+            entry.setOffset( pos );
+            out_entries.push_back( entry );
+        }
+        pos += sizeof(rh) + rh._size;
+    }
+
+    // a partial record at the end is left over from an interrupted write; the next write replaces it.
+    if ( pos < size )
+    {
+        OE_WARN << LC << "Ignoring " << (size - pos) << " bytes of incomplete data at the end of " << _dataPath << std::endl;
+    }
+    _dataEnd = pos;
+}
+
+osg::ref_ptr<PackedSnapshot>
+PackedTileFile::getSnapshot() const
+{
+    ScopedLock<Mutex> lock( _snapshotMutex );
+    return _snapshot;
+}
+
+void
+PackedTileFile::publish( PackedSnapshot* snapshot )
+{
+    ScopedLock<Mutex> lock( _snapshotMutex );
+    _snapshot = snapshot;
+}
+
+void
+PackedTileFile::mergeRuns( PackedIndexRunVector& runs, bool all ) const
+{
+    // merge the newest run into its neighbor while they're within a factor of two in size,
+    // so that the run sizes shrink geometrically and there are O(log n) of them.
+    while( runs.size() > 1 )
+    {
+        PackedIndexRun* older = runs[runs.size()-2].get();
+        PackedIndexRun* newer = runs[runs.size()-1].get();
+        if ( !all && older->size() > 2 * newer->size() )
+            break;
+
+        std::vector<PackedIndexEntry> merged;
+        mergeTwo( older, newer, merged );
+        runs.pop_back();
+        runs.back() = new PackedIndexRun( merged );
+    }
+}
+
+bool
+PackedTileFile::isCached( unsigned int lod, unsigned int x, unsigned int y ) const
+{
+    osg::ref_ptr<PackedSnapshot> snapshot = getSnapshot();
+    return snapshot.valid() && snapshot->find(lod, x, y) != 0L;
+}
+
+bool
+PackedTileFile::read( unsigned int lod, unsigned int x, unsigned int y, std::string& out_payload ) const
+{
+    osg::ref_ptr<PackedSnapshot> snapshot = getSnapshot();
+    if ( !snapshot.valid() )
+        return false;
+
+    const PackedIndexEntry* entry = snapshot->find( lod, x, y );
+    if ( !entry )
+        return false;
+
+    // read the header and payload in one go, then strip the header.
+    out_payload.resize( sizeof(RecordHeader) + entry->_size );
+    if ( !snapshot->_data->readAt(entry->getOffset(), &out_payload[0], out_payload.size()) )
+        return false;
+
+    RecordHeader rh;
+    ::memcpy( &rh, out_payload.data(), sizeof(rh) );
+    if ( rh._magic != RECORD_MAGIC || rh._lod != lod || rh._x != x || rh._y != y || rh._size != entry->_size )
+    {
+        OE_WARN << LC << "Corrupt record for tile " << lod << "/" << x << "/" << y << " in " << _dataPath << std::endl;
+        return false;
+    }
+
+    out_payload.erase( 0, sizeof(RecordHeader) );
+    return true;
+}
+
+bool
+PackedTileFile::write( unsigned int lod, unsigned int x, unsigned int y, const std::string& payload )
+{
+    if ( !_writable )
+        return false;
+
+    ScopedLock<Mutex> lock( _writeMutex );
+
+    osg::ref_ptr<PackedSnapshot> current = getSnapshot();
+    if ( !current.valid() )
+        return false;
+
+    PackedIndexEntry entry;
+    entry._lod       = lod;
+    entry._x         = x;
+    entry._y         = y;
+    entry._timestamp = (unsigned int)::time(0L);
+    entry._size      = payload.size();
+    entry._reserved  = 0;
+    entry.setOffset( _dataEnd );
+
+    std::string buf;
+    encodeRecord( entry, payload.data(), buf );
+    if ( !current->_data->writeAt(_dataEnd, buf.data(), buf.size()) )
+    {
+        OE_WARN << LC << "Failed to write tile " << lod << "/" << x << "/" << y << " to " << _dataPath << std::endl;
+        return false;
+    }
+    _dataEnd += buf.size();
+
+    osg::ref_ptr<PackedSnapshot> next = new PackedSnapshot( *current );
+
+    // new entries collect in a small run (copied on each write) until it fills up
+    // to the batch size; only then does it join the merge schedule.
+    std::vector<PackedIndexEntry> entries;
+    if ( !next->_runs.empty() && next->_runs.back()->size() < _batchSize )
+    {
+        entries.assign( next->_runs.back()->begin(), next->_runs.back()->end() );
+        next->_runs.pop_back();
+    }
+
+    std::vector<PackedIndexEntry>::iterator i = std::lower_bound( entries.begin(), entries.end(), entry );
+    if ( i != entries.end() && !(entry < *i) )
+        *i = entry;
+    else
+        entries.insert( i, entry );
+
+    next->_runs.push_back( new PackedIndexRun(entries) );
+    if ( next->_runs.back()->size() >= _batchSize )
+        mergeRuns( next->_runs, false );
+
+    publish( next.get() );
+    _indexDirty = true;
+    return true;
+}
+
+bool
+PackedTileFile::readProperties( std::string& out_props ) const
+{
+    osg::ref_ptr<PackedSnapshot> snapshot = getSnapshot();
+    if ( !snapshot.valid() || snapshot->_propsSize == 0 )
+        return false;
+
+    std::string buf( sizeof(RecordHeader) + snapshot->_propsSize, 0 );
+    if ( !snapshot->_data->readAt(snapshot->_propsOffset, &buf[0], buf.size()) )
+        return false;
+
+    RecordHeader rh;
+    ::memcpy( &rh, buf.data(), sizeof(rh) );
+    if ( rh._magic != RECORD_MAGIC || rh._lod != PROPERTIES_LOD )
+        return false;
+
+    out_props = buf.substr( sizeof(RecordHeader) );
+    return true;
+}
+
+bool
+PackedTileFile::writeProperties( const std::string& props )
+{
+    if ( !_writable )
+        return false;
+
+    ScopedLock<Mutex> lock( _writeMutex );
+
+    // layers store their properties every time they start up; don't pile up copies.
+    std::string existing;
+    if ( readProperties(existing) && existing == props )
+        return true;
+
+    osg::ref_ptr<PackedSnapshot> current = getSnapshot();
+    if ( !current.valid() )
+        return false;
+
+    PackedIndexEntry entry;
+    entry._lod       = PROPERTIES_LOD;
+    entry._x         = 0;
+    entry._y         = 0;
+    entry._timestamp = (unsigned int)::time(0L);
+    entry._size      = props.size();
+
+    std::string buf;
+    encodeRecord( entry, props.data(), buf );
+    if ( !current->_data->writeAt(_dataEnd, buf.data(), buf.size()) )
+        return false;
+
+    osg::ref_ptr<PackedSnapshot> next = new PackedSnapshot( *current );
+    next->_propsOffset = _dataEnd;
+    next->_propsSize   = props.size();
+    _dataEnd += buf.size();
+
+    publish( next.get() );
+    _indexDirty = true;
+    return true;
+}
+
+bool
+PackedTileFile::purge( int olderThanUTC )
+{
+    if ( !_writable )
+        return false;
+
+    ScopedLock<Mutex> lock( _writeMutex );
+
+    osg::ref_ptr<PackedSnapshot> current = getSnapshot();
+    if ( !current.valid() )
+        return false;
+
+    osg::ref_ptr<PackedSnapshot> next = new PackedSnapshot( *current );
+    mergeRuns( next->_runs, true );
+
+    std::vector<PackedIndexEntry> kept;
+    if ( olderThanUTC > 0 && !next->_runs.empty() )
+    {
+        const PackedIndexRun* run = next->_runs.front().get();
+        for( const PackedIndexEntry* e = run->begin(); e != run->end(); ++e )
+        {
+            if ( e->_timestamp >= (unsigned int)olderThanUTC )
+                kept.push_back( *e );
+        }
+    }
+
+    unsigned int before = next->_runs.empty() ? 0 : next->_runs.front()->size();
+    next->_runs.clear();
+    if ( !kept.empty() )
+        next->_runs.push_back( new PackedIndexRun(kept) );
+
+    publish( next.get() );
+
+    OE_INFO << LC << "Purged " << (before - (next->_runs.empty() ? 0 : next->_runs.front()->size()))
+        << " tiles from " << _dataPath << std::endl;
+
+    // persist right away, so a rebuild of the index can't bring the tiles back.
+    _indexDirty = !writeIndex( next.get() );
+    return !_indexDirty;
+}
+
+bool
+PackedTileFile::compact()
+{
+    if ( !_writable )
+        return false;
+
+    ScopedLock<Mutex> lock( _writeMutex );
+
+    osg::ref_ptr<PackedSnapshot> current = getSnapshot();
+    if ( !current.valid() )
+        return false;
+
+    PackedIndexRunVector runs = current->_runs;
+    mergeRuns( runs, true );
+
+    std::string tempPath = _dataPath + ".tmp";
+    ::remove( tempPath.c_str() );
+
+    PackedFileOffset end = 0;
+    std::vector<PackedIndexEntry> entries;
+    osg::ref_ptr<PackedSnapshot> next = new PackedSnapshot();
+    {
+        osg::ref_ptr<PackedDataFile> temp = new PackedDataFile();
+        if ( !temp->open(tempPath, true) )
+        {
+            OE_WARN << LC << "Unable to create " << tempPath << std::endl;
+            return false;
+        }
+
+        std::string buf;
+        DataHeader dh;
+        initDataHeader( dh, _format );
+        buf.append( (const char*)&dh, sizeof(dh) );
+
+        bool ok = true;
+        std::string payload;
+
+        // copy the live tiles in index order, so that neighboring tiles end up
+        // near each other in the file.
+        if ( !runs.empty() )
+        {
+            const PackedIndexRun* run = runs.front().get();
+            entries.reserve( run->size() );
+            for( const PackedIndexEntry* e = run->begin(); e != run->end() && ok; ++e )
+            {
+                payload.resize( sizeof(RecordHeader) + e->_size );
+                ok = current->_data->readAt( e->getOffset(), &payload[0], payload.size() );
+
+                PackedIndexEntry moved = *e;
+                moved.setOffset( end + buf.size() );
+                encodeRecord( moved, payload.data() + sizeof(RecordHeader), buf );
+                entries.push_back( moved );
+
+                if ( buf.size() >= COPY_BUFFER_SIZE )
+                {
+                    ok = ok && temp->writeAt( end, buf.data(), buf.size() );
+                    end += buf.size();
+                    buf.clear();
+                }
+            }
+        }
+
+        if ( ok && current->_propsSize > 0 )
+        {
+            payload.resize( sizeof(RecordHeader) + current->_propsSize );
+            ok = current->_data->readAt( current->_propsOffset, &payload[0], payload.size() );
+
+            next->_propsOffset = end + buf.size();
+            next->_propsSize   = current->_propsSize;
+            buf.append( payload );
+        }
+
+        ok = ok && temp->writeAt( end, buf.data(), buf.size() );
+        end += buf.size();
+
+        if ( !ok )
+        {
+            OE_WARN << LC << "Failed to compact " << _dataPath << std::endl;
+            temp = 0L;
+            ::remove( tempPath.c_str() );
+            return false;
+        }
+    }
+
+    // readers holding the old snapshot keep reading the old (now unlinked) file.
+    if ( !replaceFile(tempPath, _dataPath) )
+    {
+        OE_WARN << LC << "Unable to replace " << _dataPath << " with its compacted copy" << std::endl;
+        ::remove( tempPath.c_str() );
+        return false;
+    }
+
+    next->_data = new PackedDataFile();
+    if ( !next->_data->open(_dataPath, true) )
+    {
+        OE_WARN << LC << "Unable to reopen " << _dataPath << std::endl;
+        return false;
+    }
+    if ( !entries.empty() )
+        next->_runs.push_back( new PackedIndexRun(entries) );
+
+    OE_INFO << LC << "Compacted " << _dataPath << " from " << _dataEnd << " to " << end << " bytes" << std::endl;
+
+    _dataEnd = end;
+    publish( next.get() );
+
+    _indexDirty = !writeIndex( next.get() );
+    return true;
+}
+
+bool
+PackedTileFile::flush()
+{
+    if ( !_writable )
+        return true;
+
+    ScopedLock<Mutex> lock( _writeMutex );
+
+    if ( !_indexDirty )
+        return true;
+
+    osg::ref_ptr<PackedSnapshot> current = getSnapshot();
+    if ( !current.valid() )
+        return false;
+
+    osg::ref_ptr<PackedSnapshot> next = new PackedSnapshot( *current );
+    mergeRuns( next->_runs, true );
+    publish( next.get() );
+
+    _indexDirty = !writeIndex( next.get() );
+    return !_indexDirty;
+}
+
+bool
+PackedTileFile::writeIndex( const PackedSnapshot* snapshot )
+{
+    // caller holds the write lock and has merged the index into (at most) one run.
+    const PackedIndexRun* run = snapshot->_runs.empty() ? 0L : snapshot->_runs.front().get();
+
+    IndexHeader ih;
+    ::memset( &ih, 0, sizeof(ih) );
+    ::memcpy( ih._magic, INDEX_MAGIC, sizeof(INDEX_MAGIC) );
+    ih._byteOrder = BYTE_ORDER_MARK;
+    ih._count     = run ? run->size() : 0;
+    ih._propsSize = snapshot->_propsSize;
+    splitOffset( _dataEnd, ih._dataSizeLo, ih._dataSizeHi );
+    splitOffset( snapshot->_propsOffset, ih._propsOffsetLo, ih._propsOffsetHi );
+
+    // write a new file and swap it in, so a reader never maps a partial index.
+    std::string tempPath = _indexPath + ".tmp";
+    {
+        std::ofstream out( tempPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+        out.write( (const char*)&ih, sizeof(ih) );
+        if ( run && run->size() > 0 )
+            out.write( (const char*)run->begin(), run->size() * sizeof(PackedIndexEntry) );
+        out.close();
+        if ( out.fail() )
+        {
+            OE_WARN << LC << "Failed to write " << tempPath << std::endl;
+            ::remove( tempPath.c_str() );
+            return false;
+        }
+    }
+
+    if ( !replaceFile(tempPath, _indexPath) )
+    {
+        OE_WARN << LC << "Unable to replace " << _indexPath << std::endl;
+        ::remove( tempPath.c_str() );
+        return false;
+    }
+    return true;
+}
@@ -30,6 +30,7 @@
 #include <OpenThreads/ScopedLock>
 #include <cstring>
 #include <fstream>
+#include <deque>
 
 // for the compressor stuff
 #if OSG_MIN_VERSION_REQUIRED(2,9,8)
@@ -61,9 +62,24 @@ using namespace OpenThreads;
 
 // --------------------------------------------------------------------------
 
-// opens a database connection with default settings.
+// runs a statement that returns no results, warning on failure.
 static
-sqlite3* openDatabase( const std::string& path, bool serialized )
+bool execSQL( sqlite3* db, const std::string& sql )
+{
+    char* errMsg = 0L;
+    int rc = sqlite3_exec( db, sql.c_str(), 0L, 0L, &errMsg );
+    if ( rc != SQLITE_OK )
+    {
+        OE_WARN << LC << "SQL failed: " << (errMsg ? errMsg : "") << " (SQL: " << sql << ")" << std::endl;
+        sqlite3_free( errMsg );
+        return false;
+    }
+    return true;
+}
+
+// opens a database connection and applies the tuning settings in the options.
+static
+sqlite3* openDatabase( const std::string& path, const Sqlite3CacheOptions& options )
 {
     //Try to create the path if it doesn't exist
     std::string dirPath = osgDB::getFilePath(path);    
@@ -78,7 +94,7 @@ sqlite3* openDatabase( const std::string& path, bool serialized )
 
     // not sure if SHAREDCACHE is necessary or wise 
     int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
-    flags |= serialized ? SQLITE_OPEN_FULLMUTEX : SQLITE_OPEN_NOMUTEX;
+    flags |= options.serialized() == true ? SQLITE_OPEN_FULLMUTEX : SQLITE_OPEN_NOMUTEX;
 
     int rc = sqlite3_open_v2( path.c_str(), &db, flags, 0L );
 
@@ -91,6 +107,39 @@ sqlite3* openDatabase( const std::string& path, bool serialized )
     // make sure that writes actually finish
     sqlite3_busy_timeout( db, 60000 );
 
+    std::stringstream buf;
+
+    // page size must be set before the database is first written.
+    if ( options.pageSize().value() > 0 )
+    {
+        buf << "PRAGMA page_size=" << options.pageSize().value();
+        execSQL( db, buf.str() );
+    }
+
+    // in WAL mode readers see the last committed snapshot and never wait on the
+    // writer; NORMAL sync is durable across application crashes in this mode.
+    if ( options.wal() == true )
+    {
+        execSQL( db, "PRAGMA journal_mode=WAL" );
+        execSQL( db, "PRAGMA synchronous=NORMAL" );
+    }
+
+    if ( options.cacheSizeKB().value() > 0 )
+    {
+        // a negative value is a size in KB rather than in pages.
+        buf.str("");
+        buf << "PRAGMA cache_size=-" << options.cacheSizeKB().value();
+        execSQL( db, buf.str() );
+    }
+
+    if ( options.mmapSizeMB().value() > 0 )
+    {
+        // (ignored by sqlite versions without memory-mapped I/O)
+        buf.str("");
+        buf << "PRAGMA mmap_size=" << (sqlite3_int64)options.mmapSizeMB().value() * 1024 * 1024;
+        execSQL( db, buf.str() );
+    }
+
     return db;
 }
 
@@ -421,6 +470,58 @@ struct LayerTable : public osg::Referenced
     }
 
 
+    ~LayerTable()
+    {
+        ScopedLock<Mutex> lock( _statementsMutex );
+        for( StatementsByDb::iterator i = _statements.begin(); i != _statements.end(); ++i )
+        {
+            for( int k=0; k<NUM_STATEMENTS; ++k )
+                if ( i->second._stmt[k] )
+                    sqlite3_finalize( i->second._stmt[k] );
+        }
+    }
+
+    enum StatementType
+    {
+        SELECT_STATEMENT,
+        INSERT_STATEMENT,
+        UPDATE_TIME_POOL_STATEMENT,
+        NUM_STATEMENTS
+    };
+
+    /**
+     * Gets a prepared statement for a connection, preparing it on first use. Each thread
+     * has its own connection, so each thread ends up with its own set of statements.
+     * Call releaseStatement() when finished with it.
+     */
+    sqlite3_stmt* getStatement( sqlite3* db, StatementType type )
+    {
+        ScopedLock<Mutex> lock( _statementsMutex );
+        sqlite3_stmt*& stmt = _statements[db]._stmt[type];
+        if ( !stmt )
+        {
+            const std::string& sql =
+                type == SELECT_STATEMENT ? _selectSQL :
+                type == INSERT_STATEMENT ? _insertSQL :
+                _updateTimePoolSQL;
+
+            int rc = sqlite3_prepare_v2( db, sql.c_str(), sql.length(), &stmt, 0L );
+            if ( rc != SQLITE_OK )
+            {
+                OE_WARN << LC << "Error preparing SQL: " << sqlite3_errmsg( db ) << "(SQL: " << sql << ")" << std::endl;
+                stmt = 0L;
+            }
+        }
+        return stmt;
+    }
+
+    /** Resets a statement from getStatement() so it's ready for the next use. */
+    static void releaseStatement( sqlite3_stmt* stmt )
+    {
+        sqlite3_reset( stmt );
+        sqlite3_clear_bindings( stmt );
+    }
+
     sqlite3_int64 getTableSize(sqlite3* db)
     {
 #ifdef SPLIT_DB_FILE
@@ -494,17 +595,9 @@ struct LayerTable : public osg::Referenced
     {
         displayStats();
 
-        sqlite3_stmt* insert = 0L;
-        int rc = sqlite3_prepare_v2( db, _insertSQL.c_str(), _insertSQL.length(), &insert, 0L );
-        if ( rc != SQLITE_OK )
-        {
-            OE_WARN 
-                << LC << "Error preparing SQL: " 
-                << sqlite3_errmsg( db )
-                << "(SQL: " << _insertSQL << ")"
-                << std::endl;
+        sqlite3_stmt* insert = getStatement( db, INSERT_STATEMENT );
+        if ( !insert )
             return false;
-        }
 
         // bind the key string:
         std::string keyStr = rec._key.str();
@@ -533,20 +626,20 @@ struct LayerTable : public osg::Referenced
 #endif
 
         // write to the database:
-        rc = sqlite3_step( insert );
+        int rc = sqlite3_step( insert );
 
         if ( rc != SQLITE_DONE )
         {
             OE_WARN << LC << "SQL INSERT failed for key " << rec._key.str() << ": " 
                 << sqlite3_errmsg( db ) //<< "; tries=" << (1000-tries)
                 << ", rc = " << rc << std::endl;
-            sqlite3_finalize( insert );
+            releaseStatement( insert );
             return false;
         }
         else
         {
             OE_DEBUG << LC << "cache INSERT tile " << rec._key.str() << std::endl;
-            sqlite3_finalize( insert );
+            releaseStatement( insert );
             _statsStored++;
             return true;
         }
@@ -665,25 +758,21 @@ struct LayerTable : public osg::Referenced
     bool updateAccessTimePool( const std::string&  keyStr, int newTimestamp, sqlite3* db )
     {
         //OE_WARN << LC << "update access times " << _meta._layerName << " " << keyStr << std::endl;
-        sqlite3_stmt* update = 0L;
-        int rc = sqlite3_prepare_v2( db, _updateTimePoolSQL.c_str(), _updateTimePoolSQL.length(), &update, 0L );
-        if ( rc != SQLITE_OK )
-        {
-            OE_WARN << LC << "Failed to prepare SQL " << _updateTimePoolSQL << "; " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_stmt* update = getStatement( db, UPDATE_TIME_POOL_STATEMENT );
+        if ( !update )
             return false;
-        }
 
         bool success = true;
         sqlite3_bind_int( update, 1, newTimestamp );
         sqlite3_bind_text( update, 2, keyStr.c_str(), keyStr.length(), SQLITE_STATIC );
-        rc = sqlite3_step( update );
+        int rc = sqlite3_step( update );
         if ( rc != SQLITE_DONE )
         {
             OE_WARN << LC << "Failed to update timestamp for " << keyStr << " on layer " << _meta._layerName << " rc = " << rc << std::endl;
             success = false;
         }
 
-        sqlite3_finalize( update );
+        releaseStatement( update );
         return success;
     }
 
@@ -692,23 +781,19 @@ struct LayerTable : public osg::Referenced
         displayStats();
         int imageBufLen = 0;
         
-        sqlite3_stmt* select = 0L;
-        int rc = sqlite3_prepare_v2( db, _selectSQL.c_str(), _selectSQL.length(), &select, 0L );
-        if ( rc != SQLITE_OK )
-        {
-            OE_WARN << LC << "Failed to prepare SQL: " << _selectSQL << "; " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_stmt* select = getStatement( db, SELECT_STATEMENT );
+        if ( !select )
             return false;
-        }
 
         std::string keyStr = key.str();
         sqlite3_bind_text( select, 1, keyStr.c_str(), keyStr.length(), SQLITE_STATIC );
 
-        rc = sqlite3_step( select );
+        int rc = sqlite3_step( select );
         if ( rc != SQLITE_ROW ) // == SQLITE_DONE ) // SQLITE_DONE means "no more rows"
         {
             // cache miss
             OE_DEBUG << LC << "Cache MISS on tile " << key.str() << std::endl;
-            sqlite3_finalize(select);
+            releaseStatement( select );
             return false;
         }
 
@@ -740,7 +825,7 @@ struct LayerTable : public osg::Referenced
             OE_DEBUG << LC << "Cache HIT on tile " << key.str() << std::endl;
         }
 
-        sqlite3_finalize(select);
+        releaseStatement( select );
 
         _statsLoaded++;
         return output._image.valid();
@@ -899,6 +984,8 @@ struct LayerTable : public osg::Referenced
 
         if ( !_meta._compressor.empty() )
             _rwOptions = new osgDB::ReaderWriter::Options( "Compressor=" + _meta._compressor );
+        else if ( _meta._format == "osgearth_dxt" )
+            _rwOptions = new osgDB::ReaderWriter::Options( "DXT" );
 
         _statsLastCheck = _statsStartTimer = osg::Timer::instance()->tick();
         return true;
@@ -918,6 +1005,15 @@ struct LayerTable : public osg::Referenced
     osg::ref_ptr<osgDB::ReaderWriter> _rw;
     osg::ref_ptr<osgDB::ReaderWriter::Options> _rwOptions;
 
+    struct Statements
+    {
+        Statements() { for( int i=0; i<NUM_STATEMENTS; ++i ) _stmt[i] = 0L; }
+        sqlite3_stmt* _stmt[NUM_STATEMENTS];
+    };
+    typedef std::map<sqlite3*, Statements> StatementsByDb;
+    StatementsByDb _statements;
+    Mutex          _statementsMutex;
+
     osg::Timer_t _statsStartTimer;
     osg::Timer_t _statsLastCheck;
 
@@ -950,23 +1046,29 @@ struct AsyncPurge : public TaskRequest {
     osg::observer_ptr<Cache> _cache;
 };
 
-struct AsyncInsert : public TaskRequest {
-    AsyncInsert( const TileKey& key, const CacheSpec& spec, const osg::Image* image, AsyncCache* cache )
-        : _cacheSpec(spec), _key(key), _image(image), _cache(cache) { }
-
-    void operator()( ProgressCallback* progress ) {
-        osg::ref_ptr<AsyncCache> cache = _cache.get();
-        if ( cache.valid() )
-            cache->setImageSync( _key, _cacheSpec, _image.get() );
-    }
+/** A tile waiting in the asynchronous write queue. */
+struct PendingWrite : public osg::Referenced {
+    PendingWrite( const TileKey& key, const CacheSpec& spec, const osg::Image* image )
+        : _cacheSpec(spec), _key(key), _image(image) { }
 
     CacheSpec _cacheSpec;
     TileKey _key;
     osg::ref_ptr<const osg::Image> _image;
-    osg::observer_ptr<AsyncCache> _cache;
 };
 
+typedef std::vector< osg::ref_ptr<PendingWrite> > PendingWriteVector;
+
 class Sqlite3Cache;
+
+/** Commits a batch of queued writes in a single transaction. */
+struct AsyncFlushWrites : public TaskRequest
+{
+    AsyncFlushWrites( Sqlite3Cache* cache );
+    void operator()( ProgressCallback* progress );
+
+    osg::observer_ptr<Sqlite3Cache> _cache;
+};
+
 struct AsyncUpdateAccessTime : public TaskRequest
 {
     AsyncUpdateAccessTime( const TileKey& key, const std::string& cacheId, int timeStamp, Sqlite3Cache* cache );
@@ -1010,7 +1112,7 @@ class Sqlite3Cache : public AsyncCache
 {
 public:
     Sqlite3Cache( const CacheOptions& options ) 
-      : AsyncCache(options), _options(options),  _db(0L)
+      : AsyncCache(options), _options(options), _flushScheduled(false), _db(0L)
     {                
         if ( _options.path().get().empty() || options.getReferenceURI().empty() )
             _databasePath = _options.path().get();
@@ -1045,7 +1147,7 @@ public:
         OE_INFO << LC << "Using L2 memory cache" << std::endl;
 #endif
         
-        _db = openDatabase( _databasePath, _options.serialized().value() );
+        _db = openDatabase( _databasePath, _options );
 
         if ( _db )
         {
@@ -1066,8 +1168,8 @@ public:
     }
 
     // just here to satisfy the osg::Object requirements
-    Sqlite3Cache() { }
-    Sqlite3Cache( const Sqlite3Cache& rhs, const osg::CopyOp& op ) { }
+    Sqlite3Cache() : _flushScheduled(false) { }
+    Sqlite3Cache( const Sqlite3Cache& rhs, const osg::CopyOp& op ) : _flushScheduled(false) { }
     META_Object(osgEarth,Sqlite3Cache);
 
 public: // Cache interface
@@ -1116,6 +1218,13 @@ public: // Cache interface
 #ifdef USE_SERIALIZERS
         rec._format = "osgb";
         rec._compressor = "zlib";
+
+        // raw images are stored as-is; serializing them would only add decode work.
+        if ( spec.format() == "osgearth_raw" || spec.format() == "osgearth_dxt" )
+        {
+            rec._format = spec.format();
+            rec._compressor = "";
+        }
 #else
         rec._format = spec.format();
 #endif
@@ -1194,7 +1303,7 @@ public: // Cache interface
 #else
             ScopedLock<Mutex> lock( _pendingWritesMutex );
             std::string name = key.str() + spec.cacheId(); //layerName;
-            std::map<std::string,osg::ref_ptr<AsyncInsert> >::iterator i = _pendingWrites.find(name);
+            std::map<std::string,osg::ref_ptr<PendingWrite> >::iterator i = _pendingWrites.find(name);
             if ( i != _pendingWrites.end() )
             {
                 // todo: update the access time, or let it slide?
@@ -1288,9 +1397,21 @@ public: // Cache interface
             std::string name = key.str() + spec.cacheId();
             if ( _pendingWrites.find(name) == _pendingWrites.end() )
             {
-                AsyncInsert* req = new AsyncInsert(key, spec, image, this);
+                PendingWrite* req = new PendingWrite(key, spec, image);
                 _pendingWrites[name] = req;
-                _writeService->add( req );
+                _writeQueue.push_back( req );
+
+                // writes are committed in batches; schedule a flush if there isn't one
+                // already waiting, and cut its wait short once there's a full batch.
+                if ( !_flushScheduled )
+                {
+                    _flushScheduled = true;
+                    _writeService->add( new AsyncFlushWrites(this) );
+                }
+                if ( _writeQueue.size() >= getWriteBatchSize() )
+                {
+                    _batchFull.set();
+                }
             }
             else
             {
@@ -1436,6 +1557,51 @@ public: // Cache interface
         return true;
     }
 
+    /**
+     * Writes a batch of queued tiles, one transaction per database. Waits up to the
+     * flush interval for a full batch to accumulate first.
+     */
+    void flushWrites()
+    {
+        double interval = _options.writeFlushInterval().value();
+        if ( interval > 0.0 )
+        {
+            bool full;
+            {
+                ScopedLock<Mutex> lock( _pendingWritesMutex );
+                full = _writeQueue.size() >= getWriteBatchSize();
+            }
+
+            if ( full )
+                _batchFull.reset();
+            else
+                _batchFull.waitAndReset( (unsigned long)(interval * 1000.0) );
+        }
+
+        PendingWriteVector batch;
+        {
+            ScopedLock<Mutex> lock( _pendingWritesMutex );
+            unsigned num = osg::minimum( (unsigned)_writeQueue.size(), getWriteBatchSize() );
+            batch.insert( batch.end(), _writeQueue.begin(), _writeQueue.begin() + num );
+            _writeQueue.erase( _writeQueue.begin(), _writeQueue.begin() + num );
+        }
+
+        setImagesSync( batch );
+
+        ScopedLock<Mutex> lock( _pendingWritesMutex );
+        for( PendingWriteVector::const_iterator i = batch.begin(); i != batch.end(); ++i )
+        {
+            _pendingWrites.erase( (*i)->_key.str() + (*i)->_cacheSpec.cacheId() );
+        }
+
+        if ( _writeQueue.size() > 0 )
+            _writeService->add( new AsyncFlushWrites(this) );
+        else
+            _flushScheduled = false;
+
+        displayPendingOperations();
+    }
+
 #ifdef INSERT_POOL
     void setImageSyncPool( AsyncInsertPool* pool, const std::string& layerName)
     {
@@ -1503,6 +1669,56 @@ private:
         }
     }
 
+    // writes a batch of tiles, committing once per database instead of once per tile.
+    void setImagesSync( const PendingWriteVector& batch )
+    {
+        if ( batch.empty() )
+            return;
+
+        if (_options.maxSize().value() > 0 && _nbRequest > MAX_REQUEST_TO_RUN_PURGE) {
+            int t = (int)::time(0L);
+            purge(batch.front()->_cacheSpec.cacheId(), t, _options.asyncWrites().value() );
+            _nbRequest = 0;
+        }
+        _nbRequest += batch.size();
+
+        ::time_t t = ::time(0L);
+        sqlite3* txdb = 0L;
+
+        for( PendingWriteVector::const_iterator i = batch.begin(); i != batch.end(); ++i )
+        {
+            const PendingWrite* write = i->get();
+
+            ThreadTable tt = getTable( write->_cacheSpec.cacheId() );
+            if ( !tt._table )
+                continue;
+
+            if ( tt._db != txdb )
+            {
+                if ( txdb )
+                    execSQL( txdb, "COMMIT" );
+                txdb = execSQL( tt._db, "BEGIN" ) ? tt._db : 0L;
+            }
+
+            ImageRecord rec( write->_key );
+            rec._created = (int)t;
+            rec._accessed = (int)t;
+            rec._image = write->_image.get();
+
+            tt._table->store( rec, tt._db );
+        }
+
+        if ( txdb )
+            execSQL( txdb, "COMMIT" );
+
+        OE_DEBUG << LC << "Committed " << batch.size() << " queued writes" << std::endl;
+    }
+
+    unsigned getWriteBatchSize() const
+    {
+        return osg::maximum( _options.writeBatchSize().value(), 1u );
+    }
+
 
 #ifdef SPLIT_LAYER_DB
     sqlite3* getOrCreateDbForThread(const std::string& layer)
@@ -1516,7 +1732,7 @@ private:
         std::map<Thread*,sqlite3*>::const_iterator k = _dbPerThreadLayers[layer].find(thread);
         if ( k == _dbPerThreadLayers[layer].end() )
         {
-            db = openDatabase( layer + _options.path().value(), _options.serialized().value() );
+            db = openDatabase( layer + _options.path().value(), _options );
             if ( db )
             {
                 _dbPerThreadLayers[layer][thread] = db;
@@ -1547,7 +1763,7 @@ private:
         std::map<Thread*,sqlite3*>::const_iterator k = _dbPerThreadMeta.find(thread);
         if ( k == _dbPerThreadMeta.end() )
         {
-            db = openDatabase( _options.path().value(), _options.serialized().value() );
+            db = openDatabase( _options.path().value(), _options );
             if ( db )
             {
                 _dbPerThreadMeta[thread] = db;
@@ -1578,7 +1794,7 @@ private:
         std::map<Thread*,sqlite3*>::const_iterator k = _dbPerThread.find(thread);
         if ( k == _dbPerThread.end() )
         {
-            db = openDatabase( _databasePath, _options.serialized().value() );
+            db = openDatabase( _databasePath, _options );
             if ( db )
             {
                 _dbPerThread[thread] = db;
@@ -1650,8 +1866,11 @@ private:
 #ifdef INSERT_POOL
     std::map<std::string, osg::ref_ptr<AsyncInsertPool> > _pendingWrites;
 #else
-    std::map<std::string, osg::ref_ptr<AsyncInsert> > _pendingWrites;
+    std::map<std::string, osg::ref_ptr<PendingWrite> > _pendingWrites;
 #endif
+    std::deque< osg::ref_ptr<PendingWrite> > _writeQueue;
+    bool _flushScheduled;
+    Threading::Event _batchFull;
     Mutex _pendingUpdateMutex;
     std::map<std::string, osg::ref_ptr<AsyncUpdateAccessTimePool> > _pendingUpdates;
 
@@ -1735,6 +1954,20 @@ void AsyncUpdateAccessTimePool::operator()( ProgressCallback* progress )
 }
 
 
+AsyncFlushWrites::AsyncFlushWrites( Sqlite3Cache* cache ) :
+_cache(cache)
+{
+    //nop
+}
+
+void AsyncFlushWrites::operator()( ProgressCallback* progress )
+{
+    osg::ref_ptr<Sqlite3Cache> cache = _cache.get();
+    if ( cache.valid() )
+        cache->flushWrites();
+}
+
+
 #ifdef INSERT_POOL
 AsyncInsertPool::AsyncInsertPool(const std::string& layerName, Sqlite3Cache* cache ) : _layerName(layerName), _cache(cache) { }
 void AsyncInsertPool::operator()( ProgressCallback* progress )
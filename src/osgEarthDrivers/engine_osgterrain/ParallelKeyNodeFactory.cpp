@@ -41,46 +41,122 @@ SerialKeyNodeFactory( builder, options, mapInfo, terrain, engineUID )
 osg::Node*
 ParallelKeyNodeFactory::createNode( const TileKey& key )
 {
-    // An event for synchronizing the completion of all requests:
-    Threading::MultiEvent semaphore;
+    // Signaled each time one of the child jobs completes:
+    osg::ref_ptr<TileBuilder::JobMonitor> monitor = new TileBuilder::JobMonitor();
 
-    // Collect all the jobs that can run in parallel (from all 4 subtiles)
+    // Create jobs for all 4 subtiles and start them all in parallel:
     osg::ref_ptr<TileBuilder::Job> jobs[4];
-    unsigned numTasks = 0;
     for( unsigned i=0; i<4; ++i )
     {
-        jobs[i] = _builder->createJob( key.createChildKey(i), semaphore );
-        if ( jobs[i].valid() )
-            numTasks += jobs[i]->_tasks.size();
+        jobs[i] = _builder->createJob( key.createChildKey(i), monitor.get() );
     }
 
-    // Set up the sempahore to block for the correct number of tasks:
-    semaphore.reset( numTasks );
-
-    // Run all the tasks in parallel:
     for( unsigned i=0; i<4; ++i )
-        if ( jobs[i].valid() )
-            _builder->runJob( jobs[i].get() );
+        _builder->runJob( jobs[i].get() );
 
-    // Wait for them to complete:
-    semaphore.wait();
+    // Finalize each subtile as soon as its own tasks complete, instead of waiting for
+    // the slowest one. If a placeholder timeout is set, publish whatever is still
+    // loading at the deadline with stand-in data from the parent tile.
+    osg::ref_ptr<Tile> tiles[4];
+    bool               realData[4];
+    bool               placeholders[4] = { false, false, false, false };
+    bool               lodBlending[4];
+    bool               done[4] = { false, false, false, false };
+    unsigned           numDone = 0;
 
-    // Now postprocess them and assemble into a tile group.
-    osg::Group* root = new osg::Group();
+    float timeout = _options.placeholderTimeout().value();
+    osg::Timer_t start = osg::Timer::instance()->tick();
 
-    for( unsigned i=0; i<4; ++i )
+    while( numDone < 4 )
     {
-        if ( jobs[i].valid() )
+        for( unsigned i=0; i<4; ++i )
+        {
+            if ( !done[i] && jobs[i]->isComplete() )
+            {
+                _builder->finalizeJob( jobs[i].get(), tiles[i], realData[i], lodBlending[i] );
+                done[i] = true;
+                ++numDone;
+            }
+        }
+
+        if ( numDone == 4 )
+            break;
+
+        if ( timeout > 0.0f )
+        {
+            double remaining = (double)timeout - osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+            if ( remaining <= 0.0 )
+            {
+                publishPlaceholders( key, jobs, done, tiles, realData, placeholders, lodBlending );
+                break;
+            }
+            monitor->_event.waitAndReset( (unsigned long)(remaining * 1000.0) + 1 );
+        }
+        else
         {
-            osg::ref_ptr<Tile> tile;
-            bool hasRealData;
-            bool hasLodBlending;
-            _builder->finalizeJob( jobs[i].get(), tile, hasRealData, hasLodBlending );
-            if ( tile.valid() )
-                addTile( tile.get(), hasRealData, hasLodBlending, root );
+            monitor->_event.waitAndReset();
         }
     }
 
+    // Now assemble them into a tile group.
+    osg::Group* root = new osg::Group();
+
+    // A placeholder holds no real data, but its own data is on the way, so it
+    // still gets to subdivide.
+    for( unsigned i=0; i<4; ++i )
+    {
+        if ( tiles[i].valid() )
+            addTile( tiles[i].get(), realData[i] || placeholders[i], lodBlending[i], root );
+    }
+
+    // Only hand the placeholders to their jobs once they're assembled, so that an
+    // update can't race with addTile.
+    for( unsigned i=0; i<4; ++i )
+    {
+        if ( placeholders[i] )
+            jobs[i]->setPlaceholder( tiles[i].get() );
+    }
+
     //TODO: need to check to see if the group is empty, and do something different.
     return root;
 }
+
+void
+ParallelKeyNodeFactory::publishPlaceholders(const TileKey&                  key,
+                                            osg::ref_ptr<TileBuilder::Job>* jobs,
+                                            bool*                           done,
+                                            osg::ref_ptr<Tile>*             tiles,
+                                            bool*                           realData,
+                                            bool*                           placeholders,
+                                            bool*                           lodBlending )
+{
+    osg::ref_ptr<Tile> parentTile;
+    _terrain->getTile( key.getTileId(), parentTile );
+
+    for( unsigned i=0; i<4; ++i )
+    {
+        if ( done[i] )
+            continue;
+
+        // Try to stand in a placeholder. If there's no parent data, finalize the
+        // job normally (waiting if necessary).
+        osg::ref_ptr<Tile> placeholder;
+        if (parentTile.valid() &&
+            _builder->createPlaceholder( jobs[i].get(), parentTile.get(), placeholder, lodBlending[i] ) )
+        {
+            OE_DEBUG << LC << "Published placeholder for " << jobs[i]->_key.str() << std::endl;
+            tiles[i]        = placeholder.get();
+            realData[i]     = false;
+            placeholders[i] = true;
+        }
+        else
+        {
+            while( !jobs[i]->isComplete() )
+                jobs[i]->_monitor->_event.waitAndReset();
+
+            _builder->finalizeJob( jobs[i].get(), tiles[i], realData[i], lodBlending[i] );
+        }
+
+        done[i] = true;
+    }
+}
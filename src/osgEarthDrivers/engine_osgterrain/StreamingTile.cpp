@@ -58,7 +58,7 @@ namespace
         }
 
         //todo: maybe we should pass TaskRequest in as an argument 
-        bool reportProgress(double current, double total)
+        bool reportProgress(double current, double total, const std::string& msg =std::string())
         {
             //Check to see if we were marked cancelled on a previous check
             if (_canceled) return _canceled;
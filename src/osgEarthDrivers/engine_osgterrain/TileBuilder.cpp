@@ -179,6 +179,74 @@ struct AssembleTile
 
 //------------------------------------------------------------------------
 
+/**
+ * A task that belongs to a TileBuilder::Job, and reports back to it when it's done.
+ */
+template<typename T>
+struct JobTask : public TaskRequest, T
+{
+    JobTask( TileBuilder::Job* job ) : _job(job) { }
+
+    void operator()( ProgressCallback* pc )
+    {
+        this->execute();
+        _job->taskDone();
+    }
+
+    // a dropped task contributes no data, but the job must still complete.
+    void abandon()
+    {
+        _job->taskDone();
+    }
+
+    osg::ref_ptr<TileBuilder::Job> _job;
+};
+
+//------------------------------------------------------------------------
+
+void
+TileBuilder::Job::setPlaceholder( Tile* tile )
+{
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        _placeholder = tile;
+        if ( _numPending > 0 )
+            return;
+    }
+
+    // the job finished before the placeholder was published; update it now.
+    _builder->updatePlaceholder( this );
+    _placeholder = 0L;
+}
+
+void
+TileBuilder::Job::taskDone()
+{
+    osg::ref_ptr<JobMonitor> monitor;
+    bool hasPlaceholder;
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        if ( _numPending > 0 && --_numPending > 0 )
+            return;
+        monitor = _monitor.get();
+        hasPlaceholder = _placeholder.valid();
+    }
+
+    // The job was published early; install the real data in its stand-in tile.
+    // (no lock necessary; once _numPending hits zero, setPlaceholder does the update
+    // itself, so only one thread ever gets here with a placeholder)
+    if ( hasPlaceholder )
+    {
+        _builder->updatePlaceholder( this );
+        _placeholder = 0L;
+    }
+
+    if ( monitor.valid() )
+        monitor->_event.set();
+}
+
+//------------------------------------------------------------------------
+
 TileBuilder::TileBuilder(const Map* map, const OSGTerrainOptions& terrainOptions, TaskService* service) :
 _map( map ),
 _terrainOptions( terrainOptions ),
@@ -188,9 +256,10 @@ _service( service )
 }
 
 TileBuilder::Job*
-TileBuilder::createJob( const TileKey& key, Threading::MultiEvent& semaphore )
+TileBuilder::createJob( const TileKey& key, JobMonitor* monitor )
 {
-    Job* job = new Job( key, _map );
+    Job* job = new Job( key, _map, this );
+    job->_monitor = monitor;
 
     // create the image layer tasks:
     for( ImageLayerVector::const_iterator i = job->_mapf.imageLayers().begin(); i != job->_mapf.imageLayers().end(); ++i )
@@ -198,7 +267,7 @@ TileBuilder::createJob( const TileKey& key, Threading::MultiEvent& semaphore )
         ImageLayer* layer = i->get();
         if ( layer->isKeyValid(key) )
         {
-            ParallelTask<BuildColorLayer>* j = new ParallelTask<BuildColorLayer>( &semaphore );
+            JobTask<BuildColorLayer>* j = new JobTask<BuildColorLayer>( job );
             j->init( key, layer, job->_mapf.getMapInfo(), _terrainOptions, job->_repo );
             j->setPriority( -(float)key.getLevelOfDetail() );
             job->_tasks.push_back( j );
@@ -209,27 +278,35 @@ TileBuilder::createJob( const TileKey& key, Threading::MultiEvent& semaphore )
     // empty one while we're waiting for the images to load.
     if ( job->_mapf.elevationLayers().size() > 0 )
     {
-        ParallelTask<BuildElevLayer>* ej = new ParallelTask<BuildElevLayer>( &semaphore );
+        JobTask<BuildElevLayer>* ej = new JobTask<BuildElevLayer>( job );
         ej->init( key, job->_mapf, _terrainOptions, job->_repo );
         ej->setPriority( -(float)key.getLevelOfDetail() );
         job->_tasks.push_back( ej );
     }
 
+    job->_numPending = job->_tasks.size();
+
     return job;
 }
 
 void
 TileBuilder::runJob( TileBuilder::Job* job )
 {
+    // a job with no tasks is already done.
+    if ( job->_tasks.size() == 0 && job->_monitor.valid() )
+        job->_monitor->_event.set();
+
     for( TaskRequestVector::iterator i = job->_tasks.begin(); i != job->_tasks.end(); ++i )
         _service->add( i->get() );
+
+    // the tasks hold a reference to the job; let go of them to break the cycle.
+    job->_tasks.clear();
 }
 
-void
-TileBuilder::finalizeJob(TileBuilder::Job*   job, 
-                         osg::ref_ptr<Tile>& out_tile,
-                         bool&               out_hasRealData,
-                         bool&               out_hasLodBlending)
+bool
+TileBuilder::prepareJob(TileBuilder::Job* job,
+                        bool&             out_hasRealData,
+                        bool&             out_hasLodBlending)
 {
     SourceRepo& repo = job->_repo;
 
@@ -239,7 +316,7 @@ TileBuilder::finalizeJob(TileBuilder::Job*   job,
     // Bail out now if there's no data to be had.
     if ( repo._colorLayers.size() == 0 && !repo._elevLayer.getHFLayer() )
     {
-        return;
+        return false;
     }
 
     const TileKey& key = job->_key;
@@ -278,11 +355,6 @@ TileBuilder::finalizeJob(TileBuilder::Job*   job,
             out_hasLodBlending = true;
     }
 
-    // Ready to create the actual tile.
-    AssembleTile assemble;
-    assemble.init( key, mapInfo, _terrainOptions, repo );
-    assemble.execute();
-
     // Check the results and see if we have any real data.
     for( ColorLayersByUID::const_iterator i = repo._colorLayers.begin(); i != repo._colorLayers.end(); ++i )
     {
@@ -297,9 +369,117 @@ TileBuilder::finalizeJob(TileBuilder::Job*   job,
         out_hasRealData = true;
     }
 
+    return true;
+}
+
+void
+TileBuilder::finalizeJob(TileBuilder::Job*   job, 
+                         osg::ref_ptr<Tile>& out_tile,
+                         bool&               out_hasRealData,
+                         bool&               out_hasLodBlending)
+{
+    if ( !prepareJob(job, out_hasRealData, out_hasLodBlending) )
+        return;
+
+    // Ready to create the actual tile.
+    AssembleTile assemble;
+    assemble.init( job->_key, job->_mapf.getMapInfo(), _terrainOptions, job->_repo );
+    assemble.execute();
+
     out_tile = assemble._tile;
 }
 
+bool
+TileBuilder::createPlaceholder(TileBuilder::Job*   job,
+                               Tile*               parentTile,
+                               osg::ref_ptr<Tile>& out_tile,
+                               bool&               out_hasLodBlending)
+{
+    const TileKey& key = job->_key;
+    const MapInfo& mapInfo = job->_mapf.getMapInfo();
+
+    osg::ref_ptr<osg::HeightField> parentHF;
+    ColorLayersByUID parentColorLayers;
+    {
+        Threading::ScopedReadLock lock( parentTile->getTileLayersMutex() );
+        if ( parentTile->getElevationLayer() )
+            parentHF = parentTile->getElevationLayer()->getHeightField();
+        parentTile->getCustomColorLayers( parentColorLayers, false );
+    }
+
+    if ( !parentHF.valid() )
+        return false;
+
+    SourceRepo repo;
+
+    // the parent's imagery works as-is, since each color layer carries its own locator.
+    for( ColorLayersByUID::const_iterator i = parentColorLayers.begin(); i != parentColorLayers.end(); ++i )
+    {
+        const CustomColorLayer& layer = i->second;
+        repo.add( CustomColorLayer(
+            layer.getMapLayer(),
+            layer.getImage(),
+            layer.getLocator(),
+            key.getLevelOfDetail(),
+            key,
+            true ) );
+    }
+
+    // the elevation is subsampled from the parent.
+    osg::HeightField* hf = HeightFieldUtils::createSubSample(
+        parentHF.get(),
+        parentTile->getKey().getExtent(),
+        key.getExtent(),
+        *_terrainOptions.elevationInterpolation() );
+
+    osgTerrain::HeightFieldLayer* hfLayer = new osgTerrain::HeightFieldLayer( hf );
+    hfLayer->setLocator( GeoLocator::createForKey(key, mapInfo) );
+    repo.set( CustomElevLayer(hfLayer, true) );
+
+    out_hasLodBlending = false;
+    for( ImageLayerVector::const_iterator i = job->_mapf.imageLayers().begin(); i != job->_mapf.imageLayers().end(); ++i )
+    {
+        if ( i->get()->getImageLayerOptions().lodBlending() == true )
+            out_hasLodBlending = true;
+    }
+
+    AssembleTile assemble;
+    assemble.init( key, mapInfo, _terrainOptions, repo );
+    assemble.execute();
+
+    out_tile = assemble._tile;
+    return true;
+}
+
+void
+TileBuilder::updatePlaceholder( TileBuilder::Job* job )
+{
+    bool hasRealData, hasLodBlending;
+    if ( !prepareJob(job, hasRealData, hasLodBlending) )
+    {
+        // nothing better came along; the placeholder stays as it is.
+        return;
+    }
+
+    Tile* tile = job->_placeholder.get();
+    SourceRepo& repo = job->_repo;
+
+    {
+        Threading::ScopedWriteLock lock( tile->getTileLayersMutex() );
+
+        // keep the skirt the placeholder was assembled with.
+        osg::HeightField* hf = repo._elevLayer.getHFLayer()->getHeightField();
+        if ( tile->getElevationLayer() && tile->getElevationLayer()->getHeightField() )
+            hf->setSkirtHeight( tile->getElevationLayer()->getHeightField()->getSkirtHeight() );
+
+        tile->setCustomColorLayers( repo._colorLayers, false );
+        tile->setElevationLayer( repo._elevLayer.getHFLayer() );
+    }
+
+    // rebuild the tile's geometry on its next traversal.
+    tile->setDirty( true );
+}
+
 void
 TileBuilder::createTile(const TileKey&      key, 
                         bool                parallelize, 
@@ -24,15 +24,91 @@
 
 #define OGR_SCOPED_LOCK GDAL_SCOPED_LOCK
 
+#define LC "[FeatureCursorOGR] "
+
 using namespace osgEarth;
 using namespace osgEarth::Features;
 
+namespace
+{
+    /**
+     * Takes the global GDAL lock only if the cursor's data source handle may be shared
+     * with other threads, i.e. when it did not come from a pool.
+     */
+    struct CursorLock
+    {
+        CursorLock( bool shared )
+            : _mutex( shared ? &Registry::instance()->getGDALMutex() : 0L )
+        {
+            if ( _mutex ) _mutex->lock();
+        }
+
+        ~CursorLock()
+        {
+            if ( _mutex ) _mutex->unlock();
+        }
+
+        OpenThreads::ReentrantMutex* _mutex;
+    };
+}
+
+#define OGR_CURSOR_LOCK CursorLock _cursorLock( !_pool.valid() )
+
+//------------------------------------------------------------------------
+
+OGRDataSourcePool::OGRDataSourcePool( const std::string& url ) :
+_url( url )
+{
+    //nop
+}
+
+OGRDataSourcePool::~OGRDataSourcePool()
+{
+    OGR_SCOPED_LOCK;
+
+    for( std::vector<OGRDataSourceH>::iterator i = _free.begin(); i != _free.end(); ++i )
+        OGRReleaseDataSource( *i );
+}
+
+OGRDataSourceH
+OGRDataSourcePool::acquire()
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+        if ( !_free.empty() )
+        {
+            OGRDataSourceH handle = _free.back();
+            _free.pop_back();
+            return handle;
+        }
+    }
+
+    // the driver registry is not thread-safe, so opening still needs the global lock.
+    OGR_SCOPED_LOCK;
+    OGRDataSourceH handle = OGROpen( _url.c_str(), 0, 0L );
+    if ( !handle )
+    {
+        OE_WARN << LC << "Failed to open data source " << _url << std::endl;
+    }
+    return handle;
+}
+
+void
+OGRDataSourcePool::release( OGRDataSourceH handle )
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+    _free.push_back( handle );
+}
+
+//------------------------------------------------------------------------
+
 
 FeatureCursorOGR::FeatureCursorOGR(OGRDataSourceH dsHandle,
                                    OGRLayerH layerHandle,
                                    const FeatureProfile* profile,
                                    const Symbology::Query& query,
-                                   const FeatureFilterList& filters ) :
+                                   const FeatureFilterList& filters,
+                                   OGRDataSourcePool* pool ) :
 _dsHandle( dsHandle ),
 _layerHandle( layerHandle ),
 _resultSetHandle( 0L ),
@@ -41,11 +117,12 @@ _query( query ),
 _chunkSize( 500 ),
 _nextHandleToQueue( 0L ),
 _profile( profile ),
-_filters( filters )
+_filters( filters ),
+_pool( pool )
 {
     //_resultSetHandle = _layerHandle;
     {
-        OGR_SCOPED_LOCK;
+        OGR_CURSOR_LOCK;
 
         std::string expr;
         std::string from = OGR_FD_GetName( OGR_L_GetLayerDefn( _layerHandle ));
@@ -106,7 +183,7 @@ _filters( filters )
 
 FeatureCursorOGR::~FeatureCursorOGR()
 {
-    OGR_SCOPED_LOCK;
+    OGR_CURSOR_LOCK;
 
     if ( _nextHandleToQueue )
         OGR_F_Destroy( _nextHandleToQueue );
@@ -118,7 +195,12 @@ FeatureCursorOGR::~FeatureCursorOGR()
         OGR_G_DestroyGeometry( _spatialFilter );
 
     if ( _dsHandle )
-        OGRReleaseDataSource( _dsHandle );
+    {
+        if ( _pool.valid() )
+            _pool->release( _dsHandle );
+        else
+            OGRReleaseDataSource( _dsHandle );
+    }
 }
 
 bool
@@ -156,7 +238,7 @@ FeatureCursorOGR::readChunk()
     
     FeatureList preProcessList;
     
-    OGR_SCOPED_LOCK;
+    OGR_CURSOR_LOCK;
 
     if ( _nextHandleToQueue )
     {
@@ -30,6 +30,9 @@
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <list>
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <ogr_api.h>
 
 #define LC "[OGR FeatureSource] "
@@ -100,6 +103,26 @@ public:
         }
     }
 
+    //override
+    std::string getContentStamp() const
+    {
+        // inline geometry is part of the options, so it never changes underneath us.
+        if ( _geometry.valid() )
+            return "inline";
+
+        // for a local dataset, its modification time and size. (A shapefile keeps its
+        // attributes alongside, in the .dbf.)
+        std::stringstream buf;
+        if ( _absUrl.empty() || !appendFileStamp(_absUrl, buf) )
+            return "";
+        if ( osgDB::getLowerCaseFileExtension(_absUrl) == "shp" )
+            appendFileStamp( osgDB::getNameLessExtension(_absUrl) + ".dbf", buf );
+
+        std::string stamp;
+        stamp = buf.str();
+        return stamp;
+    }
+
     /** Called once at startup to create the profile for this feature set. Successful profile
         creation implies that the datasource opened succesfully. */
     const FeatureProfile* createFeatureProfile()
@@ -145,6 +168,10 @@ public:
 	        {
                 if (openMode == 1) _writable = true;
 
+                // read-only sources hand out pooled handles to their cursors.
+                if ( !_writable )
+                    _readPool = new OGRDataSourcePool( _absUrl );
+
 		        _layerHandle = OGR_DS_GetLayer( _dsHandle, 0 ); // default to layer 0 for now
                 if ( _layerHandle )
                 {                    
@@ -253,6 +280,29 @@ public:
                 _options.filters() );
                 //getFilters() );
         }
+        else if ( _readPool.valid() )
+        {
+            // Each cursor requires its own DS handle so that multi-threaded access will work.
+            // Read-only sources recycle their handles through a pool; the cursor returns
+            // the handle when it's done.
+            OGRDataSourceH dsHandle = _readPool->acquire();
+            if ( dsHandle )
+            {
+                OGRLayerH layerHandle = OGR_DS_GetLayer( dsHandle, 0 );
+
+                return new FeatureCursorOGR( 
+                    dsHandle,
+                    layerHandle, 
+                    getFeatureProfile(),
+                    query, 
+                    _options.filters(),
+                    _readPool.get() );
+            }
+            else
+            {
+                return 0L;
+            }
+        }
         else
         {
             OGR_SCOPED_LOCK;
@@ -447,6 +497,15 @@ protected:
 
 private:
     std::string _absUrl;
+
+    static bool appendFileStamp( const std::string& path, std::ostream& out )
+    {
+        struct stat st;
+        if ( ::stat(path.c_str(), &st) != 0 )
+            return false;
+        out << (unsigned long long)st.st_mtime << "." << (unsigned long long)st.st_size << ";";
+        return true;
+    }
     OGRDataSourceH _dsHandle;
     OGRLayerH _layerHandle;
     OGRSFDriverH _ogrDriverHandle;
@@ -457,6 +516,7 @@ private:
     bool _writable;
     FeatureSchema _schema;
     Geometry::Type _geometryType;
+    osg::ref_ptr<OGRDataSourcePool> _readPool;
 };
 
 
@@ -29,6 +29,9 @@
 #include <osgDB/WriteFile>
 #include <osgDB/ImageOptions>
 
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
 #include <sstream>
 #include <stdlib.h>
 #include <memory.h>
@@ -614,7 +617,8 @@ public:
       _srcDS(NULL),
       _warpedDS(NULL),
       _options(options),
-      _maxDataLevel(30)
+      _maxDataLevel(30),
+      _warpToPolar(false)
     {
         //nop
     }
@@ -623,12 +627,191 @@ public:
     {
         GDAL_SCOPED_LOCK;
 
-        if (_warpedDS != _srcDS)
+        // once initialize() succeeds, the primary datasets are owned by the handle pool.
+        if ( _handles.empty() )
+        {
+            closeDatasets( _srcDS, _warpedDS );
+        }
+
+        for( DatasetHandleList::iterator i = _handles.begin(); i != _handles.end(); ++i )
         {
-            delete _warpedDS;
+            closeDatasets( (*i)->_srcDS, (*i)->_warpedDS );
+            delete *i;
+        }
+    }
+
+
+    /**
+    * A source dataset and the (possibly warped) view of it that tiles are read from.
+    * A GDALDataset is not thread-safe, so every reading thread checks one of these out
+    * of the pool for the duration of its request.
+    */
+    struct DatasetHandle
+    {
+        DatasetHandle( GDALDataset* srcDS, GDALDataset* warpedDS )
+            : _srcDS(srcDS), _warpedDS(warpedDS) { }
+
+        // A warped VRT reprojects on read, and PROJ is not thread safe.
+        bool isWarped() const { return _warpedDS != _srcDS; }
+
+        GDALDataset* _srcDS;
+        GDALDataset* _warpedDS;
+    };
+    typedef std::vector<DatasetHandle*> DatasetHandleList;
+
+    /**
+    * Checks a dataset handle out of the pool and returns it when it goes out of scope.
+    * Reads from a reprojecting handle call into PROJ, so those hold the global GDAL
+    * lock for as long as the handle is checked out; plain handles read concurrently.
+    */
+    class ScopedDataset
+    {
+    public:
+        ScopedDataset( GDALTileSource* source )
+            : _source(source), _handle(source->acquireDataset()), _gdalMutex(0L)
+        {
+            if ( _handle && _handle->isWarped() )
+            {
+                _gdalMutex = &osgEarth::Registry::instance()->getGDALMutex();
+                _gdalMutex->lock();
+            }
+        }
+
+        ~ScopedDataset() {
+            if ( _gdalMutex )
+                _gdalMutex->unlock();
+            if ( _handle )
+                _source->releaseDataset( _handle );
         }
-        //Close the datasets if it exists
-        if (_srcDS) delete _srcDS;
+
+        bool valid() const { return _handle != 0L; }
+
+        GDALDataset* get() const { return _handle->_warpedDS; }
+
+    private:
+        GDALTileSource*              _source;
+        DatasetHandle*               _handle;
+        OpenThreads::ReentrantMutex* _gdalMutex;
+    };
+
+    static void closeDatasets( GDALDataset* srcDS, GDALDataset* warpedDS )
+    {
+        if ( warpedDS != srcDS )
+            delete warpedDS;
+        if ( srcDS )
+            delete srcDS;
+    }
+
+    /**
+    * Opens the source dataset from the list of files found at initialization time.
+    */
+    GDALDataset* openSourceDataset()
+    {
+        GDAL_SCOPED_LOCK;
+
+        //If we found more than one file, try to combine them into a single logical dataset
+        if (_files.size() > 1)
+        {
+            GDALDataset* ds = (GDALDataset*)build_vrt(_files, HIGHEST_RESOLUTION);
+            if (!ds)
+            {
+                OE_WARN << "[osgEarth::GDAL] Failed to build VRT from input datasets" << std::endl;
+            }
+            return ds;
+        }
+        else
+        {
+            //If we couldn't build a VRT, just try opening the file directly
+            //Open the dataset
+            GDALDataset* ds = (GDALDataset*)GDALOpen( _files[0].c_str(), GA_ReadOnly );
+            if ( !ds )
+            {
+                OE_WARN << LC << "Failed to open dataset " << _files[0] << std::endl;
+            }
+            return ds;
+        }
+    }
+
+    /**
+    * Creates the view of a source dataset that tiles are read from: a warped VRT if
+    * the source must be reprojected into the profile SRS, or else the source itself.
+    */
+    GDALDataset* createWarpedDataset( GDALDataset* srcDS )
+    {
+        if ( _warpDstWKT.empty() )
+            return srcDS;
+
+        GDAL_SCOPED_LOCK;
+
+        if ( _warpToPolar )
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDstWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                NULL);
+        }
+        else
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRT(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDstWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                NULL);
+        }
+    }
+
+    /**
+    * Checks out a dataset handle, opening a new one if all the existing handles are
+    * in use by other threads. Returns NULL if the dataset cannot be opened.
+    */
+    DatasetHandle* acquireDataset()
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _handlesMutex );
+            if ( !_freeHandles.empty() )
+            {
+                DatasetHandle* handle = _freeHandles.back();
+                _freeHandles.pop_back();
+                return handle;
+            }
+            if ( _handles.empty() )
+            {
+                // initialization failed; there's nothing to open.
+                return 0L;
+            }
+        }
+
+        GDALDataset* srcDS = openSourceDataset();
+        if ( !srcDS )
+            return 0L;
+
+        GDALDataset* warpedDS = createWarpedDataset( srcDS );
+        if ( !warpedDS )
+        {
+            GDAL_SCOPED_LOCK;
+            delete srcDS;
+            return 0L;
+        }
+
+        DatasetHandle* handle = new DatasetHandle( srcDS, warpedDS );
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _handlesMutex );
+            _handles.push_back( handle );
+            OE_DEBUG << LC << getName() << ": opened dataset handle " << _handles.size() << std::endl;
+        }
+        return handle;
+    }
+
+    /** Returns a handle checked out with acquireDataset() to the pool. */
+    void releaseDataset( DatasetHandle* handle )
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _handlesMutex );
+        _freeHandles.push_back( handle );
     }
 
 
@@ -668,41 +851,24 @@ public:
         {
             OE_DEBUG << LC << "Using Extension: " << exts[i] << std::endl;
         }
-        std::vector<std::string> files;
-        getFiles(path, exts, files);
+        getFiles(path, exts, _files);
 
-        OE_INFO << LC << "Driver found " << files.size() << " files:" << std::endl;
-        for (unsigned int i = 0; i < files.size(); ++i)
+        OE_INFO << LC << "Driver found " << _files.size() << " files:" << std::endl;
+        for (unsigned int i = 0; i < _files.size(); ++i)
         {
-            OE_INFO << LC << "" << files[i] << std::endl;
+            OE_INFO << LC << "" << _files[i] << std::endl;
         }
 
-        if (files.empty())
+        if (_files.empty())
         {
             OE_WARN << LC << "Could not find any valid files " << std::endl;
             return;
         }
 
-        //If we found more than one file, try to combine them into a single logical dataset
-        if (files.size() > 1)
-        {
-            _srcDS = (GDALDataset*)build_vrt(files, HIGHEST_RESOLUTION);
-            if (!_srcDS)
-            {
-                OE_WARN << "[osgEarth::GDAL] Failed to build VRT from input datasets" << std::endl;
-                return;
-            }
-        }
-        else
+        _srcDS = openSourceDataset();
+        if ( !_srcDS )
         {
-            //If we couldn't build a VRT, just try opening the file directly
-            //Open the dataset
-            _srcDS = (GDALDataset*)GDALOpen( files[0].c_str(), GA_ReadOnly );
-            if ( !_srcDS )
-            {
-                OE_WARN << LC << "Failed to open dataset " << files[0] << std::endl;
-                return;
-            }
+            return;
         }
 
         //Create a spatial reference for the source.
@@ -765,31 +931,22 @@ public:
 
         if ( profile && !profile->getSRS()->isEquivalentTo( src_srs.get() ) )
         {
-            if ( profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar()) )
-            {
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    profile->getSRS()->getWKT().c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    NULL);
-            }
-            else
-            {
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRT(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    profile->getSRS()->getWKT().c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    NULL);
-            }
+            // remember the warp parameters so that pooled handles can re-create the VRT.
+            _warpSrcWKT  = src_srs->getWKT();
+            _warpDstWKT  = profile->getSRS()->getWKT();
+            _warpToPolar = profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar());
+
+            _warpedDS = createWarpedDataset( _srcDS );
 
             if ( _warpedDS )
             {
                 warpedSRSWKT = _warpedDS->GetProjectionRef();
             }
+            else
+            {
+                OE_WARN << LC << "Failed to create warped VRT for " << path << std::endl;
+                return;
+            }
 
             //GDALAutoCreateWarpedVRT(srcDS, src_wkt.c_str(), t_srs.c_str(), GRA_NearestNeighbour, 5.0, NULL);
         }
@@ -909,6 +1066,11 @@ public:
 
 		//Set the profile
 		setProfile( profile );
+
+        // the datasets we opened here become the first handle in the read pool.
+        DatasetHandle* handle = new DatasetHandle( _srcDS, _warpedDS );
+        _handles.push_back( handle );
+        _freeHandles.push_back( handle );
     }
 
 
@@ -917,8 +1079,6 @@ public:
     */
     static GDALRasterBand* findBand(GDALDataset *ds, GDALColorInterp colorInterp)
     {
-        GDAL_SCOPED_LOCK;
-
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetColorInterpretation() == colorInterp) return ds->GetRasterBand(i);
@@ -942,13 +1102,15 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
-
         int tileSize = _options.tileSize().value();
 
         osg::ref_ptr<osg::Image> image;
         if (intersects(key)) //TODO: I think this test is OBE -gw
         {
+            ScopedDataset dataset( this );
+            if ( !dataset.valid() )
+                return NULL;
+
             //Get the extents of the tile
             double xmin, ymin, xmax, ymax;
             key.getExtent().getBounds(xmin, ymin, xmax, ymax);
@@ -1006,14 +1168,14 @@ public:
 
 
 
-            GDALRasterBand* bandRed = findBand(_warpedDS, GCI_RedBand);
-            GDALRasterBand* bandGreen = findBand(_warpedDS, GCI_GreenBand);
-            GDALRasterBand* bandBlue = findBand(_warpedDS, GCI_BlueBand);
-            GDALRasterBand* bandAlpha = findBand(_warpedDS, GCI_AlphaBand);
+            GDALRasterBand* bandRed = findBand(dataset.get(), GCI_RedBand);
+            GDALRasterBand* bandGreen = findBand(dataset.get(), GCI_GreenBand);
+            GDALRasterBand* bandBlue = findBand(dataset.get(), GCI_BlueBand);
+            GDALRasterBand* bandAlpha = findBand(dataset.get(), GCI_AlphaBand);
 
-            GDALRasterBand* bandGray = findBand(_warpedDS, GCI_GrayIndex);
+            GDALRasterBand* bandGray = findBand(dataset.get(), GCI_GrayIndex);
 
-			GDALRasterBand* bandPalette = findBand(_warpedDS, GCI_PaletteIndex);
+			GDALRasterBand* bandPalette = findBand(dataset.get(), GCI_PaletteIndex);
 
             //The pixel format is always RGBA to support transparency
             GLenum pixelFormat = GL_RGBA;
@@ -1233,8 +1395,6 @@ public:
 
     bool isValidValue(float v, GDALRasterBand* band)
     {
-        GDAL_SCOPED_LOCK;
-
         float bandNoData = -32767.0f;
         int success;
         float value = band->GetNoDataValue(&success);
@@ -1243,6 +1403,11 @@ public:
             bandNoData = value;
         }
 
+        return isValidValue(v, bandNoData);
+    }
+
+    bool isValidValue(float v, float bandNoData)
+    {
         //Check to see if the value is equal to the bands specified no data
         if (bandNoData == v) return false;
         //Check to see if the value is equal to the user specified nodata value
@@ -1259,10 +1424,79 @@ public:
         return true;
     }
 
+    /**
+    * A rectangular block of raster values read from a band with a single RasterIO call.
+    * Used to sample a whole heightfield in memory instead of issuing one RasterIO per post.
+    */
+    struct PixelWindow
+    {
+        PixelWindow() : _col(0), _row(0), _width(0), _height(0), _noData(-32767.0f) { }
+
+        float get(int col, int row) const
+        {
+            return _data[(col - _col) + (row - _row) * _width];
+        }
 
-    float getInterpolatedValue(GDALRasterBand *band, double x, double y)
+        int _col, _row, _width, _height;
+        float _noData;
+        std::vector<float> _data;
+    };
+
+    /**
+    * Reads the source pixels needed to sample the given geo extent, plus a one pixel apron
+    * so the interpolation kernels never step outside the window. Returns false if the window
+    * is empty or too large to buffer, in which case the caller should sample per-post.
+    */
+    bool readPixelWindow(GDALRasterBand* band, double xmin, double ymin, double xmax, double ymax, PixelWindow& window)
+    {
+        double c0, r0, c1, r1;
+        GDALApplyGeoTransform(_invtransform, xmin, ymax, &c0, &r0);
+        GDALApplyGeoTransform(_invtransform, xmax, ymin, &c1, &r1);
+
+        //Account for the half pixel offset and the apron
+        int rasterX = _warpedDS->GetRasterXSize();
+        int rasterY = _warpedDS->GetRasterYSize();
+        int colMin = osg::clampBetween( (int)floor(osg::minimum(c0, c1) - 0.5) - 1, 0, rasterX-1 );
+        int colMax = osg::clampBetween( (int)ceil (osg::maximum(c0, c1) - 0.5) + 1, 0, rasterX-1 );
+        int rowMin = osg::clampBetween( (int)floor(osg::minimum(r0, r1) - 0.5) - 1, 0, rasterY-1 );
+        int rowMax = osg::clampBetween( (int)ceil (osg::maximum(r0, r1) - 0.5) + 1, 0, rasterY-1 );
+
+        int width  = colMax - colMin + 1;
+        int height = rowMax - rowMin + 1;
+
+        // At low LODs the window can span the entire dataset. The window is always read
+        // at native resolution (so the samples match the per-post path exactly); past
+        // about a million pixels (4MB) most of it falls between posts, and sampling
+        // per-post reads far less.
+        const int maxWindowPixels = 1024 * 1024;
+        if ( width <= 0 || height <= 0 || width * height > maxWindowPixels )
+            return false;
+
+        window._col    = colMin;
+        window._row    = rowMin;
+        window._width  = width;
+        window._height = height;
+        window._data.resize( width * height );
+
+        int success;
+        float value = band->GetNoDataValue(&success);
+        window._noData = success ? value : -32767.0f;
+
+        if ( band->RasterIO(GF_Read, colMin, rowMin, width, height, &window._data[0], width, height, GDT_Float32, 0, 0) != CE_None )
+        {
+            OE_WARN << LC << "RasterIO failed reading " << width << "x" << height << " window" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+    * Converts a geo coordinate into a (half-pixel adjusted) pixel coordinate, clamping to the
+    * dataset edges. Returns false if the location falls outside the dataset.
+    */
+    bool geoToPixel(double x, double y, double& c, double& r)
     {
-        double r, c;
         GDALApplyGeoTransform(_invtransform, x, y, &c, &r);
 
         //Account for slight rounding errors.  If we are right on the edge of the dataset, clamp to the edge
@@ -1297,16 +1531,44 @@ public:
             r = _warpedDS->GetRasterYSize()-1;
         }
 
-        float result = 0.0f;
-
         //If the location is outside of the pixel values of the dataset, just return 0
         if (c < 0 || r < 0 || c > _warpedDS->GetRasterXSize()-1 || r > _warpedDS->GetRasterYSize()-1)
+            return false;
+
+        return true;
+    }
+
+    /**
+    * Reads a single source pixel, either from the buffered window (if there is one) or
+    * directly from the band.
+    */
+    inline float readPixel(GDALRasterBand* band, const PixelWindow* window, int col, int row)
+    {
+        if ( window )
+            return window->get(col, row);
+
+        float value;
+        band->RasterIO(GF_Read, col, row, 1, 1, &value, 1, 1, GDT_Float32, 0, 0);
+        return value;
+    }
+
+    inline bool isValidPixel(float v, GDALRasterBand* band, const PixelWindow* window)
+    {
+        return window ? isValidValue(v, window->_noData) : isValidValue(v, band);
+    }
+
+    float getInterpolatedValue(GDALRasterBand *band, double x, double y, const PixelWindow* window =0L)
+    {
+        double r, c;
+        if ( !geoToPixel(x, y, c, r) )
             return NO_DATA_VALUE;
 
+        float result = 0.0f;
+
         if ( _options.interpolation() == INTERP_NEAREST )
         {
-            band->RasterIO(GF_Read, (int)osg::round(c), (int)osg::round(r), 1, 1, &result, 1, 1, GDT_Float32, 0, 0);
-            if (!isValidValue( result, band))
+            result = readPixel(band, window, (int)osg::round(c), (int)osg::round(r));
+            if (!isValidPixel(result, band, window))
             {
                 return NO_DATA_VALUE;
             }
@@ -1323,10 +1585,10 @@ public:
 
             float urHeight, llHeight, ulHeight, lrHeight;
 
-            band->RasterIO(GF_Read, colMin, rowMin, 1, 1, &llHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMin, rowMax, 1, 1, &ulHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMax, rowMin, 1, 1, &lrHeight, 1, 1, GDT_Float32, 0, 0);
-            band->RasterIO(GF_Read, colMax, rowMax, 1, 1, &urHeight, 1, 1, GDT_Float32, 0, 0);
+            llHeight = readPixel(band, window, colMin, rowMin);
+            ulHeight = readPixel(band, window, colMin, rowMax);
+            lrHeight = readPixel(band, window, colMax, rowMin);
+            urHeight = readPixel(band, window, colMax, rowMax);
 
             /*
             if (!isValidValue(urHeight, band)) urHeight = 0.0f;
@@ -1334,7 +1596,8 @@ public:
             if (!isValidValue(ulHeight, band)) ulHeight = 0.0f;
             if (!isValidValue(lrHeight, band)) lrHeight = 0.0f;
             */
-            if (!isValidValue(urHeight, band) || (!isValidValue(llHeight, band)) ||(!isValidValue(ulHeight, band)) || (!isValidValue(lrHeight, band)))
+            if (!isValidPixel(urHeight, band, window) || (!isValidPixel(llHeight, band, window)) ||
+                (!isValidPixel(ulHeight, band, window)) || (!isValidPixel(lrHeight, band, window)))
             {
                 return NO_DATA_VALUE;
             }
@@ -1397,8 +1660,6 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
-
         int tileSize = _options.tileSize().value();
 
         //Allocate the heightfield
@@ -1411,8 +1672,18 @@ public:
             double xmin, ymin, xmax, ymax;
             key.getExtent().getBounds(xmin, ymin, xmax, ymax);
 
+            ScopedDataset dataset( this );
+            if ( !dataset.valid() )
+                return NULL;
+
             //Just read from the first band
-            GDALRasterBand* band = _warpedDS->GetRasterBand(1);
+            GDALRasterBand* band = dataset.get()->GetRasterBand(1);
+
+            //Read the entire source window up front if we can, so that sampling happens in memory
+            PixelWindow window;
+            bool useWindow =
+                _options.blockReads() == true &&
+                readPixelWindow(band, xmin, ymin, xmax, ymax, window);
 
             double dx = (xmax - xmin) / (tileSize-1);
             double dy = (ymax - ymin) / (tileSize-1);
@@ -1423,7 +1694,7 @@ public:
                 for (int r = 0; r < tileSize; ++r)
                 {
                     double geoY = ymin + (dy * (double)r);
-                    float h = getInterpolatedValue(band, geoX, geoY);
+                    float h = getInterpolatedValue(band, geoX, geoY, useWindow ? &window : 0L);
                     hf->setHeight(c, r, h);
                 }
             }
@@ -1447,6 +1718,8 @@ public:
 
 private:
 
+    // primary datasets, opened at initialization. These are also the first entry in the
+    // handle pool; use them directly only for immutable properties like the raster size.
     GDALDataset* _srcDS;
     GDALDataset* _warpedDS;
     double       _geotransform[6];
@@ -1464,6 +1737,15 @@ private:
     //osg::ref_ptr<const GDALOptions> _settings;
 
     unsigned int _maxDataLevel;
+
+    std::vector<std::string> _files;
+    std::string              _warpSrcWKT;
+    std::string              _warpDstWKT;
+    bool                     _warpToPolar;
+
+    OpenThreads::Mutex _handlesMutex;
+    DatasetHandleList  _handles;
+    DatasetHandleList  _freeHandles;
 };
 
 
@@ -20,6 +20,8 @@
 #include <osgEarth/ModelSource>
 #include <osgEarth/Registry>
 #include <osgEarth/Map>
+#include <osgEarthSymbology/AltitudeSymbol>
+#include <osgEarthSymbology/TextSymbol>
 
 #include <osg/Notify>
 #include <osg/MatrixTransform>
@@ -54,6 +56,31 @@ namespace
             return node.valid();
         }
 
+        //override
+        bool isThreadSafe() const
+        {
+            // each call gets its own compiler and filters; shared models come
+            // from the session, which locks its model cache.
+            return true;
+        }
+
+        //override
+        bool supportsCaching( const StyleSheet& styles ) const
+        {
+            // text gets cull callbacks, which don't serialize; clamped geometry has the
+            // terrain heights baked in, and would go stale when the elevation changes.
+            for( StyleMap::const_iterator i = styles.styles().begin(); i != styles.styles().end(); ++i )
+            {
+                if ( i->second.getSymbol<TextSymbol>() )
+                    return false;
+
+                const AltitudeSymbol* altitude = i->second.getSymbol<AltitudeSymbol>();
+                if ( altitude && altitude->clamping() != AltitudeSymbol::CLAMP_NONE )
+                    return false;
+            }
+            return true;
+        }
+
     private:
         FeatureGeomModelOptions _options;
     };
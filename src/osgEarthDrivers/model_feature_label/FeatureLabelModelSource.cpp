@@ -105,6 +105,20 @@ namespace
             node = result;
             return true;
         }
+
+        //override
+        bool isThreadSafe() const
+        {
+            // each call builds its own filters and text; nothing is shared.
+            return true;
+        }
+
+        //override
+        bool supportsCaching( const StyleSheet& styles ) const
+        {
+            // the labels' cull callbacks don't serialize.
+            return false;
+        }
     };
 
     //------------------------------------------------------------------------
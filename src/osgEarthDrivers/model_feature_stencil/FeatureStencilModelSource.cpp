@@ -434,7 +434,7 @@ namespace
             for( FeatureList::iterator i = featureList.begin(); i != featureList.end(); ++i )
             {
                 Feature* feature = *i;
-                Geometry* geom = feature->getGeometry();
+                Geometry* geom = feature->getGeometryForWrite();
                 osg::Node* volume = createVolume( geom, -extrusionDistance, extrusionDistance * 2.0, cx );
 
                 if ( volume )
@@ -524,6 +524,20 @@ namespace
             }
         }
 
+        //override
+        bool isThreadSafe() const
+        {
+            // style groups and render bins live in the session's shared build data.
+            return false;
+        }
+
+        //override
+        bool supportsCaching( const StyleSheet& styles ) const
+        {
+            // the volumes go into shared style groups, not into each tile.
+            return false;
+        }
+
         //private
         BuildData* getOrCreateBuildData( Session* session )
         {
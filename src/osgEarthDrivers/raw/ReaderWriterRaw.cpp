@@ -0,0 +1,342 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/Common>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Notify>
+#include <osg/Image>
+#include <osg/Version>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ReaderWriter>
+#include <osgDB/Registry>
+#if OSG_MIN_VERSION_REQUIRED(3,0,0)
+#  include <osgDB/ImageProcessor>
+#  define HAVE_IMAGE_PROCESSOR
+#endif
+#include <cstring>
+#include <fstream>
+
+using namespace osgEarth;
+
+#define LC "[ReaderWriterRaw] "
+
+/**
+ * Image codec that stores an osg::Image exactly as it will be handed to GL: a
+ * small header followed by the pixel data and its mipmap chain. Reading a tile
+ * is a single read into the image's buffer with no decoding, which makes it a
+ * good cache format when tile throughput is bound by PNG/JPEG decoding.
+ *
+ * Writing prepares the image for the GPU:
+ *  - 8-bit images are expanded to RGBA8;
+ *  - a box-filtered mipmap chain is generated if the image doesn't have one;
+ *  - with the "DXT" option (or the "osgearth_dxt" extension), the image is
+ *    compressed to DXT1/DXT5 with mipmaps, if OSG has an image processor
+ *    plugin (e.g. nvtt) to do it;
+ *  - images that are already compressed are stored as-is.
+ * Other images (e.g. the float images that hold elevation data) are stored
+ * untouched.
+ *
+ * The data is stored in the byte order of the machine that wrote it.
+ */
+class ReaderWriterRaw : public osgDB::ReaderWriter
+{
+private:
+    struct Header
+    {
+        char         _magic[8];
+        unsigned int _byteOrder;
+        int          _s, _t, _r;
+        int          _internalFormat;
+        unsigned int _pixelFormat;
+        unsigned int _dataType;
+        unsigned int _packing;
+        unsigned int _origin;
+        unsigned int _numMipmaps;  // number of mipmap offsets that follow the header
+        unsigned int _dataSize;    // bytes of image data, including all mipmap levels
+        unsigned int _reserved;
+    };
+
+    static const char*  magic()     { return "OERAW001"; }
+    static unsigned int byteOrder() { return 0x01020304; }
+
+public:
+    ReaderWriterRaw()
+    {
+        supportsExtension( "osgearth_raw", "osgEarth raw (GPU-ready) image" );
+        supportsExtension( "osgearth_dxt", "osgEarth raw image, DXT compressed" );
+        supportsOption( "DXT", "Compress the image to DXT1/DXT5 when writing" );
+    }
+
+    virtual const char* className()
+    {
+        return "osgEarth Raw Image ReaderWriter";
+    }
+
+    virtual ReadResult readImage( const std::string& fileName, const Options* options ) const
+    {
+        std::string ext = osgDB::getLowerCaseFileExtension( fileName );
+        if ( !acceptsExtension(ext) )
+            return ReadResult::FILE_NOT_HANDLED;
+
+        std::string path = osgDB::findDataFile( fileName, options );
+        if ( path.empty() )
+            return ReadResult::FILE_NOT_FOUND;
+
+        std::ifstream in( path.c_str(), std::ios::in | std::ios::binary );
+        if ( !in.is_open() )
+            return ReadResult::ERROR_IN_READING_FILE;
+
+        return readImage( in, options );
+    }
+
+    virtual ReadResult readImage( std::istream& in, const Options* options ) const
+    {
+        Header h;
+        if ( !in.read((char*)&h, sizeof(h)) ||
+             ::memcmp(h._magic, magic(), sizeof(h._magic)) != 0 ||
+             h._byteOrder != byteOrder() )
+        {
+            return ReadResult::FILE_NOT_HANDLED;
+        }
+
+        // don't trust the header with an allocation until it checks out.
+        if ( !isPlausible(h) )
+            return ReadResult::ERROR_IN_READING_FILE;
+
+        osg::Image::MipmapDataType mipmaps( h._numMipmaps );
+        if ( h._numMipmaps > 0 && !in.read((char*)&mipmaps[0], h._numMipmaps * sizeof(unsigned int)) )
+            return ReadResult::ERROR_IN_READING_FILE;
+
+        if ( !isConsistent(h, mipmaps) )
+            return ReadResult::ERROR_IN_READING_FILE;
+
+        // read straight into the buffer the image will own.
+        unsigned char* data = new unsigned char[h._dataSize];
+        if ( !in.read((char*)data, h._dataSize) )
+        {
+            delete [] data;
+            return ReadResult::ERROR_IN_READING_FILE;
+        }
+
+        osg::Image* image = new osg::Image();
+        image->setImage(
+            h._s, h._t, h._r,
+            h._internalFormat, h._pixelFormat, h._dataType,
+            data, osg::Image::USE_NEW_DELETE, h._packing );
+        image->setOrigin( (osg::Image::Origin)h._origin );
+        if ( h._numMipmaps > 0 )
+            image->setMipmapLevels( mipmaps );
+
+        return image;
+    }
+
+    virtual WriteResult writeImage( const osg::Image& image, const std::string& fileName, const Options* options ) const
+    {
+        std::string ext = osgDB::getLowerCaseFileExtension( fileName );
+        if ( !acceptsExtension(ext) )
+            return WriteResult::FILE_NOT_HANDLED;
+
+        std::ofstream out( fileName.c_str(), std::ios::out | std::ios::binary );
+        if ( !out.is_open() )
+            return WriteResult::ERROR_IN_WRITING_FILE;
+
+        return write( image, out, ext == "osgearth_dxt" || hasOption(options, "DXT") );
+    }
+
+    virtual WriteResult writeImage( const osg::Image& image, std::ostream& out, const Options* options ) const
+    {
+        return write( image, out, hasOption(options, "DXT") );
+    }
+
+private:
+
+    /** Whether a header's dimensions and formats are sane enough to size anything with. */
+    static bool isPlausible( const Header& h )
+    {
+        if ( h._s <= 0 || h._t <= 0 || h._r <= 0 || h._numMipmaps > 32 )
+            return false;
+
+        unsigned int bits = osg::Image::computePixelSizeInBits( h._pixelFormat, h._dataType );
+        if ( bits == 0 )
+            return false;
+
+        // keep the size computations well inside 32 bits.
+        double bytes = (double)h._s * (double)h._t * (double)h._r * (double)bits / 8.0;
+        return bytes < (double)(1u << 30);
+    }
+
+    /**
+     * Whether the data size and mipmap offsets in a header agree with the size OSG
+     * computes for an image with those dimensions and formats.
+     */
+    static bool isConsistent( const Header& h, const osg::Image::MipmapDataType& mipmaps )
+    {
+        for( unsigned int i = 0; i < mipmaps.size(); ++i )
+        {
+            if ( mipmaps[i] >= h._dataSize || (i > 0 && mipmaps[i] <= mipmaps[i-1]) )
+                return false;
+        }
+
+        // an image that describes the data without owning any.
+        osg::ref_ptr<osg::Image> probe = new osg::Image();
+        probe->setImage(
+            h._s, h._t, h._r,
+            h._internalFormat, h._pixelFormat, h._dataType,
+            0L, osg::Image::NO_DELETE, h._packing );
+        if ( !mipmaps.empty() )
+            probe->setMipmapLevels( mipmaps );
+
+        return h._dataSize == probe->getTotalSizeInBytesIncludingMipmaps();
+    }
+
+    static bool hasOption( const Options* options, const std::string& token )
+    {
+        return options && options->getOptionString().find( token ) != std::string::npos;
+    }
+
+    WriteResult write( const osg::Image& input, std::ostream& out, bool compress ) const
+    {
+        osg::ref_ptr<const osg::Image> image = prepare( &input, compress );
+        if ( !image.valid() )
+            return WriteResult::ERROR_IN_WRITING_FILE;
+
+        const osg::Image::MipmapDataType& mipmaps = image->getMipmapLevels();
+
+        Header h;
+        ::memset( &h, 0, sizeof(h) );
+        ::memcpy( h._magic, magic(), sizeof(h._magic) );
+        h._byteOrder      = byteOrder();
+        h._s              = image->s();
+        h._t              = image->t();
+        h._r              = image->r();
+        h._internalFormat = image->getInternalTextureFormat();
+        h._pixelFormat    = image->getPixelFormat();
+        h._dataType       = image->getDataType();
+        h._packing        = image->getPacking();
+        h._origin         = image->getOrigin();
+        h._numMipmaps     = mipmaps.size();
+        h._dataSize       = image->getTotalSizeInBytesIncludingMipmaps();
+
+        out.write( (const char*)&h, sizeof(h) );
+        if ( !mipmaps.empty() )
+            out.write( (const char*)&mipmaps[0], mipmaps.size() * sizeof(unsigned int) );
+        out.write( (const char*)image->data(), h._dataSize );
+
+        return out.fail() ? WriteResult::ERROR_IN_WRITING_FILE : WriteResult::FILE_SAVED;
+    }
+
+    /** Converts an image to the layout we want to hand to GL, if it isn't already. */
+    osg::ref_ptr<const osg::Image> prepare( const osg::Image* input, bool compress ) const
+    {
+        if ( ImageUtils::isCompressed(input) || input->getDataType() != GL_UNSIGNED_BYTE )
+            return input;
+
+        osg::ref_ptr<osg::Image> image;
+        if ( input->getPixelFormat() != GL_RGBA && ImageUtils::canConvert(input, GL_RGBA, GL_UNSIGNED_BYTE) )
+            image = ImageUtils::convertToRGBA8( input );
+        else
+            image = ImageUtils::cloneImage( input );
+
+        if ( !image.valid() )
+            return 0L;
+
+        ImageUtils::normalizeImage( image.get() );
+
+#ifdef HAVE_IMAGE_PROCESSOR
+        if ( compress )
+        {
+            osgDB::ImageProcessor* ip = osgDB::Registry::instance()->getImageProcessor();
+            if ( ip )
+            {
+                osg::Texture::InternalFormatMode mode = ImageUtils::hasAlphaChannel( input ) ?
+                    osg::Texture::USE_S3TC_DXT5_COMPRESSION :
+                    osg::Texture::USE_S3TC_DXT1_COMPRESSION;
+                ip->compress( *image.get(), mode, true, false, osgDB::ImageProcessor::USE_CPU, osgDB::ImageProcessor::NORMAL );
+                return image.get();
+            }
+            OE_INFO << LC << "No image processor plugin available; storing uncompressed" << std::endl;
+        }
+#else
+        if ( compress )
+        {
+            OE_INFO << LC << "DXT compression requires OSG 3.0; storing uncompressed" << std::endl;
+        }
+#endif
+
+        if ( image->getPixelFormat() == GL_RGBA && !image->isMipmap() )
+            buildMipmaps( image.get() );
+
+        return image.get();
+    }
+
+    /** Appends a box-filtered mipmap chain to an RGBA8 image. */
+    static void buildMipmaps( osg::Image* image )
+    {
+        if ( image->r() != 1 || image->getPacking() != 1 )
+            return;
+
+        // compute the size of each level (down to 1x1)
+        osg::Image::MipmapDataType offsets;
+        std::vector<int> widths(1, image->s()), heights(1, image->t());
+        unsigned int total = image->s() * image->t() * 4;
+        while( widths.back() > 1 || heights.back() > 1 )
+        {
+            offsets.push_back( total );
+            widths.push_back( osg::maximum(widths.back()/2, 1) );
+            heights.push_back( osg::maximum(heights.back()/2, 1) );
+            total += widths.back() * heights.back() * 4;
+        }
+        if ( offsets.empty() )
+            return;
+
+        unsigned char* data = new unsigned char[total];
+        ::memcpy( data, image->data(), image->s() * image->t() * 4 );
+
+        for( unsigned int level = 1; level < widths.size(); ++level )
+        {
+            const unsigned char* src = data + (level == 1 ? 0 : offsets[level-2]);
+            unsigned char*       dst = data + offsets[level-1];
+            int sw = widths[level-1], sh = heights[level-1];
+            int dw = widths[level],   dh = heights[level];
+
+            for( int y = 0; y < dh; ++y )
+            {
+                int y0 = osg::minimum( 2*y, sh-1 ), y1 = osg::minimum( 2*y+1, sh-1 );
+                for( int x = 0; x < dw; ++x )
+                {
+                    int x0 = osg::minimum( 2*x, sw-1 ), x1 = osg::minimum( 2*x+1, sw-1 );
+                    const unsigned char* p00 = src + (y0*sw + x0)*4;
+                    const unsigned char* p01 = src + (y0*sw + x1)*4;
+                    const unsigned char* p10 = src + (y1*sw + x0)*4;
+                    const unsigned char* p11 = src + (y1*sw + x1)*4;
+                    for( int c = 0; c < 4; ++c )
+                        *dst++ = (unsigned char)((p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+                }
+            }
+        }
+
+        image->setImage(
+            image->s(), image->t(), 1,
+            image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(),
+            data, osg::Image::USE_NEW_DELETE, 1 );
+        image->setMipmapLevels( offsets );
+    }
+};
+
+REGISTER_OSGPLUGIN(osgearth_raw, ReaderWriterRaw)
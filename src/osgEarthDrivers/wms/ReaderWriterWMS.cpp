@@ -264,27 +264,39 @@ public:
         ProgressCallback*  progress, 
         HTTPResponse&      out_response )
     {
-        osgDB::ReaderWriter* result = 0L;
+        out_response = HTTPClient::get( createURI(key, extraAttrs), 0L, progress ); //getOptions(), progress );
+        return getReader( key, out_response );
+    }
 
-        std::string uri = createURI(key);
-        if ( !extraAttrs.empty() )
+    // start fetching one tile for each time in the WMS-T time list; these all
+    // download concurrently.
+    void fetchTimeSeries(
+        const TileKey&                            key,
+        ProgressCallback*                         progress,
+        std::vector< osg::ref_ptr<HTTPFuture> >&  out_futures )
+    {
+        out_futures.reserve( _timesVec.size() );
+        for( unsigned int r=0; r<_timesVec.size(); ++r )
         {
-            std::string delim = uri.find("?") == std::string::npos ? "?" : "&";
-            uri = uri + delim + extraAttrs;
+            std::string extraAttrs = "TIME=" + _timesVec[r];
+            out_futures.push_back( HTTPClient::getAsync( HTTPRequest(createURI(key, extraAttrs)), 0L, progress ) );
         }
+    }
 
+    // find a reader for a WMS response, reporting any service exceptions.
+    osgDB::ReaderWriter* getReader( const TileKey& key, const HTTPResponse& response )
+    {
+        osgDB::ReaderWriter* result = 0L;
 
-        out_response = HTTPClient::get( uri, 0L, progress ); //getOptions(), progress );
-
-        if ( out_response.isOK() )
+        if ( response.isOK() )
         {
-            const std::string& mt = out_response.getMimeType();
+            const std::string& mt = response.getMimeType();
 
             if ( mt == "application/vnd.ogc.se_xml" || mt == "text/xml" )
             {
                 // an XML result means there was a WMS service exception:
                 Config se;
-                if ( se.loadXML( out_response.getPartStream(0) ) )
+                if ( se.loadXML( response.getPartStream(0) ) )
                 {
                     Config ex = se.child("serviceexceptionreport").child("serviceexception");
                     if ( !ex.empty() ) {
@@ -349,11 +361,13 @@ public:
     {
         osg::ref_ptr<osg::Image> image;
 
+        std::vector< osg::ref_ptr<HTTPFuture> > futures;
+        fetchTimeSeries( key, progress, futures );
+
         for( unsigned int r=0; r<_timesVec.size(); ++r )
         {
-            std::string extraAttrs = "TIME=" + _timesVec[r];
-            HTTPResponse response;
-            osgDB::ReaderWriter* reader = fetchTileAndReader( key, extraAttrs, progress, response );
+            const HTTPResponse& response = futures[r]->getResponse();
+            osgDB::ReaderWriter* reader = getReader( key, response );
             if ( reader )
             {
                 osgDB::ReaderWriter::ReadResult readResult = reader->readImage( response.getPartStream( 0 ), 0L ); //getOptions() );
@@ -419,12 +433,13 @@ public:
         seq->setLength( _options.secondsPerFrame().value() * (double)_timesVec.size() );
         seq->play();
 
+        std::vector< osg::ref_ptr<HTTPFuture> > futures;
+        fetchTimeSeries( key, progress, futures );
+
         for( unsigned int r=0; r<_timesVec.size(); ++r )
         {
-            std::string extraAttrs = "TIME=" + _timesVec[r];
-
-            HTTPResponse response;
-            osgDB::ReaderWriter* reader = fetchTileAndReader( key, extraAttrs, progress, response );
+            const HTTPResponse& response = futures[r]->getResponse();
+            osgDB::ReaderWriter* reader = getReader( key, response );
             if ( reader )
             {
                 osgDB::ReaderWriter::ReadResult readResult = reader->readImage( response.getPartStream( 0 ), 0L ); //getOptions() );
@@ -483,6 +498,17 @@ public:
         return uri;
     }
 
+    std::string createURI( const TileKey& key, const std::string& extraAttrs ) const
+    {
+        std::string uri = createURI(key);
+        if ( !extraAttrs.empty() )
+        {
+            std::string delim = uri.find("?") == std::string::npos ? "?" : "&";
+            uri = uri + delim + extraAttrs;
+        }
+        return uri;
+    }
+
     virtual int getPixelsPerTile() const
     {
         return _options.tileSize().value();
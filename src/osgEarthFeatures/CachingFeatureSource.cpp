@@ -0,0 +1,148 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/CachingFeatureSource>
+#include <osgEarth/Notify>
+
+#define LC "[CachingFeatureSource] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+
+CachingFeatureSource::CachingFeatureSource( FeatureSource* source ) :
+FeatureSource( source->getFeatureSourceOptions() ),
+_source( source )
+{
+    _index = new FeatureSpatialIndex();
+    setName( source->getName() );
+}
+
+void
+CachingFeatureSource::initialize( const std::string& referenceURI )
+{
+    _source->initialize( referenceURI );
+}
+
+const FeatureProfile*
+CachingFeatureSource::createFeatureProfile()
+{
+    return _source->getFeatureProfile();
+}
+
+void
+CachingFeatureSource::syncIndex()
+{
+    {
+        Threading::ScopedReadLock sharedLock( _indexMutex );
+        if ( _source->inSyncWith(_sourceRevision) )
+            return;
+    }
+
+    Threading::ScopedWriteLock exclusiveLock( _indexMutex );
+    if ( _source->outOfSyncWith(_sourceRevision) )
+    {
+        // note the revision first, so a change made during the read isn't lost.
+        _source->sync( _sourceRevision );
+
+        FeatureList features;
+        osg::ref_ptr<FeatureCursor> cursor = _source->createFeatureCursor( Symbology::Query() );
+        if ( cursor.valid() )
+            cursor->fill( features );
+
+        _index->build( features );
+
+        OE_INFO << LC << "Cached " << _index->size() << " features from " << getName() << std::endl;
+    }
+}
+
+FeatureCursor*
+CachingFeatureSource::createFeatureCursor( const Symbology::Query& query )
+{
+    const FeatureProfile* profile = getFeatureProfile();
+    if ( !profile || profile->getTiled() || (query.expression().isSet() && !query.expression()->empty()) )
+    {
+        return _source->createFeatureCursor( query );
+    }
+
+    syncIndex();
+
+    FeatureList features;
+    {
+        Threading::ScopedReadLock sharedLock( _indexMutex );
+        if ( query.bounds().isSet() )
+            _index->query( query.bounds().value(), features );
+        else
+            _index->getAll( features );
+    }
+
+    // hand out shallow copies; their geometry is cloned if someone changes it.
+    FeatureList cursorFeatures;
+    for( FeatureList::iterator i = features.begin(); i != features.end(); ++i )
+    {
+        cursorFeatures.push_back( new Feature( *(i->get()), osg::CopyOp::SHALLOW_COPY ) );
+    }
+    return new FeatureListCursor( cursorFeatures );
+}
+
+Feature*
+CachingFeatureSource::getFeature( FeatureID fid )
+{
+    syncIndex();
+
+    Threading::ScopedReadLock sharedLock( _indexMutex );
+    return _index->get( fid );
+}
+
+bool
+CachingFeatureSource::insertFeature( Feature* feature )
+{
+    syncIndex();
+
+    Threading::ScopedWriteLock exclusiveLock( _indexMutex );
+
+    // only keep the index in step if it was in step with the source before.
+    bool inSync = _source->inSyncWith( _sourceRevision );
+    if ( !_source->insertFeature(feature) )
+        return false;
+
+    if ( inSync )
+    {
+        _index->insert( feature );
+        _source->sync( _sourceRevision );
+    }
+    return true;
+}
+
+bool
+CachingFeatureSource::deleteFeature( FeatureID fid )
+{
+    syncIndex();
+
+    Threading::ScopedWriteLock exclusiveLock( _indexMutex );
+
+    bool inSync = _source->inSyncWith( _sourceRevision );
+    if ( !_source->deleteFeature(fid) )
+        return false;
+
+    if ( inSync )
+    {
+        _index->remove( fid );
+        _source->sync( _sourceRevision );
+    }
+    return true;
+}
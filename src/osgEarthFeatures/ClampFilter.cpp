@@ -58,7 +58,7 @@ ClampFilter::push( FeatureList& features, const FilterContext& cx )
         Feature* feature = i->get();
         double maxZ = -DBL_MAX;
         
-        GeometryIterator gi( feature->getGeometry() );
+        GeometryIterator gi( feature->getGeometryForWrite() );
         while( gi.hasMore() )
         {
             Geometry* geom = gi.next();
@@ -337,7 +337,7 @@ ExtrudeGeometryFilter::extrudeGeometry(const Geometry*         input,
 bool
 ExtrudeGeometryFilter::pushFeature( Feature* input, const FilterContext& context )
 {
-    GeometryIterator iter( input->getGeometry(), false );
+    GeometryIterator iter( input->getGeometryForWrite(), false );
     while( iter.hasMore() )
     {
         Geometry* part = iter.next();
@@ -125,18 +125,37 @@ AttributeValue::getBool( bool defaultValue ) const
 //----------------------------------------------------------------------------
 
 Feature::Feature( FeatureID fid ) :
-_fid( fid )
+_fid( fid ),
+_geomShared( false )
 {
     //NOP
 }
 
 Feature::Feature( const Feature& rhs, const osg::CopyOp& copyOp ) :
 _fid( rhs._fid ),
+_geomShared( false ),
 _attrs( rhs._attrs ),
 _style( rhs._style )
 {
     if ( rhs._geom.valid() )
+    {
         _geom = dynamic_cast<Geometry*>( copyOp( rhs._geom.get() ) );
+
+        // a shallow copy; clone the geometry later if someone wants to change it.
+        _geomShared = _geom.get() == rhs._geom.get();
+    }
+}
+
+Geometry*
+Feature::getGeometryForWrite()
+{
+    if ( _geomShared )
+    {
+        if ( _geom.valid() )
+            _geom = dynamic_cast<Geometry*>( _geom->clone(osg::CopyOp::DEEP_COPY_ALL) );
+        _geomShared = false;
+    }
+    return _geom.get();
 }
 
 FeatureID
@@ -20,6 +20,7 @@
 #include <osgEarthSymbology/Geometry>
 #include <osg/Notify>
 #include <osg/Timer>
+#include <cmath>
 
 #define LC "[FeatureGridder] "
 
@@ -105,7 +106,7 @@ _policy( policy )
 
 #ifndef OSGEARTH_HAVE_GEOS
 
-    if ( _policy.cullingTechnique().isSetTo( GriddingPolicy::CULL_BY_CROPPING ) )
+    if ( _policy.cullingTechnique() == GriddingPolicy::CULL_BY_CROPPING )
     {
         OE_WARN 
             << "Warning: Gridding policy 'cull by cropping' requires GEOS. Falling back on 'cull by centroid'." 
@@ -229,3 +230,168 @@ FeatureGridder::cullFeatureListToCell( int i, FeatureList& features ) const
     return success;
 }
 
+namespace
+{
+    // runs a CellProcessor on one cell; see FeatureGridder::processCells.
+    struct ProcessCell
+    {
+        void init( FeatureGridder::CellProcessor* processor, int cell, const Bounds& bounds, FeatureList* features, char* done )
+        {
+            _processor = processor;
+            _cell      = cell;
+            _bounds    = bounds;
+            _features  = features;
+            _done      = done;
+        }
+
+        void execute()
+        {
+            (*_processor)( _cell, _bounds, *_features );
+            *_done = 1;
+        }
+
+        FeatureGridder::CellProcessor* _processor;
+        int                            _cell;
+        Bounds                         _bounds;
+        FeatureList*                   _features;
+        char*                          _done;
+    };
+}
+
+void
+FeatureGridder::binFeatures( const FeatureList& features, std::vector<FeatureList>& out_cells ) const
+{
+    out_cells.clear();
+    out_cells.resize( getNumCells() );
+
+    // cell dimensions (a disabled policy makes one cell covering the input bounds)
+    double cellWidth  = _policy.enabled() ? *_policy.cellSize() : _inputBounds.width();
+    double cellHeight = _policy.enabled() ? *_policy.cellSize() : _inputBounds.height();
+    if ( cellWidth <= 0.0 )  cellWidth  = 1.0;
+    if ( cellHeight <= 0.0 ) cellHeight = 1.0;
+
+    // cropping needs GEOS; without it, fall back on binning by centroid.
+#ifdef OSGEARTH_HAVE_GEOS
+    bool crop = _policy.cullingTechnique() == GriddingPolicy::CULL_BY_CROPPING;
+#else
+    bool crop = false;
+#endif
+
+    for( FeatureList::const_iterator f_i = features.begin(); f_i != features.end(); ++f_i )
+    {
+        Feature* feature = f_i->get();
+
+        // (const access, so a shared geometry isn't cloned just to read it)
+        const Symbology::Geometry* featureGeom = static_cast<const Feature*>(feature)->getGeometry();
+        if ( !featureGeom )
+            continue;
+
+        Bounds fb = featureGeom->getBounds();
+        if ( !fb.isValid() )
+            continue;
+
+        if ( !crop )
+        {
+            osg::Vec3d centroid = fb.center();
+            if ( !_inputBounds.contains( centroid.x(), centroid.y() ) )
+                continue;
+
+            int x = osg::clampBetween( (int)::floor((centroid.x() - _inputBounds.xMin()) / cellWidth),  0, _cellsX-1 );
+            int y = osg::clampBetween( (int)::floor((centroid.y() - _inputBounds.yMin()) / cellHeight), 0, _cellsY-1 );
+            out_cells[y*_cellsX + x].push_back( feature );
+        }
+
+#ifdef OSGEARTH_HAVE_GEOS
+
+        else // CULL_BY_CROPPING
+        {
+            // range of cells the feature's bounds overlap:
+            if ( fb.xMax() < _inputBounds.xMin() || fb.xMin() > _inputBounds.xMax() ||
+                 fb.yMax() < _inputBounds.yMin() || fb.yMin() > _inputBounds.yMax() )
+                continue;
+
+            int x0 = osg::clampBetween( (int)::floor((fb.xMin() - _inputBounds.xMin()) / cellWidth),  0, _cellsX-1 );
+            int x1 = osg::clampBetween( (int)::floor((fb.xMax() - _inputBounds.xMin()) / cellWidth),  0, _cellsX-1 );
+            int y0 = osg::clampBetween( (int)::floor((fb.yMin() - _inputBounds.yMin()) / cellHeight), 0, _cellsY-1 );
+            int y1 = osg::clampBetween( (int)::floor((fb.yMax() - _inputBounds.yMin()) / cellHeight), 0, _cellsY-1 );
+
+            for( int y = y0; y <= y1; ++y )
+            {
+                for( int x = x0; x <= x1; ++x )
+                {
+                    int i = y*_cellsX + x;
+                    Bounds b;
+                    getCellBounds( i, b );
+
+                    // wholly inside the cell? no need to crop.
+                    if ( b.contains(fb) )
+                    {
+                        out_cells[i].push_back( feature );
+                        continue;
+                    }
+
+                    osg::ref_ptr<Symbology::Polygon> poly = new Symbology::Polygon( 4 );
+                    poly->push_back( osg::Vec3d( b.xMin(), b.yMin(), 0 ));
+                    poly->push_back( osg::Vec3d( b.xMax(), b.yMin(), 0 ));
+                    poly->push_back( osg::Vec3d( b.xMax(), b.yMax(), 0 ));
+                    poly->push_back( osg::Vec3d( b.xMin(), b.yMax(), 0 ));
+
+                    osg::ref_ptr<Symbology::Geometry> croppedGeometry;
+                    if ( featureGeom->crop( poly.get(), croppedGeometry ) )
+                    {
+                        Feature* cellFeature = new Feature( *feature, osg::CopyOp::SHALLOW_COPY );
+                        cellFeature->setGeometry( croppedGeometry.get() );
+                        out_cells[i].push_back( cellFeature );
+                    }
+                }
+            }
+        }
+
+#endif // OSGEARTH_HAVE_GEOS
+
+    }
+}
+
+void
+FeatureGridder::processCells( const FeatureList& features, CellProcessor& processor, TaskService* service ) const
+{
+    std::vector<FeatureList> cells;
+    binFeatures( features, cells );
+
+    std::vector<int> jobs;
+    for( int i = 0; i < (int)cells.size(); ++i )
+    {
+        if ( cells[i].size() > 0 )
+            jobs.push_back( i );
+    }
+
+    // (not vector<bool>; cells finish concurrently)
+    std::vector<char> done( cells.size(), 0 );
+
+    if ( service && jobs.size() > 1 )
+    {
+        Threading::MultiEvent semaphore( jobs.size() );
+
+        for( std::vector<int>::const_iterator i = jobs.begin(); i != jobs.end(); ++i )
+        {
+            Bounds b;
+            getCellBounds( *i, b );
+            ParallelTask<ProcessCell>* task = new ParallelTask<ProcessCell>( &semaphore );
+            task->init( &processor, *i, b, &cells[*i], &done[*i] );
+            service->add( task );
+        }
+
+        semaphore.wait();
+    }
+
+    // process the cells serially if there's no service, or if the service dropped them.
+    for( std::vector<int>::const_iterator i = jobs.begin(); i != jobs.end(); ++i )
+    {
+        if ( !done[*i] )
+        {
+            Bounds b;
+            getCellBounds( *i, b );
+            processor( *i, b, cells[*i] );
+        }
+    }
+}
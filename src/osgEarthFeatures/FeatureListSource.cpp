@@ -18,23 +18,57 @@
  */
 #include <osgEarthFeatures/FeatureListSource>
 
+using namespace osgEarth;
 using namespace osgEarth::Features;
 
 FeatureListSource::FeatureListSource():
 FeatureSource()
 {
     _profile = new FeatureProfile(GeoExtent(osgEarth::SpatialReference::create("epsg:4326"), -180, -90, 180, 90));
+    _index = new FeatureSpatialIndex();
+    sync( _indexRevision );
+}
+
+void
+FeatureListSource::syncIndex()
+{
+    {
+        Threading::ScopedReadLock sharedLock( _indexMutex );
+        if ( inSyncWith(_indexRevision) )
+            return;
+    }
+
+    // someone changed the features and called dirty(); re-read their bounds.
+    Threading::ScopedWriteLock exclusiveLock( _indexMutex );
+    if ( outOfSyncWith(_indexRevision) )
+    {
+        FeatureList features;
+        _index->getAll( features );
+        _index->build( features );
+        sync( _indexRevision );
+    }
 }
 
 FeatureCursor*
 FeatureListSource::createFeatureCursor( const Symbology::Query& query )
 {
-    //Create a copy of all of the features before returning the cursor.
+    syncIndex();
+
+    FeatureList features;
+    {
+        Threading::ScopedReadLock sharedLock( _indexMutex );
+        if ( query.bounds().isSet() )
+            _index->query( query.bounds().value(), features );
+        else
+            _index->getAll( features );
+    }
+
     //The processing filters in osgEarth can modify the features as they are operating and we don't want our original data destroyed.
+    //Shallow copies protect them, since a copy's geometry is cloned the first time someone asks to change it.
     FeatureList cursorFeatures;
-    for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
+    for (FeatureList::iterator itr = features.begin(); itr != features.end(); ++itr)
     {
-        Feature* feature = new osgEarth::Features::Feature(*(itr->get()), osg::CopyOp::DEEP_COPY_ALL);        
+        Feature* feature = new osgEarth::Features::Feature(*(itr->get()), osg::CopyOp::SHALLOW_COPY);
         cursorFeatures.push_back( feature );
     }    
     return new FeatureListCursor( cursorFeatures );
@@ -54,34 +88,50 @@ FeatureListSource::createFeatureProfile()
 bool
 FeatureListSource::deleteFeature(FeatureID fid)
 {
-    for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr) 
+    syncIndex();
+
+    Threading::ScopedWriteLock exclusiveLock( _indexMutex );
+    if ( _index->remove( fid ) )
     {
-        if (itr->get()->getFID() == fid)
-        {
-            _features.erase( itr );
-            dirty();
-            return true;
-        }
+        dirty();
+        sync( _indexRevision );
+        return true;
     }
     return false;
 }
 
+int
+FeatureListSource::getFeatureCount() const
+{
+    Threading::ScopedReadLock sharedLock( _indexMutex );
+    return _index->size();
+}
+
 Feature*
 FeatureListSource::getFeature( FeatureID fid )
 {
-    for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr) 
-    {
-        if (itr->get()->getFID() == fid)
-        {
-            return itr->get();
-        }
-    }
-    return NULL;
+    Threading::ScopedReadLock sharedLock( _indexMutex );
+    return _index->get( fid );
 }
 
-bool FeatureListSource::insertFeature(Feature* feature)
+bool
+FeatureListSource::insertFeature(Feature* feature)
 {
-    _features.push_back( feature );
+    if ( !feature )
+        return false;
+
+    syncIndex();
+
+    Threading::ScopedWriteLock exclusiveLock( _indexMutex );
+    _index->insert( feature );
     dirty();
+    sync( _indexRevision );
     return true;
 }
+
+void
+FeatureListSource::getFeatures( FeatureList& out_features ) const
+{
+    Threading::ScopedReadLock sharedLock( _indexMutex );
+    _index->getAll( out_features );
+}
@@ -19,16 +19,31 @@
 
 #include <osgEarthFeatures/FeatureModelGraph>
 #include <osgEarthFeatures/CropFilter>
+#include <osgEarthFeatures/FeatureGridder>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/NodeUtils>
+#include <osgEarth/StringUtils>
 #include <osg/PagedLOD>
+#include <osg/Timer>
+#include <osg/Version>
 #include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ReadFile>
 #include <osgDB/ReaderWriter>
 #include <osgDB/WriteFile>
+#include <iomanip>
+#include <stdio.h>
 #include <osgUtil/Optimizer>
 
 #define LC "[FeatureModelGraph] "
 
+// format of the files in the tile cache
+#if OSG_MIN_VERSION_REQUIRED(3,0,0)
+#  define TILE_CACHE_EXTENSION "osgb"
+#else
+#  define TILE_CACHE_EXTENSION "ive"
+#endif
+
 using namespace osgEarth;
 using namespace osgEarth::Features;
 using namespace osgEarth::Symbology;
@@ -124,8 +139,172 @@ namespace
             fullExtent.xMin() + w * (double)(tileX+1),
             fullExtent.yMin() + h * (double)(tileY+1) );
     }
+
+    // compiles the features in one grid cell into a node.
+    struct CompileGridCell : public FeatureGridder::CellProcessor
+    {
+        CompileGridCell( FeatureNodeFactory* factory, const Style& style, const FilterContext& context, int numCells, ProgressCallback* progress ) :
+            _factory ( factory ),
+            _style   ( style ),
+            _context ( context ),
+            _progress( progress ),
+            _nodes   ( numCells ),
+            _ok      ( numCells, 0 ) { }
+
+        void operator()( int cell, const Bounds& cellBounds, FeatureList& cellFeatures )
+        {
+            if ( _progress && _progress->reportProgress(0, 0) )
+                return;
+
+            FilterContext cellContext( _context );
+            cellContext.extent() = GeoExtent( _context.profile()->getSRS(), cellBounds );
+
+            osg::ref_ptr<FeatureCursor> cursor = new FeatureListCursor( cellFeatures );
+            _ok[cell] = _factory->createOrUpdateNode( cursor.get(), _style, cellContext, _nodes[cell] ) ? 1 : 0;
+        }
+
+        FeatureNodeFactory*                    _factory;
+        const Style&                           _style;
+        const FilterContext&                   _context;
+        ProgressCallback*                      _progress;
+        std::vector< osg::ref_ptr<osg::Node> > _nodes;
+        std::vector<char>                      _ok;     // (not vector<bool>; cells are written concurrently)
+    };
+
+    // number of frames a pending tile can go unseen before its build is canceled.
+    const unsigned s_maxIdleFrames = 10;
+
+    // how often (in frames) to drop the records of tiles that are no longer culled.
+    const unsigned s_pruneInterval = 300;
 }
 
+//---------------------------------------------------------------------------
+
+/**
+ * Tracks which paged tiles are still wanted. This is the cull callback on each
+ * tile's PagedLOD: whenever a PagedLOD that hasn't loaded its tile yet is culled
+ * within range, it records the frame number against the tile's URI. A tile that
+ * hasn't been seen for a few frames has fallen out of view, and there's no point
+ * in finishing its build. So has a tile we have no record of: the PagedLOD records
+ * its tile before it requests it, so the record was pruned or the tile already loaded.
+ */
+class FeatureModelGraph::TileActivity : public osg::NodeCallback
+{
+public:
+    TileActivity() : _tracking( false ), _frame( 0 ), _lastPrune( 0 ) { }
+
+    void operator()( osg::Node* node, osg::NodeVisitor* nv )
+    {
+        osg::PagedLOD* plod = static_cast<osg::PagedLOD*>( node );
+        if ( plod->getNumChildren() == 0 && plod->getNumFileNames() > 0 && nv->getFrameStamp() )
+        {
+            float range = nv->getDistanceToViewPoint( plod->getCenter(), true );
+            if ( range >= plod->getMinRange(0) && range < plod->getMaxRange(0) )
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+                _lastSeen[plod->getFileName(0)] = nv->getFrameStamp()->getFrameNumber();
+            }
+        }
+        traverse( node, nv );
+    }
+
+    /** Called once per cull with the current frame number (by every cull thread). */
+    void setFrame( unsigned frame )
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+
+        _tracking = true;
+        if ( frame > _frame )
+            _frame = frame;
+
+        // (measure against the newest frame; cull threads can run a frame apart.)
+        if ( _frame - _lastPrune > s_pruneInterval )
+        {
+            for( std::map<std::string,unsigned>::iterator i = _lastSeen.begin(); i != _lastSeen.end(); )
+            {
+                if ( _frame - i->second > s_pruneInterval )
+                    _lastSeen.erase( i++ );
+                else
+                    ++i;
+            }
+            _lastPrune = _frame;
+        }
+    }
+
+    /**
+     * Whether the tile was seen recently. Until there's a cull traversal to watch (e.g. when
+     * tiles are read outside of a viewer), every tile is assumed to be wanted.
+     */
+    bool isActive( const std::string& uri ) const
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+        if ( !_tracking )
+            return true;
+        std::map<std::string,unsigned>::const_iterator i = _lastSeen.find( uri );
+        return i != _lastSeen.end() && _frame - i->second <= s_maxIdleFrames;
+    }
+
+    /** Forgets a tile once it's been loaded. */
+    void remove( const std::string& uri )
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _mutex );
+        _lastSeen.erase( uri );
+    }
+
+private:
+    bool                            _tracking;
+    unsigned                        _frame;
+    unsigned                        _lastPrune;
+    std::map<std::string,unsigned>  _lastSeen;
+    mutable OpenThreads::Mutex      _mutex;
+};
+
+/**
+ * Progress callback for the build of one paged tile; it cancels the build once
+ * the tile falls out of view.
+ */
+class FeatureModelGraph::TileProgress : public ProgressCallback
+{
+public:
+    TileProgress( const TileActivity* activity, const std::string& uri ) :
+        _activity( activity ),
+        _uri     ( uri ) { }
+
+    bool reportProgress( double current, double total, const std::string& msg )
+    {
+        if ( !isCanceled() && !_activity->isActive(_uri) )
+            cancel();
+        return isCanceled();
+    }
+
+private:
+    osg::ref_ptr<const TileActivity> _activity;
+    std::string                      _uri;
+};
+
+/**
+ * Compiles one style job; see FeatureModelGraph::compileStyles.
+ */
+struct FeatureModelGraph::CompileStyle
+{
+    void init( FeatureModelGraph* graph, StyleJob* job, ProgressCallback* progress )
+    {
+        _graph    = graph;
+        _job      = job;
+        _progress = progress;
+    }
+
+    void execute()
+    {
+        // the workers are all busy with styles, so compile the grid cells serially.
+        _job->_result = _graph->createNodeForStyle( _job->_style, _job->_query, 0L, _progress );
+        _job->_done   = true;
+    }
+
+    FeatureModelGraph* _graph;
+    StyleJob*          _job;
+    ProgressCallback*  _progress;
+};
 
 //---------------------------------------------------------------------------
 
@@ -167,6 +346,65 @@ _session( session )
     if ( _useTiledSource && options.levels().isSet() && options.levels()->getNumLevels() > 0 )
         _useTiledSource = false;
 
+    // styles and grid cells compile in parallel, if the factory supports it.
+    int numCompileThreads = _options.numCompileThreads().value();
+
+    if ( numCompileThreads > 0 && _factory->isThreadSafe() )
+    {
+        _compileService = new TaskService( "FeatureModelGraph compiler", numCompileThreads );
+    }
+
+    _tileActivity = new TileActivity();
+
+    // set up the tile cache, if there is one.
+    if ( _options.tileCachePath().isSet() && !_options.tileCachePath()->empty() )
+    {
+        std::string stamp = _source->getContentStamp();
+
+        if ( _source->hasEmbeddedStyles() || !_factory->supportsCaching(_styles) )
+        {
+            OE_WARN << LC << "Feature tile caching is not supported for this driver or these styles; the tile cache is disabled" << std::endl;
+        }
+        else if ( !_options.featureOptions().isSet() )
+        {
+            OE_WARN << LC << "Feature source has no configuration to key the tile cache on; the tile cache is disabled" << std::endl;
+        }
+        else if ( stamp.empty() )
+        {
+            OE_WARN << LC << "Feature source can't tell when its data changes; the tile cache is disabled" << std::endl;
+        }
+        else
+        {
+            // key the cache on the layer configuration (less the settings that don't
+            // affect the output), the styles, the source data, and the map the geometry
+            // is compiled for (its profile decides the output SRS and localization).
+            Config layerConf = _options.getConfig();
+            layerConf.remove( "styles" );
+            layerConf.remove( "compile_threads" );
+            layerConf.remove( "tile_cache_path" );
+
+            const MapInfo& mapInfo = session->getMapInfo();
+            std::string mapKey =
+                mapProfile->toString() + mapProfile->getSRS()->getWKT() +
+                (mapInfo.isGeocentric() ? "geocentric" : "projected");
+
+            std::stringstream buf;
+            buf << std::fixed << std::setfill('0') << std::hex
+                << osgEarth::hashString( mapKey ) << "/"
+                << osgEarth::hashString( layerConf.toHashString() ) << "/"
+                << osgEarth::hashString( _styles.getConfig().toHashString() ) << "/"
+                << osgEarth::hashString( stamp );
+
+            _cachePath = osgDB::concatPaths( *_options.tileCachePath(), buf.str() );
+
+            // edits made in this process don't show up in the stamp until they're saved,
+            // so stop caching as soon as the source changes.
+            _source->sync( _cacheRevision );
+
+            OE_INFO << LC << "Caching feature tiles in " << _cachePath << std::endl;
+        }
+    }
+
     redraw();
 }
 
@@ -204,6 +442,75 @@ FeatureModelGraph::getBoundInWorldCoords( const GeoExtent& extent ) const
     return osg::BoundingSphered( center, (center-corner).length() );
 }
 
+std::string
+FeatureModelGraph::getCacheFileName( unsigned levelIndex, unsigned tileX, unsigned tileY ) const
+{
+    // don't cache anything once the source has changed in this process (an
+    // always-dirty source never syncs).
+    if ( _cachePath.empty() || _source->outOfSyncWith(_cacheRevision) )
+        return "";
+
+    std::stringstream buf;
+    buf << _cachePath << "/" << levelIndex << "/" << tileX << "/" << tileY
+        << "." << TILE_CACHE_EXTENSION;
+    std::string bufStr;
+    bufStr = buf.str();
+    return bufStr;
+}
+
+bool
+FeatureModelGraph::readTileFromCache( const std::string& fileName, osg::ref_ptr<osg::Group>& out_group ) const
+{
+    if ( !osgDB::fileExists(fileName) )
+        return false;
+
+    osg::ref_ptr<osg::Node> node = osgDB::readNodeFile( fileName );
+    if ( !node.valid() || !node->asGroup() )
+    {
+        // corrupt or unreadable; rebuild the tile and overwrite it.
+        OE_INFO << LC << "Failed to read cached tile " << fileName << std::endl;
+        return false;
+    }
+
+    out_group = node->asGroup();
+    return true;
+}
+
+void
+FeatureModelGraph::writeTileToCache( const std::string& fileName, const osg::Group* group ) const
+{
+    if ( !osgDB::makeDirectoryForFile(fileName) )
+    {
+        OE_WARN << LC << "Failed to create a directory for " << fileName << std::endl;
+        return;
+    }
+
+    // embed textures (e.g. from substituted models) so the tile is self-contained.
+    osg::ref_ptr<osgDB::ReaderWriter::Options> options = new osgDB::ReaderWriter::Options( "WriteImageHint=IncludeData" );
+
+    // write to a temporary file (keeping the extension, which selects the plugin) and
+    // move it into place, so that a reader never sees a partial tile.
+    std::stringstream buf;
+    buf << osgDB::getNameLessExtension(fileName) << "." << std::hex << osg::Timer::instance()->tick()
+        << "." << osgDB::getFileExtension(fileName);
+    std::string tempName;
+    tempName = buf.str();
+
+    if ( !osgDB::writeNodeFile(*group, tempName, options.get()) )
+    {
+        OE_WARN << LC << "Failed to write cached tile " << fileName << std::endl;
+        ::remove( tempName.c_str() );
+        return;
+    }
+
+    if ( ::rename(tempName.c_str(), fileName.c_str()) != 0 )
+    {
+        // (Windows won't rename over an existing file; if one's there, another
+        // writer got there first, and its tile is just as good.)
+        ::remove( tempName.c_str() );
+    }
+}
+
 void
 FeatureModelGraph::setupPaging()
 {
@@ -303,6 +610,7 @@ FeatureModelGraph::buildSubTiles(unsigned            nextLevelIndex,
                 plod->setRadius  ( subtile_bs.radius() );
                 plod->setFileName( 0, uri );
                 plod->setRange   ( 0, 0, nextLevel->maxRange() );
+                plod->setCullCallback( _tileActivity.get() );
 
                 // don't fiddle with the priority here - we have closest-to-camera first.
                 //plod->setPriorityOffset( 0, -(float)nextLOD );
@@ -327,6 +635,17 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
     OE_DEBUG << LC
         << "load: " << levelIndex << "_" << tileX << "_" << tileY << std::endl;
 
+    // don't bother if the tile fell out of view while the request was queued.
+    osg::ref_ptr<ProgressCallback> progress = new TileProgress( _tileActivity.get(), uri );
+    if ( progress->reportProgress(0, 0) )
+    {
+        OE_DEBUG << LC << "Canceled: " << uri << std::endl;
+        return 0L;
+    }
+
+    // where to cache the tile's geometry, if anywhere.
+    std::string cacheFileName = getCacheFileName( levelIndex, tileX, tileY );
+
     osg::Group* result = 0L;
     
     if ( _useTiledSource )
@@ -346,7 +665,7 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
         FeatureLevel level( 0, maxRange );
         
         TileKey key(lod, tileX, tileY, _source->getFeatureProfile()->getProfile());
-        osg::Group* geometry = build( level, tileExtent, &key );
+        osg::Group* geometry = build( level, tileExtent, &key, progress.get(), cacheFileName );
         result = geometry;
 
         if (lod < _source->getFeatureProfile()->getMaxLevel())
@@ -376,7 +695,7 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
     {
         // no levels defined; just load all the features.
         FeatureLevel all( 0.0f, FLT_MAX );
-        result = build( all, GeoExtent::INVALID, 0 );
+        result = build( all, GeoExtent::INVALID, 0, progress.get(), cacheFileName );
     }
 
     else
@@ -396,7 +715,7 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
                 s_getTileExtent( lod, tileX, tileY, _usableFeatureExtent ) :
                 GeoExtent::INVALID;
 
-            osg::Group* geometry = build( *level, tileExtent, 0 );
+            osg::Group* geometry = build( *level, tileExtent, 0, progress.get(), cacheFileName );
             result = geometry;
 
             // see if there are any more levels. If so, build some pagedlods to bring the
@@ -422,6 +741,17 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
         }
     }
 
+    _tileActivity->remove( uri );
+
+    // If the tile fell out of view during the build, discard it without blacklisting
+    // the URI; the PagedLOD will request it again when it comes back into view.
+    if ( progress->isCanceled() )
+    {
+        OE_DEBUG << LC << "Canceled: " << uri << std::endl;
+        osg::ref_ptr<osg::Node> discard = result; // (releases the partial result)
+        return 0L;
+    }
+
     // If the read resulting in nothing, do two things. First, blacklist the URI
     // so that the next time we try to create a PagedLOD pointing at this URI, it
     // will find it in the blacklist and not create said PagedLOD. Second, create
@@ -448,47 +778,26 @@ FeatureModelGraph::load( unsigned levelIndex, unsigned tileX, unsigned tileY, co
 }
 
 osg::Group*
-FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, const TileKey* key )
+FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, const TileKey* key,
+                          ProgressCallback* progress, const std::string& cacheFileName )
 {
-    osg::ref_ptr<osg::Group> group = new osg::Group();
-
-    // form the baseline query, which does a spatial query based on the working extent.
-    Query query;
-    if ( extent.isValid() )
-        query.bounds() = extent.bounds();
+    osg::ref_ptr<osg::Group> group;
 
-    // add a tile key to the query if there is one, to support TFS-style queries
-    if ( key )
-        query.tileKey() = *key;
-
-    // now, go through any level-based selectors.
-    const StyleSelectorVector& levelSelectors = level.selectors();
-    
-    // if there are none, just build once with the default style and query.
-    if ( levelSelectors.size() == 0 )
+    // a cached tile skips the query and compile altogether.
+    if ( !cacheFileName.empty() && readTileFromCache(cacheFileName, group) )
     {
-        osg::Node* node = build( Style(), query, extent );
-        if ( node )
-            group->addChild( node );
+        OE_DEBUG << LC << "Read tile from cache: " << cacheFileName << std::endl;
     }
-
     else
     {
-        for( StyleSelectorVector::const_iterator i = levelSelectors.begin(); i != levelSelectors.end(); ++i )
-        {
-            const StyleSelector& selector = *i;
-
-            // fetch the selector's style:
-            Style selectorStyle;
-            _styles.getStyle( selector.getSelectedStyleName(), selectorStyle );
+        group = new osg::Group();
+        compile( level, extent, key, progress, group.get() );
 
-            // combine the selector's query, if it has one:
-            Query selectorQuery = 
-                selector.query().isSet() ? query.combineWith( *selector.query() ) : query;
-
-            osg::Node* node = build( selectorStyle, selectorQuery, extent );
-            if ( node )
-                group->addChild( node );
+        // Empty tiles aren't cached, since a failed query looks the same as an
+        // empty one; the blacklist keeps us from querying them again this session.
+        if ( !cacheFileName.empty() && group->getNumChildren() > 0 && !(progress && progress->isCanceled()) )
+        {
+            writeTileToCache( cacheFileName, group.get() );
         }
     }
 
@@ -533,11 +842,63 @@ FeatureModelGraph::build( const FeatureLevel& level, const GeoExtent& extent, co
     }
 }
 
-osg::Group*
-FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const GeoExtent& workingExtent )
+void
+FeatureModelGraph::compile( const FeatureLevel& level, const GeoExtent& extent, const TileKey* key,
+                            ProgressCallback* progress, osg::Group* group )
 {
-    osg::ref_ptr<osg::Group> group = new osg::Group();
+    // form the baseline query, which does a spatial query based on the working extent.
+    Query query;
+    if ( extent.isValid() )
+        query.bounds() = extent.bounds();
 
+    // add a tile key to the query if there is one, to support TFS-style queries
+    if ( key )
+        query.tileKey() = *key;
+
+    // collect the styles to compile for this tile.
+    StyleJobList jobs;
+
+    // now, go through any level-based selectors.
+    const StyleSelectorVector& levelSelectors = level.selectors();
+    
+    // if there are none, just build once with the default style and query.
+    if ( levelSelectors.size() == 0 )
+    {
+        build( Style(), query, extent, group, jobs );
+    }
+
+    else
+    {
+        for( StyleSelectorVector::const_iterator i = levelSelectors.begin(); i != levelSelectors.end(); ++i )
+        {
+            const StyleSelector& selector = *i;
+
+            // fetch the selector's style:
+            Style selectorStyle;
+            _styles.getStyle( selector.getSelectedStyleName(), selectorStyle );
+
+            // combine the selector's query, if it has one:
+            Query selectorQuery = 
+                selector.query().isSet() ? query.combineWith( *selector.query() ) : query;
+
+            build( selectorStyle, selectorQuery, extent, group, jobs );
+        }
+    }
+
+    // compile the styles (concurrently if possible) and merge the results.
+    compileStyles( jobs, progress );
+
+    for( StyleJobList::const_iterator i = jobs.begin(); i != jobs.end(); ++i )
+    {
+        if ( i->_result.valid() && !group->containsNode(i->_result.get()) )
+            group->addChild( i->_result.get() );
+    }
+}
+
+void
+FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const GeoExtent& workingExtent,
+                          osg::Group* group, StyleJobList& jobs )
+{
     if ( _source->hasEmbeddedStyles() )
     {
         const FeatureProfile* profile = _source->getFeatureProfile();
@@ -589,10 +950,8 @@ FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const
                 // .. and merge it's query into the existing query
                 Query combinedQuery = baseQuery.combineWith( *sel.query() );
 
-                // then create the node.
-                osg::Group* styleGroup = createNodeForStyle( combinedStyle, combinedQuery );
-                if ( styleGroup && !group->containsNode(styleGroup) )
-                    group->addChild( styleGroup );
+                // then queue it up for compilation.
+                jobs.push_back( StyleJob(combinedStyle, combinedQuery) );
             }
         }
 
@@ -605,20 +964,49 @@ FeatureModelGraph::build( const Style& baseStyle, const Query& baseQuery, const
             if ( baseStyle.empty() )
                 _styles.getDefaultStyle( combinedStyle );
 
-            osg::Group* styleGroup = createNodeForStyle( combinedStyle, baseQuery );
-            if ( styleGroup && !group->containsNode(styleGroup) )
-                group->addChild( styleGroup );
+            jobs.push_back( StyleJob(combinedStyle, baseQuery) );
         }
     }
+}
 
-    return group->getNumChildren() > 0 ? group.release() : 0L;
+void
+FeatureModelGraph::compileStyles( StyleJobList& jobs, ProgressCallback* progress )
+{
+    if ( _compileService.valid() && jobs.size() > 1 )
+    {
+        // run each style's query and filter chain on its own worker.
+        Threading::MultiEvent semaphore( jobs.size() );
+
+        for( StyleJobList::iterator i = jobs.begin(); i != jobs.end(); ++i )
+        {
+            ParallelTask<CompileStyle>* task = new ParallelTask<CompileStyle>( &semaphore );
+            task->init( this, &(*i), progress );
+            _compileService->add( task );
+        }
+
+        semaphore.wait();
+    }
+
+    // a single style can spread its grid cells across the workers instead. (This
+    // also picks up any styles that the service dropped without compiling.)
+    for( StyleJobList::iterator i = jobs.begin(); i != jobs.end(); ++i )
+    {
+        if ( !i->_done )
+        {
+            i->_result = createNodeForStyle( i->_style, i->_query, _compileService.get(), progress );
+            i->_done   = true;
+        }
+    }
 }
 
 osg::Group*
-FeatureModelGraph::createNodeForStyle(const Style& style, const Query& query)
+FeatureModelGraph::createNodeForStyle(const Style& style, const Query& query, TaskService* cellService, ProgressCallback* progress)
 {
     osg::Group* styleGroup = 0L;
 
+    if ( progress && progress->reportProgress(0, 0) )
+        return 0L;
+
     // the profile of the features
     const FeatureProfile* profile = _source->getFeatureProfile();
 
@@ -657,7 +1045,31 @@ FeatureModelGraph::createNodeForStyle(const Style& style, const Query& query)
             context = crop2.push( workingSet, context );
         }
 
-        if ( workingSet.size() > 0 )
+        if ( progress && progress->reportProgress(0, 0) )
+            return 0L;
+
+        if ( workingSet.size() > 0 && _options.gridding().isSet() && _options.gridding()->enabled() )
+        {
+            // bin the features into grid cells in one pass, and compile the cells (in parallel
+            // if we have a service).
+            FeatureGridder gridder( cellBounds, *_options.gridding() );
+            CompileGridCell compiler( _factory.get(), style, context, gridder.getNumCells(), progress );
+            gridder.processCells( workingSet, compiler, cellService );
+
+            for( int i = 0; i < gridder.getNumCells(); ++i )
+            {
+                if ( compiler._ok[i] )
+                {
+                    if ( !styleGroup )
+                        styleGroup = _factory->getOrCreateStyleGroup( style, _session.get() );
+
+                    if ( compiler._nodes[i].valid() )
+                        styleGroup->addChild( compiler._nodes[i].get() );
+                }
+            }
+        }
+
+        else if ( workingSet.size() > 0 )
         {
             // next ask the implementation to construct OSG geometry for the cell features.
             osg::ref_ptr<osg::Node> node;
@@ -687,6 +1099,13 @@ FeatureModelGraph::traverse(osg::NodeVisitor& nv)
     {
         redraw();
     }
+
+    // note the frame, so we can tell which pending tiles are still in view.
+    if ( nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR && nv.getFrameStamp() )
+    {
+        _tileActivity->setFrame( nv.getFrameStamp()->getFrameNumber() );
+    }
+
     osg::Group::traverse(nv);
 }
 
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/FeatureSource>
+#include <osgEarthFeatures/CachingFeatureSource>
 #include <osgEarthFeatures/ResampleFilter>
 #include <osgEarthFeatures/BufferFilter>
 #include <osgEarthFeatures/ConvertTypeFilter>
@@ -31,7 +32,8 @@ using namespace osgEarth::Symbology;
 using namespace OpenThreads;
 
 FeatureSourceOptions::FeatureSourceOptions( const ConfigOptions& options ) :
-DriverConfigOptions( options )
+DriverConfigOptions( options ),
+_cacheInMemory( false )
 {
     fromConfig( _conf );
 }
@@ -42,6 +44,7 @@ FeatureSourceOptions::fromConfig( const Config& conf )
     unsigned numResamples = 0;
 
     conf.getIfSet( "open_write", _openWrite );
+    conf.getIfSet( "cache_in_memory", _cacheInMemory );
 
     const ConfigSet& children = conf.children();
     for( ConfigSet::const_iterator i = children.begin(); i != children.end(); ++i )
@@ -97,6 +100,7 @@ FeatureSourceOptions::getConfig() const
     Config conf = DriverConfigOptions::getConfig();
 
     conf.updateIfSet( "open_write", _openWrite );
+    conf.updateIfSet( "cache_in_memory", _cacheInMemory );
 
     //TODO: make each of these filters Configurable.
     for( FeatureFilterList::const_iterator i = _filters.begin(); i != _filters.end(); ++i )
@@ -192,6 +196,9 @@ FeatureSourceFactory::create( const FeatureSourceOptions& options )
         if ( featureSource )
         {
             featureSource->setName( options.getDriver() );
+
+            if ( options.cacheInMemory() == true )
+                featureSource = new CachingFeatureSource( featureSource );
         }
         else
         {
@@ -0,0 +1,628 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2010 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/FeatureSpatialIndex>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+
+//------------------------------------------------------------------------
+
+struct FeatureSpatialIndex::Node
+{
+    struct Entry
+    {
+        Box           _box;
+        Node*         _child;  // subtree (internal nodes only)
+        unsigned long _seq;    // feature record (leaf nodes only)
+    };
+    typedef std::vector<Entry> EntryVector;
+
+    // orders entries by the centers of their boxes, for STR packing.
+    struct LessX {
+        bool operator()( const Entry& lhs, const Entry& rhs ) const {
+            return lhs._box._xmin + lhs._box._xmax < rhs._box._xmin + rhs._box._xmax; }
+    };
+    struct LessY {
+        bool operator()( const Entry& lhs, const Entry& rhs ) const {
+            return lhs._box._ymin + lhs._box._ymax < rhs._box._ymin + rhs._box._ymax; }
+    };
+
+    Node( bool leaf ) : _leaf( leaf ), _parent( 0L ) { }
+
+    Box getBox() const
+    {
+        Box box = _entries.front()._box;
+        for( EntryVector::const_iterator i = _entries.begin()+1; i != _entries.end(); ++i )
+            box.expandBy( i->_box );
+        return box;
+    }
+
+    unsigned int indexOf( const Node* child ) const
+    {
+        unsigned int i = 0;
+        while( _entries[i]._child != child ) ++i;
+        return i;
+    }
+
+    bool        _leaf;
+    Node*       _parent;
+    EntryVector _entries;
+};
+
+//------------------------------------------------------------------------
+
+FeatureSpatialIndex::FeatureSpatialIndex( unsigned int maxEntriesPerNode ) :
+_maxEntries  ( osg::maximum(maxEntriesPerNode, 4u) ),
+_height      ( 1 ),
+_nextSequence( 0 )
+{
+    _minEntries = osg::maximum( (_maxEntries * 2) / 5, 2u );
+    _root = new Node( true );
+}
+
+FeatureSpatialIndex::~FeatureSpatialIndex()
+{
+    destroy( _root );
+}
+
+void
+FeatureSpatialIndex::clear()
+{
+    destroy( _root );
+    _root = new Node( true );
+    _height = 1;
+    _records.clear();
+    _byFeature.clear();
+    _byFID.clear();
+}
+
+void
+FeatureSpatialIndex::build( const FeatureList& features )
+{
+    clear();
+
+    Node::EntryVector entries;
+    for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i )
+    {
+        if ( _byFeature.find( i->get() ) != _byFeature.end() )
+            continue;
+
+        unsigned long seq = addRecord( i->get() );
+        const Record& r = _records[seq];
+        if ( r._bounded )
+        {
+            Node::Entry e;
+            e._box   = r._box;
+            e._child = 0L;
+            e._seq   = seq;
+            entries.push_back( e );
+        }
+    }
+
+    if ( entries.empty() )
+        return;
+
+    // Sort-Tile-Recursive: sort the entries into vertical slices by x, sort
+    // each slice by y, and pack runs of them into nodes. Repeat with the new
+    // nodes until there's only one.
+    bool leaf = true;
+    unsigned int height = 1;
+    for(;;)
+    {
+        unsigned int n          = entries.size();
+        unsigned int numNodes   = (n + _maxEntries - 1) / _maxEntries;
+        unsigned int numSlices  = (unsigned int)::ceil( ::sqrt( (double)numNodes ) );
+        unsigned int sliceSize  = numSlices * _maxEntries;
+
+        std::sort( entries.begin(), entries.end(), Node::LessX() );
+
+        Node::EntryVector parents;
+        for( unsigned int s = 0; s < n; s += sliceSize )
+        {
+            unsigned int sliceEnd = osg::minimum( s + sliceSize, n );
+            std::sort( entries.begin() + s, entries.begin() + sliceEnd, Node::LessY() );
+
+            for( unsigned int i = s; i < sliceEnd; i += _maxEntries )
+            {
+                Node* node = new Node( leaf );
+                node->_entries.assign( entries.begin() + i, entries.begin() + osg::minimum(i + _maxEntries, sliceEnd) );
+                if ( !leaf )
+                {
+                    for( Node::EntryVector::iterator e = node->_entries.begin(); e != node->_entries.end(); ++e )
+                        e->_child->_parent = node;
+                }
+
+                Node::Entry p;
+                p._box   = node->getBox();
+                p._child = node;
+                p._seq   = 0;
+                parents.push_back( p );
+            }
+        }
+
+        if ( parents.size() == 1 )
+        {
+            destroy( _root );
+            _root = parents.front()._child;
+            _height = height;
+            break;
+        }
+
+        entries.swap( parents );
+        leaf = false;
+        ++height;
+    }
+}
+
+void
+FeatureSpatialIndex::insert( Feature* feature )
+{
+    if ( !feature )
+        return;
+
+    // re-inserting a feature updates its bounds.
+    SequenceByFeature::iterator f = _byFeature.find( feature );
+    if ( f != _byFeature.end() )
+        removeRecord( _records.find(f->second) );
+
+    unsigned long seq = addRecord( feature );
+    const Record& r = _records[seq];
+    if ( r._bounded )
+        insertLeafEntry( seq, r._box );
+}
+
+bool
+FeatureSpatialIndex::remove( Feature* feature )
+{
+    SequenceByFeature::iterator f = _byFeature.find( feature );
+    if ( f == _byFeature.end() )
+        return false;
+
+    removeRecord( _records.find(f->second) );
+    return true;
+}
+
+bool
+FeatureSpatialIndex::remove( FeatureID fid )
+{
+    unsigned long seq;
+    if ( !findFID(fid, seq) )
+        return false;
+
+    removeRecord( _records.find(seq) );
+    return true;
+}
+
+Feature*
+FeatureSpatialIndex::get( FeatureID fid ) const
+{
+    unsigned long seq;
+    if ( !findFID(fid, seq) )
+        return 0L;
+
+    return _records.find(seq)->second._feature.get();
+}
+
+void
+FeatureSpatialIndex::query( const Bounds& bounds, FeatureList& out_features ) const
+{
+    if ( !bounds.isValid() )
+        return;
+
+    Box q;
+    q._xmin = bounds.xMin();
+    q._ymin = bounds.yMin();
+    q._xmax = bounds.xMax();
+    q._ymax = bounds.yMax();
+
+    std::vector<unsigned long> seqs;
+    std::vector<const Node*> stack;
+    stack.push_back( _root );
+    while( !stack.empty() )
+    {
+        const Node* node = stack.back();
+        stack.pop_back();
+
+        for( Node::EntryVector::const_iterator e = node->_entries.begin(); e != node->_entries.end(); ++e )
+        {
+            if ( e->_box.intersects(q) )
+            {
+                if ( node->_leaf )
+                    seqs.push_back( e->_seq );
+                else
+                    stack.push_back( e->_child );
+            }
+        }
+    }
+
+    output( seqs, out_features );
+}
+
+void
+FeatureSpatialIndex::getAll( FeatureList& out_features ) const
+{
+    for( RecordsBySequence::const_iterator r = _records.begin(); r != _records.end(); ++r )
+        out_features.push_back( r->second._feature.get() );
+}
+
+//------------------------------------------------------------------------
+
+unsigned long
+FeatureSpatialIndex::addRecord( Feature* feature )
+{
+    unsigned long seq = _nextSequence++;
+
+    Record& r = _records[seq];
+    r._feature = feature;
+    r._bounded = false;
+
+    // (read through a const pointer so we don't un-share the geometry)
+    const Geometry* geom = static_cast<const Feature*>(feature)->getGeometry();
+    if ( geom )
+    {
+        Bounds b = geom->getBounds();
+        if ( b.isValid() )
+        {
+            r._box._xmin = b.xMin();
+            r._box._ymin = b.yMin();
+            r._box._xmax = b.xMax();
+            r._box._ymax = b.yMax();
+            r._bounded = true;
+        }
+    }
+
+    _byFeature[feature] = seq;
+    _byFID.insert( std::make_pair(feature->getFID(), seq) );
+    return seq;
+}
+
+bool
+FeatureSpatialIndex::findFID( FeatureID fid, unsigned long& out_seq ) const
+{
+    // if more than one feature has the FID, use the first one added.
+    std::pair<SequenceByFID::const_iterator, SequenceByFID::const_iterator> range = _byFID.equal_range( fid );
+    if ( range.first == range.second )
+        return false;
+
+    out_seq = range.first->second;
+    for( SequenceByFID::const_iterator i = range.first; i != range.second; ++i )
+        out_seq = osg::minimum( out_seq, i->second );
+    return true;
+}
+
+void
+FeatureSpatialIndex::removeRecord( RecordsBySequence::iterator r )
+{
+    unsigned long seq = r->first;
+    Feature* feature = r->second._feature.get();
+
+    if ( r->second._bounded )
+        removeLeafEntry( seq, r->second._box );
+
+    _byFeature.erase( feature );
+
+    std::pair<SequenceByFID::iterator, SequenceByFID::iterator> range = _byFID.equal_range( feature->getFID() );
+    for( SequenceByFID::iterator i = range.first; i != range.second; ++i )
+    {
+        if ( i->second == seq )
+        {
+            _byFID.erase( i );
+            break;
+        }
+    }
+
+    _records.erase( r );
+}
+
+void
+FeatureSpatialIndex::output( std::vector<unsigned long>& seqs, FeatureList& out_features ) const
+{
+    // return features in the order they were added.
+    std::sort( seqs.begin(), seqs.end() );
+
+    for( std::vector<unsigned long>::const_iterator s = seqs.begin(); s != seqs.end(); ++s )
+    {
+        out_features.push_back( _records.find(*s)->second._feature.get() );
+    }
+}
+
+void
+FeatureSpatialIndex::insertLeafEntry( unsigned long seq, const Box& box )
+{
+    // descend to the leaf whose box needs the least enlargement to hold the new one:
+    Node* node = _root;
+    while( !node->_leaf )
+    {
+        Node::EntryVector::iterator best = node->_entries.begin();
+        double bestGrowth = best->_box.enlargement( box );
+        for( Node::EntryVector::iterator e = best+1; e != node->_entries.end(); ++e )
+        {
+            double growth = e->_box.enlargement( box );
+            if ( growth < bestGrowth || (growth == bestGrowth && e->_box.area() < best->_box.area()) )
+            {
+                best = e;
+                bestGrowth = growth;
+            }
+        }
+        node = best->_child;
+    }
+
+    Node::Entry e;
+    e._box   = box;
+    e._child = 0L;
+    e._seq   = seq;
+    node->_entries.push_back( e );
+
+    Node* sibling = 0L;
+    if ( node->_entries.size() > _maxEntries )
+        splitNode( node, sibling );
+
+    adjustTree( node, sibling );
+}
+
+void
+FeatureSpatialIndex::splitNode( Node* node, Node*& out_sibling )
+{
+    // Guttman's quadratic split.
+    Node::EntryVector all;
+    all.swap( node->_entries );
+
+    // pick the two entries that would waste the most space together as seeds:
+    unsigned int seed0 = 0, seed1 = 1;
+    double worst = -DBL_MAX;
+    for( unsigned int i = 0; i < all.size(); ++i )
+    {
+        for( unsigned int j = i+1; j < all.size(); ++j )
+        {
+            Box u = all[i]._box;
+            u.expandBy( all[j]._box );
+            double waste = u.area() - all[i]._box.area() - all[j]._box.area();
+            if ( waste > worst )
+            {
+                worst = waste;
+                seed0 = i;
+                seed1 = j;
+            }
+        }
+    }
+
+    Node* sibling = new Node( node->_leaf );
+    Node* groups[2] = { node, sibling };
+    Box   boxes[2]  = { all[seed0]._box, all[seed1]._box };
+    node->_entries.push_back( all[seed0] );
+    sibling->_entries.push_back( all[seed1] );
+
+    std::vector<bool> assigned( all.size(), false );
+    assigned[seed0] = assigned[seed1] = true;
+    unsigned int remaining = all.size() - 2;
+
+    while( remaining > 0 )
+    {
+        // if one group needs all the rest to make the minimum, give them to it.
+        int needy = -1;
+        for( int g = 0; g < 2; ++g )
+            if ( groups[g]->_entries.size() + remaining <= _minEntries )
+                needy = g;
+
+        if ( needy >= 0 )
+        {
+            for( unsigned int i = 0; i < all.size(); ++i )
+                if ( !assigned[i] )
+                    groups[needy]->_entries.push_back( all[i] );
+            break;
+        }
+
+        // otherwise place the entry with the strongest preference for one group:
+        unsigned int next = 0;
+        double nextDiff = -1.0, nextGrowth0 = 0.0, nextGrowth1 = 0.0;
+        for( unsigned int i = 0; i < all.size(); ++i )
+        {
+            if ( assigned[i] )
+                continue;
+
+            double growth0 = boxes[0].enlargement( all[i]._box );
+            double growth1 = boxes[1].enlargement( all[i]._box );
+            double diff = ::fabs( growth0 - growth1 );
+            if ( diff > nextDiff )
+            {
+                next        = i;
+                nextDiff    = diff;
+                nextGrowth0 = growth0;
+                nextGrowth1 = growth1;
+            }
+        }
+
+        int g =
+            nextGrowth0 < nextGrowth1 ? 0 :
+            nextGrowth1 < nextGrowth0 ? 1 :
+            boxes[0].area() < boxes[1].area() ? 0 :
+            boxes[1].area() < boxes[0].area() ? 1 :
+            groups[0]->_entries.size() <= groups[1]->_entries.size() ? 0 : 1;
+
+        groups[g]->_entries.push_back( all[next] );
+        boxes[g].expandBy( all[next]._box );
+        assigned[next] = true;
+        --remaining;
+    }
+
+    if ( !sibling->_leaf )
+    {
+        for( Node::EntryVector::iterator e = sibling->_entries.begin(); e != sibling->_entries.end(); ++e )
+            e->_child->_parent = sibling;
+    }
+
+    out_sibling = sibling;
+}
+
+void
+FeatureSpatialIndex::adjustTree( Node* node, Node* sibling )
+{
+    // walk up to the root, fixing boxes and propagating splits.
+    while( node != _root )
+    {
+        Node* parent = node->_parent;
+        parent->_entries[parent->indexOf(node)]._box = node->getBox();
+
+        Node* parentSibling = 0L;
+        if ( sibling )
+        {
+            Node::Entry e;
+            e._box   = sibling->getBox();
+            e._child = sibling;
+            e._seq   = 0;
+            sibling->_parent = parent;
+            parent->_entries.push_back( e );
+
+            if ( parent->_entries.size() > _maxEntries )
+                splitNode( parent, parentSibling );
+        }
+
+        node = parent;
+        sibling = parentSibling;
+    }
+
+    // the root split; grow the tree.
+    if ( sibling )
+    {
+        Node* root = new Node( false );
+
+        Node::Entry e;
+        e._seq = 0;
+        e._box = node->getBox();
+        e._child = node;
+        root->_entries.push_back( e );
+        e._box = sibling->getBox();
+        e._child = sibling;
+        root->_entries.push_back( e );
+
+        node->_parent = root;
+        sibling->_parent = root;
+        _root = root;
+        ++_height;
+    }
+}
+
+bool
+FeatureSpatialIndex::removeLeafEntry( unsigned long seq, const Box& box )
+{
+    Node* leaf = findLeaf( _root, seq, box );
+    if ( !leaf )
+        return false;
+
+    for( Node::EntryVector::iterator e = leaf->_entries.begin(); e != leaf->_entries.end(); ++e )
+    {
+        if ( e->_seq == seq )
+        {
+            leaf->_entries.erase( e );
+            break;
+        }
+    }
+
+    // condense the tree: dissolve nodes that are now underfull and set aside
+    // their features to reinsert.
+    std::vector<unsigned long> orphans;
+    Node* node = leaf;
+    while( node != _root )
+    {
+        Node* parent = node->_parent;
+        unsigned int i = parent->indexOf( node );
+        if ( node->_entries.size() < _minEntries )
+        {
+            parent->_entries.erase( parent->_entries.begin() + i );
+            collect( node, orphans );
+            destroy( node );
+        }
+        else
+        {
+            parent->_entries[i]._box = node->getBox();
+        }
+        node = parent;
+    }
+
+    // shorten the tree if the root is left with a single child.
+    while( !_root->_leaf && _root->_entries.size() == 1 )
+    {
+        Node* child = _root->_entries.front()._child;
+        _root->_entries.clear();
+        delete _root;
+        _root = child;
+        _root->_parent = 0L;
+        --_height;
+    }
+
+    if ( !_root->_leaf && _root->_entries.empty() )
+    {
+        delete _root;
+        _root = new Node( true );
+        _height = 1;
+    }
+
+    for( std::vector<unsigned long>::const_iterator s = orphans.begin(); s != orphans.end(); ++s )
+    {
+        insertLeafEntry( *s, _records[*s]._box );
+    }
+
+    return true;
+}
+
+FeatureSpatialIndex::Node*
+FeatureSpatialIndex::findLeaf( Node* node, unsigned long seq, const Box& box ) const
+{
+    for( Node::EntryVector::const_iterator e = node->_entries.begin(); e != node->_entries.end(); ++e )
+    {
+        if ( node->_leaf )
+        {
+            if ( e->_seq == seq )
+                return node;
+        }
+        else if ( e->_box.contains(box) )
+        {
+            Node* leaf = findLeaf( e->_child, seq, box );
+            if ( leaf )
+                return leaf;
+        }
+    }
+    return 0L;
+}
+
+void
+FeatureSpatialIndex::collect( const Node* node, std::vector<unsigned long>& out_seqs ) const
+{
+    for( Node::EntryVector::const_iterator e = node->_entries.begin(); e != node->_entries.end(); ++e )
+    {
+        if ( node->_leaf )
+            out_seqs.push_back( e->_seq );
+        else
+            collect( e->_child, out_seqs );
+    }
+}
+
+void
+FeatureSpatialIndex::destroy( Node* node )
+{
+    if ( !node->_leaf )
+    {
+        for( Node::EntryVector::iterator e = node->_entries.begin(); e != node->_entries.end(); ++e )
+            destroy( e->_child );
+    }
+    delete node;
+}
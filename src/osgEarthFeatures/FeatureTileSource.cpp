@@ -18,8 +18,10 @@
  */
 #include <osgEarthFeatures/FeatureTileSource>
 #include <osgEarth/Registry>
+#include <osgEarthSymbology/LineSymbol>
 #include <osgDB/WriteFile>
 #include <osg/Notify>
+#include <OpenThreads/ScopedLock>
 
 using namespace osgEarth;
 using namespace osgEarth::Features;
@@ -86,7 +88,8 @@ FeatureTileSourceOptions::fromConfig( const Config& conf )
 FeatureTileSource::FeatureTileSource( const TileSourceOptions& options ) :
 TileSource( options ),
 _options( options.getConfig() ),
-_initialized( false )
+_initialized( false ),
+_widestStyleGroup( -1 )
 {
     if ( _options.featureSource().valid() )
     {
@@ -173,19 +176,7 @@ FeatureTileSource::createImage( const TileKey& key, ProgressCallback* progress )
     if ( _features->hasEmbeddedStyles() )
     {
         // Each feature has its own embedded style data, so use that:
-        osg::ref_ptr<FeatureCursor> cursor = _features->createFeatureCursor( Query() );
-        while( cursor->hasMore() )
-        {
-            Feature* feature = cursor->nextFeature();
-            if ( feature )
-            {
-                FeatureList list;
-                list.push_back( feature );
-                renderFeaturesForStyle( 
-                    *feature->style(), list, buildData.get(),
-                    key.getExtent(), image.get() );
-            }
-        }
+        queryAndRenderFeaturesForEmbeddedStyles( buildData.get(), key.getExtent(), image.get() );
     }
     else if ( styles )
     {
@@ -218,56 +209,222 @@ FeatureTileSource::createImage( const TileKey& key, ProgressCallback* progress )
 }
 
 
+double
+FeatureTileSource::getQueryBuffer(const Style&     style,
+                                  const GeoExtent& imageExtent ) const
+{
+    const LineSymbol* line = style.getSymbol<LineSymbol>();
+    double pixels = 1.0 + ( line && line->stroke()->width().isSet() ? 0.5 * line->stroke()->width().value() : 0.0 );
+    return pixels * imageExtent.width() / (double)getPixelsPerTile();
+}
+
 bool
-FeatureTileSource::queryAndRenderFeaturesForStyle(const Style&     style,
-                                                  const Query&     query,
-                                                  osg::Referenced* data,
-                                                  const GeoExtent& imageExtent,
-                                                  osg::Image*      out_image)
-{   
+FeatureTileSource::getQueryExtent(const GeoExtent& imageExtent,
+                                  double           buffer,
+                                  GeoExtent&       out_extent ) const
+{
     // first we need the overall extent of the layer:
-    const GeoExtent& featuresExtent = getFeatureSource()->getFeatureProfile()->getExtent();
+    const GeoExtent& featuresExtent = _features->getFeatureProfile()->getExtent();
+
+    // pad the image extent so we pick up features that bleed into it:
+    GeoExtent bufferedImageExtent = imageExtent;
+    if ( buffer > 0.0 )
+        bufferedImageExtent.expand( 2.0*buffer, 2.0*buffer );
     
     // convert them both to WGS84, intersect the extents, and convert back.
     GeoExtent featuresExtentWGS84 = featuresExtent.transform( featuresExtent.getSRS()->getGeographicSRS() );
-    GeoExtent imageExtentWGS84 = imageExtent.transform( featuresExtent.getSRS()->getGeographicSRS() );
+    GeoExtent imageExtentWGS84 = bufferedImageExtent.transform( featuresExtent.getSRS()->getGeographicSRS() );
     GeoExtent queryExtentWGS84 = featuresExtentWGS84.intersectionSameSRS( imageExtentWGS84.bounds() );
-    if ( queryExtentWGS84.isValid() )
+    if ( !queryExtentWGS84.isValid() )
+        return false;
+
+    out_extent = queryExtentWGS84.transform( featuresExtent.getSRS() );
+    return true;
+}
+
+void
+FeatureTileSource::readFeatures(const Query& query,
+                                FeatureList& out_features ) const
+{
+    // query the feature source:
+    osg::ref_ptr<FeatureCursor> cursor = _features->createFeatureCursor( query );
+    if ( !cursor.valid() )
+        return;
+
+    // now copy the resulting feature set into a list, converting the data
+    // types along the way if a geometry override is in place:
+    while( cursor->hasMore() )
     {
-        GeoExtent queryExtent = queryExtentWGS84.transform( featuresExtent.getSRS() );
+        Feature* feature = cursor->nextFeature();
+        if ( !feature )
+            continue;
 
-	    // incorporate the image extent into the feature query for this style:
-        Query localQuery = query;
-        localQuery.bounds() = query.bounds().isSet()?
-		    query.bounds()->unionWith( queryExtent.bounds() ) :
-		    queryExtent.bounds();
+        Geometry* geom = feature->getGeometry();
+        if ( geom )
+        {
+            // apply a type override if requested:
+            if (_options.geometryTypeOverride().isSet() &&
+                _options.geometryTypeOverride() != geom->getComponentType() )
+            {
+                geom = geom->cloneAs( _options.geometryTypeOverride().value() );
+                if ( geom )
+                    feature->setGeometry( geom );
+            }
+        }
+        if ( geom )
+        {
+            out_features.push_back( feature );
+        }
+    }
+}
+
+bool
+FeatureTileSource::queryAndRenderFeaturesForEmbeddedStyles(osg::Referenced* data,
+                                                           const GeoExtent& imageExtent,
+                                                           osg::Image*      out_image)
+{
+    // pad the query by the widest style we've seen so far. (The first tiles
+    // to see a wider style than any before it may miss a few pixels of it.)
+    double buffer = 0.0;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _styleGroupsMutex );
+        buffer = _widestStyleGroup >= 0 ?
+            getQueryBuffer( _styleGroups[_widestStyleGroup], imageExtent ) :
+            getQueryBuffer( Style(), imageExtent );
+    }
 
-        // query the feature source:
-        osg::ref_ptr<FeatureCursor> cursor = _features->createFeatureCursor( localQuery );
+    GeoExtent queryExtent;
+    if ( !getQueryExtent(imageExtent, buffer, queryExtent) )
+        return false;
 
-        // now copy the resulting feature set into a list, converting the data
-        // types along the way if a geometry override is in place:
-        FeatureList cellFeatures;
-        while( cursor->hasMore() )
+    Query query;
+    query.bounds() = queryExtent.bounds();
+
+    FeatureList features;
+    readFeatures( query, features );
+    if ( features.empty() )
+        return false;
+
+    // look up the style group of each feature we've seen before.
+    std::vector<int> groupOf( features.size(), -1 );
+    std::vector<std::string> keys( features.size() );
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _styleGroupsMutex );
+
+        // a changed source may have changed its features' styles:
+        if ( _features->outOfSyncWith(_styleGroupsRevision) )
+        {
+            _styleGroupsByFID.clear();
+            _features->sync( _styleGroupsRevision );
+        }
+
+        unsigned n = 0;
+        for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++n )
         {
-            Feature* feature = cursor->nextFeature();
-            Geometry* geom = feature->getGeometry();
-            if ( geom )
+            FeatureID fid = i->get()->getFID();
+            if ( fid != 0L )
             {
-                // apply a type override if requested:
-                if (_options.geometryTypeOverride().isSet() &&
-                    _options.geometryTypeOverride() != geom->getComponentType() )
-                {
-                    geom = geom->cloneAs( _options.geometryTypeOverride().value() );
-                    if ( geom )
-                        feature->setGeometry( geom );
-                }
+                std::map<FeatureID,unsigned>::const_iterator g = _styleGroupsByFID.find( fid );
+                if ( g != _styleGroupsByFID.end() )
+                    groupOf[n] = g->second;
+            }
+        }
+    }
+
+    // serialize the styles of the rest, outside the lock:
+    bool anyNew = false;
+    unsigned n = 0;
+    for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++n )
+    {
+        if ( groupOf[n] < 0 )
+        {
+            const Feature* feature = i->get();
+            if ( feature->style().isSet() )
+                keys[n] = feature->style()->getConfig().toHashString();
+            anyNew = true;
+        }
+    }
+
+    // and find or create their style groups.
+    if ( anyNew )
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _styleGroupsMutex );
+
+        n = 0;
+        for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++n )
+        {
+            if ( groupOf[n] >= 0 )
+                continue;
+
+            const Feature* feature = i->get();
+            std::map<std::string,unsigned>::const_iterator g = _styleGroupsByKey.find( keys[n] );
+            if ( g != _styleGroupsByKey.end() )
+            {
+                groupOf[n] = g->second;
             }
-            if ( geom )
+            else
             {
-                cellFeatures.push_back( feature );
+                groupOf[n] = _styleGroups.size();
+                _styleGroups.push_back( feature->style().isSet() ? feature->style().value() : Style() );
+                _styleGroupsByKey[keys[n]] = groupOf[n];
+
+                const LineSymbol* line   = _styleGroups.back().getSymbol<LineSymbol>();
+                const LineSymbol* widest = _widestStyleGroup >= 0 ? _styleGroups[_widestStyleGroup].getSymbol<LineSymbol>() : 0L;
+                if ( line && line->stroke()->width().isSet() &&
+                     (!widest || !widest->stroke()->width().isSet() || line->stroke()->width().value() > widest->stroke()->width().value()) )
+                {
+                    _widestStyleGroup = groupOf[n];
+                }
             }
+
+            if ( feature->getFID() != 0L )
+                _styleGroupsByFID[feature->getFID()] = groupOf[n];
+        }
+    }
+
+    // bin the features by style, and render each style in one batch:
+    typedef std::map<int, FeatureList> FeaturesByGroup;
+    FeaturesByGroup batches;
+    n = 0;
+    for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i, ++n )
+    {
+        batches[groupOf[n]].push_back( i->get() );
+    }
+
+    bool rendered = false;
+    for( FeaturesByGroup::const_iterator b = batches.begin(); b != batches.end(); ++b )
+    {
+        // safe without the lock; styles are never modified or removed once added.
+        const Style* style;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock( _styleGroupsMutex );
+            style = &_styleGroups[b->first];
         }
+        if ( renderFeaturesForStyle( *style, b->second, data, imageExtent, out_image ) )
+            rendered = true;
+    }
+
+    return rendered;
+}
+
+bool
+FeatureTileSource::queryAndRenderFeaturesForStyle(const Style&     style,
+                                                  const Query&     query,
+                                                  osg::Referenced* data,
+                                                  const GeoExtent& imageExtent,
+                                                  osg::Image*      out_image)
+{   
+    GeoExtent queryExtent;
+    if ( getQueryExtent(imageExtent, getQueryBuffer(style, imageExtent), queryExtent) )
+    {
+	    // incorporate the image extent into the feature query for this style:
+        Query localQuery = query;
+        localQuery.bounds() = query.bounds().isSet()?
+		    query.bounds()->unionWith( queryExtent.bounds() ) :
+		    queryExtent.bounds();
+
+        FeatureList cellFeatures;
+        readFeatures( localQuery, cellFeatures );
 
         //OE_NOTICE
         //    << "Rendering "
@@ -283,4 +440,3 @@ FeatureTileSource::queryAndRenderFeaturesForStyle(const Style&     style,
         return false;
     }
 }
-
@@ -58,7 +58,7 @@ ResampleFilter::push( Feature* input, const FilterContext& context )
 
     bool success = true;
 
-    GeometryIterator i( input->getGeometry() );
+    GeometryIterator i( input->getGeometryForWrite() );
     while( i.hasMore() )
     {
         Geometry* part = i.next();
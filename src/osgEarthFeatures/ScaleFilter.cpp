@@ -54,7 +54,7 @@ ScaleFilter::push( Feature* input, const FilterContext& cx )
     Bounds envelope = input->getGeometry()->getBounds();
 
     // now scale and shift everything
-    GeometryIterator scale_iter( input->getGeometry() );
+    GeometryIterator scale_iter( input->getGeometryForWrite() );
     while( scale_iter.hasMore() )
     {
         Geometry* geom = scale_iter.next();
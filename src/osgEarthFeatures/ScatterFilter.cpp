@@ -200,7 +200,7 @@ ScatterFilter::push(FeatureList& features, const FilterContext& context )
     {
         Feature* f = i->get();
         
-        Geometry* geom = f->getGeometry();
+        Geometry* geom = f->getGeometryForWrite();
         if ( !geom )
             continue;
 
@@ -177,12 +177,13 @@ Session::getModel( const std::string& url ) const
         node = buildImageModel( image.get() );
     }
 
-    // add it to the local model cache for next time
+    // add it to the local model cache for next time. If another thread loaded the same
+    // model in the meantime, use that one, so that a node we've returned never loses
+    // the cache's reference to it.
     {
         Session* ncthis = const_cast<Session*>(this);
         Threading::ScopedWriteLock exclusiveLock( ncthis->_modelsMutex );
-        ncthis->_models[absurl] = node.get();
+        std::pair<ModelMap::iterator, bool> r = ncthis->_models.insert( std::make_pair(absurl, node) );
+        return r.first->second.get();
     }
-
-    return node.release();
 }
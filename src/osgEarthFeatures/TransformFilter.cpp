@@ -75,7 +75,7 @@ namespace
     {
         if ( input && input->getGeometry() )
         {
-            GeometryIterator iter( input->getGeometry() );
+            GeometryIterator iter( input->getGeometryForWrite() );
             while( iter.hasMore() )
             {
                 Geometry* geom = iter.next();
@@ -123,7 +123,7 @@ TransformFilter::push( Feature* input, const FilterContext& context )
         return true;
 
     // iterate over the feature geometry.
-    GeometryIterator iter( input->getGeometry() );
+    GeometryIterator iter( input->getGeometryForWrite() );
     while( iter.hasMore() )
     {
         Geometry* geom = iter.next();